@@ -0,0 +1,139 @@
+#include "bk_tree.h"
+#include <algorithm>
+
+int BkTree::distance(const std::string& a, const std::string& b) {
+    // 三行滚动数组（交换需要再往前一行），每个线程复用，查询时不分配内存
+    size_t n = b.size();
+    thread_local std::vector<int> previous2, previous, current;
+    previous2.resize(n + 1);
+    previous.resize(n + 1);
+    current.resize(n + 1);
+    for (size_t j = 0; j <= n; ++j) {
+        previous[j] = static_cast<int>(j);
+    }
+    for (size_t i = 1; i <= a.size(); ++i) {
+        current[0] = static_cast<int>(i);
+        for (size_t j = 1; j <= n; ++j) {
+            int cost = a[i - 1] == b[j - 1] ? 0 : 1;
+            current[j] = std::min({previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost});
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]) {
+                current[j] = std::min(current[j], previous2[j - 2] + 1);
+            }
+        }
+        std::swap(previous2, previous);
+        std::swap(previous, current);
+    }
+    return previous[n];
+}
+
+int64_t BkTree::find(const std::string& word) const {
+    if (nodes_.empty()) {
+        return -1;
+    }
+    uint32_t node = 0;
+    while (true) {
+        int d = distance(word, nodes_[node].word);
+        if (d == 0) {
+            return node;
+        }
+        auto& children = nodes_[node].children;
+        auto it = std::find_if(children.begin(), children.end(),
+                               [d](const std::pair<int, uint32_t>& child) { return child.first == d; });
+        if (it == children.end()) {
+            return -1;
+        }
+        node = it->second;
+    }
+}
+
+void BkTree::insert(const std::string& word) {
+    if (nodes_.empty()) {
+        nodes_.push_back({word, false, {}});
+        return;
+    }
+    uint32_t node = 0;
+    while (true) {
+        int d = distance(word, nodes_[node].word);
+        if (d == 0) {
+            if (nodes_[node].removed) {
+                nodes_[node].removed = false;
+                --removed_;
+            }
+            return;
+        }
+        auto& children = nodes_[node].children;
+        auto it = std::find_if(children.begin(), children.end(),
+                               [d](const std::pair<int, uint32_t>& child) { return child.first == d; });
+        if (it == children.end()) {
+            uint32_t child = static_cast<uint32_t>(nodes_.size());
+            children.emplace_back(d, child);     // 先记下子节点，push_back可能使引用失效
+            nodes_.push_back({word, false, {}});
+            return;
+        }
+        node = it->second;
+    }
+}
+
+bool BkTree::erase(const std::string& word) {
+    int64_t node = find(word);
+    if (node < 0 || nodes_[node].removed) {
+        return false;
+    }
+    nodes_[node].removed = true;
+    ++removed_;
+
+    // 删除的节点仍然参与查找时的距离计算，超过一半时重建
+    if (removed_ * 2 > nodes_.size()) {
+        rebuild();
+    }
+    return true;
+}
+
+void BkTree::clear() {
+    nodes_.clear();
+    removed_ = 0;
+}
+
+void BkTree::rebuild() {
+    std::vector<std::string> words;
+    words.reserve(nodes_.size() - removed_);
+    for (Node& node : nodes_) {
+        if (!node.removed) {
+            words.push_back(std::move(node.word));
+        }
+    }
+    clear();
+    for (const std::string& word : words) {
+        insert(word);
+    }
+}
+
+std::vector<BkTree::Match> BkTree::search(const std::string& word, int maxDistance, size_t limit) const {
+    std::vector<Match> matches;
+    if (nodes_.empty()) {
+        return matches;
+    }
+
+    std::vector<uint32_t> stack = {0};
+    while (!stack.empty()) {
+        const Node& node = nodes_[stack.back()];
+        stack.pop_back();
+        int d = distance(word, node.word);
+        if (d <= maxDistance && !node.removed) {
+            matches.push_back({node.word, d});
+        }
+        for (const auto& child : node.children) {
+            if (child.first >= d - maxDistance && child.first <= d + maxDistance) {
+                stack.push_back(child.second);
+            }
+        }
+    }
+
+    std::sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+        return a.distance != b.distance ? a.distance < b.distance : a.word < b.word;
+    });
+    if (matches.size() > limit) {
+        matches.resize(limit);
+    }
+    return matches;
+}
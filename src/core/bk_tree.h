@@ -0,0 +1,53 @@
+#ifndef BK_TREE_H
+#define BK_TREE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 按编辑距离查找相近单词的BK树（"did you mean"和补全的模糊匹配用）
+//
+// 距离是允许相邻交换的编辑距离（OSA），"grpe"到"grep"为1。每个子节点按它与父节点的距离
+// 挂在父节点下，查询距离为d的节点时只需进入距离在[d-k, d+k]之间的子树。
+// 单词可以随时增加；删除只做标记，标记过多时整体重建。
+// OSA距离不完全满足三角不等式，极少数情况下会漏掉个别结果，对拼写提示来说可以接受。
+class BkTree {
+public:
+    struct Match {
+        std::string word;
+        int distance;
+    };
+
+    // 增加单词（已存在时恢复被删除的标记）
+    void insert(const std::string& word);
+
+    // 删除单词，返回是否存在
+    bool erase(const std::string& word);
+
+    void clear();
+
+    // 距离不超过maxDistance的单词，按距离、再按单词排序，最多limit个
+    std::vector<Match> search(const std::string& word, int maxDistance, size_t limit) const;
+
+    size_t size() const { return nodes_.size() - removed_; }
+
+    // 两个字符串的OSA编辑距离
+    static int distance(const std::string& a, const std::string& b);
+
+private:
+    struct Node {
+        std::string word;
+        bool removed = false;
+        std::vector<std::pair<int, uint32_t>> children;     // (到本节点的距离, 子节点)
+    };
+
+    std::vector<Node> nodes_;
+    size_t removed_ = 0;
+
+    // 查找单词所在的节点，不存在时返回-1
+    int64_t find(const std::string& word) const;
+    void rebuild();
+};
+
+#endif // BK_TREE_H
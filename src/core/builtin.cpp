@@ -1,16 +1,108 @@
 #include "builtin.h"
 #include "shell.h"
 #include "history.h"
+#include "completion.h"
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <algorithm>
+#include <iterator>
 #include <unistd.h>
 #include <cstdlib>
+#include <cctype>
+#include <climits>
+#include <ctime>
 #include <sys/stat.h>
 
+namespace {
+
+// 解析 history --since 的参数：相对时长（30m、2h、1d、1w）或日期（YYYY-MM-DD [HH:MM]）
+bool parseSince(const std::string& text, int64_t& since) {
+    size_t end = 0;
+    long value = 0;
+    try {
+        value = std::stol(text, &end);
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    static const std::pair<const char*, int64_t> units[] = {
+        {"s", 1}, {"m", 60}, {"h", 3600}, {"d", 86400}, {"w", 7 * 86400},
+    };
+    std::string unit = text.substr(end);
+    for (const auto& entry : units) {
+        if (unit == entry.first && value >= 0) {
+            since = static_cast<int64_t>(time(nullptr)) - value * entry.second;
+            return true;
+        }
+    }
+
+    struct tm tm = {};
+    const char* rest = strptime(text.c_str(), "%Y-%m-%d", &tm);
+    if (!rest) {
+        return false;
+    }
+    if (*rest && !(rest = strptime(rest, " %H:%M", &tm))) {
+        return false;
+    }
+    if (*rest) {
+        return false;
+    }
+    tm.tm_isdst = -1;
+    since = static_cast<int64_t>(mktime(&tm));
+    return since != -1;
+}
+
+// history -v：开始时间、耗时和退出码
+void printHistoryDetails(const HistoryRecord& record) {
+    char timeBuffer[32] = "-";
+    time_t startTime = static_cast<time_t>(record.startTime);
+    struct tm tm;
+    if (record.startTime > 0 && localtime_r(&startTime, &tm)) {
+        strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%d %H:%M:%S", &tm);
+    }
+
+    std::ostringstream duration;
+    duration << std::fixed << std::setprecision(record.durationMs < 10000 ? 2 : 0)
+             << record.durationMs / 1000.0 << "s";
+
+    std::cout << std::left << std::setw(19) << timeBuffer << "  " << std::right << std::setw(8)
+              << duration.str() << "  ";
+    if (record.exitStatus < 0) {
+        std::cout << "[  ?]  ";
+    } else {
+        std::cout << "[" << std::setw(3) << record.exitStatus << "]  ";
+    }
+}
+
+// history --stats：条数和每条占用的字节数
+void printHistoryStats(const HistoryStats& stats) {
+    auto perEntry = [](size_t bytes, size_t count) {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(1) << (count ? static_cast<double>(bytes) / count : 0.0);
+        return text.str();
+    };
+    size_t memory = stats.poolBytes + stats.indexBytes + stats.trieBytes;
+
+    std::cout << "entries:           " << stats.entries << " (" << stats.records << " records, "
+              << stats.uniqueCommands << " unique commands)" << std::endl;
+    std::cout << "log file:          " << stats.logBytes << " bytes, "
+              << perEntry(stats.logBytes, stats.records) << " bytes/record" << std::endl;
+    std::cout << "memory:            " << memory << " bytes, "
+              << perEntry(memory, stats.records) << " bytes/record" << std::endl;
+    std::cout << "  interned:        " << stats.poolBytes << " bytes, "
+              << perEntry(stats.poolBytes, stats.records) << " bytes/record" << std::endl;
+    std::cout << "  search index:    " << stats.indexBytes << " bytes" << std::endl;
+    std::cout << "  suggestion trie: " << stats.trieBytes << " bytes" << std::endl;
+}
+
+} // namespace
+
 BuiltinCommands::BuiltinCommands(Shell* shell) : shell(shell) {
     // 初始化AI客户端
     aiClient_ = std::make_unique<AIClient>();
+    dirDatabase_ = std::make_unique<DirectoryDatabase>();
+    pluginLoader_ = std::make_unique<PluginLoader>(shell);
     
     initializeBuiltins();
 }
@@ -31,12 +123,29 @@ void BuiltinCommands::initializeBuiltins() {
     builtinMap["which"] = [this](std::shared_ptr<Command> cmd) { return cmdWhich(cmd); };
     builtinMap["set"] = [this](std::shared_ptr<Command> cmd) { return cmdSet(cmd); };
     builtinMap["ai"] = [this](std::shared_ptr<Command> cmd) { return cmdAi(cmd); };  // 添加AI命令
+    builtinMap["pushd"] = [this](std::shared_ptr<Command> cmd) { return cmdPushd(cmd); };
+    builtinMap["popd"] = [this](std::shared_ptr<Command> cmd) { return cmdPopd(cmd); };
+    builtinMap["dirs"] = [this](std::shared_ptr<Command> cmd) { return cmdDirs(cmd); };
+    builtinMap["z"] = [this](std::shared_ptr<Command> cmd) { return cmdZ(cmd); };
+    builtinMap["enable"] = [this](std::shared_ptr<Command> cmd) { return cmdEnable(cmd); };
+    builtinMap["timeout"] = [this](std::shared_ptr<Command> cmd) { return cmdTimeout(cmd); };
+    builtinMap["retry"] = [this](std::shared_ptr<Command> cmd) { return cmdRetry(cmd); };
+    builtinMap["complete"] = [this](std::shared_ptr<Command> cmd) { return cmdComplete(cmd); };
 }
 
 bool BuiltinCommands::isBuiltinCommand(const std::string& command) {
     return builtinMap.find(command) != builtinMap.end();
 }
 
+std::vector<std::string> BuiltinCommands::getCommandNames() const {
+    std::vector<std::string> names;
+    names.reserve(builtinMap.size());
+    for (const auto& entry : builtinMap) {
+        names.push_back(entry.first);
+    }
+    return names;
+}
+
 int BuiltinCommands::execute(std::shared_ptr<Command> command) {
     auto it = builtinMap.find(command->command);
     if (it != builtinMap.end()) {
@@ -82,25 +191,124 @@ int BuiltinCommands::cmdCd(std::shared_ptr<Command> command) {
             std::cerr << "cd: HOME not set" << std::endl;
             return 1;
         }
+    } else if (command->arguments[0] == "-") {
+        // cd - 切换到上一个目录并打印
+        path = shell->getEnvironmentVariable("OLDPWD");
+        if (path.empty()) {
+            std::cerr << "cd: OLDPWD not set" << std::endl;
+            return 1;
+        }
+        if (!changeDirectory(path)) {
+            return 1;
+        }
+        std::cout << shell->getCurrentDirectory() << std::endl;
+        return 0;
     } else {
-        path = command->arguments[0];
-        
         // 处理 ~ 符号
-        if (path == "~" || path.substr(0, 2) == "~/") {
-            std::string home = shell->getEnvironmentVariable("HOME");
-            if (home.empty()) {
-                std::cerr << "cd: HOME not set" << std::endl;
+        path = expandHome(command->arguments[0]);
+        if (path.empty()) {
+            std::cerr << "cd: HOME not set" << std::endl;
+            return 1;
+        }
+    }
+    
+    return changeDirectory(path) ? 0 : 1;
+}
+
+int BuiltinCommands::cmdPushd(std::shared_ptr<Command> command) {
+    std::string current = shell->getCurrentDirectory();
+    
+    if (command->arguments.empty()) {
+        // 无参数：交换栈顶目录和当前目录
+        if (dirStack_.empty()) {
+            std::cerr << "pushd: no other directory" << std::endl;
+            return 1;
+        }
+        std::string target = dirStack_.back();
+        if (!changeDirectory(target)) {
+            return 1;
+        }
+        dirStack_.back() = current;
+    } else {
+        std::string target = expandHome(command->arguments[0]);
+        if (target.empty()) {
+            std::cerr << "pushd: HOME not set" << std::endl;
+            return 1;
+        }
+        if (!changeDirectory(target)) {
+            return 1;
+        }
+        dirStack_.push_back(current);
+    }
+    
+    printDirStack();
+    return 0;
+}
+
+int BuiltinCommands::cmdPopd(std::shared_ptr<Command>) {
+    if (dirStack_.empty()) {
+        std::cerr << "popd: directory stack empty" << std::endl;
+        return 1;
+    }
+    
+    if (!changeDirectory(dirStack_.back())) {
+        return 1;
+    }
+    dirStack_.pop_back();
+    
+    printDirStack();
+    return 0;
+}
+
+int BuiltinCommands::cmdDirs(std::shared_ptr<Command> command) {
+    if (!command->arguments.empty() && command->arguments[0] == "-c") {
+        dirStack_.clear();
+        return 0;
+    }
+    
+    printDirStack();
+    return 0;
+}
+
+int BuiltinCommands::cmdZ(std::shared_ptr<Command> command) {
+    bool listOnly = false;
+    std::vector<std::string> terms;
+    
+    for (size_t i = 0; i < command->arguments.size(); ++i) {
+        const std::string& arg = command->arguments[i];
+        if (arg == "-l") {
+            listOnly = true;
+        } else if (arg == "-x") {
+            // 从数据库中删除当前目录
+            std::string current = shell->getCurrentDirectory();
+            if (!dirDatabase_->remove(current)) {
+                std::cerr << "z: " << current << " not in database" << std::endl;
                 return 1;
             }
-            if (path == "~") {
-                path = home;
-            } else {
-                path = home + path.substr(1);
-            }
+            return 0;
+        } else {
+            terms.push_back(arg);
         }
     }
     
-    return changeDirectory(path) ? 0 : 1;
+    if (listOnly || terms.empty()) {
+        // 按得分升序打印，最佳匹配在最下方
+        auto entries = dirDatabase_->list(terms, 20);
+        for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+            std::ostringstream score;
+            score << std::fixed << std::setprecision(1) << it->score;
+            std::cout << std::setw(8) << score.str() << "  " << it->path << std::endl;
+        }
+        return 0;
+    }
+    
+    std::string target = dirDatabase_->query(terms, shell->getCurrentDirectory());
+    if (target.empty()) {
+        std::cerr << "z: no match found" << std::endl;
+        return 1;
+    }
+    
+    return changeDirectory(target) ? 0 : 1;
 }
 
 int BuiltinCommands::cmdEcho(std::shared_ptr<Command> command) {
@@ -165,7 +373,7 @@ int BuiltinCommands::cmdUnset(std::shared_ptr<Command> command) {
     }
     
     for (const auto& var : command->arguments) {
-        unsetenv(var.c_str());
+        shell->unsetEnvironmentVariable(var);
     }
     
     return 0;
@@ -178,42 +386,114 @@ int BuiltinCommands::cmdHistory(std::shared_ptr<Command> command) {
         return 1;
     }
     
-    if (command->arguments.empty()) {
-        // 显示所有历史记录
-        hist->show();
-    } else {
-        std::string subcommand = command->arguments[0];
+    const auto& args = command->arguments;
+    HistoryFilter filter;
+    bool filtered = false;
+    bool verbose = false;
+    size_t last = 0;
+    std::vector<std::string> terms;
+    
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
         
-        if (subcommand == "-c" || subcommand == "clear") {
+        if (arg == "-c" || arg == "clear") {
             // 清空历史记录
             hist->clear();
             std::cout << "History cleared." << std::endl;
-        } else if (subcommand.substr(0, 1) == "-" && subcommand.length() > 1) {
+            return 0;
+        } else if (arg == "--export") {
+            hist->exportText(std::cout);
+            return 0;
+        } else if (arg == "--stats") {
+            printHistoryStats(hist->getStats());
+            return 0;
+        } else if (arg == "-v") {
+            verbose = true;
+        } else if (arg == "--failed") {
+            filter.failedOnly = true;
+            filtered = true;
+        } else if (arg == "--session") {
+            filter.currentSession = true;
+            filtered = true;
+        } else if (arg == "--cwd") {
+            // 不带参数或参数是选项时使用当前目录
+            if (i + 1 < args.size() && args[i + 1][0] != '-') {
+                filter.cwd = expandHome(args[++i]);
+                char resolved[PATH_MAX];
+                if (realpath(filter.cwd.c_str(), resolved)) {
+                    filter.cwd = resolved;
+                }
+            } else {
+                filter.cwd = shell->getCurrentDirectory();
+            }
+            filtered = true;
+        } else if (arg == "--since") {
+            if (i + 1 >= args.size() || !parseSince(args[i + 1], filter.since)) {
+                std::cerr << "history: --since expects a duration (30m, 2h, 1d) or a date (YYYY-MM-DD [HH:MM])" << std::endl;
+                return 1;
+            }
+            ++i;
+            filtered = true;
+        } else if (arg.size() > 1 && arg[0] == '-' && std::isdigit(static_cast<unsigned char>(arg[1]))) {
             // 显示最后 n 条命令
             try {
-                int n = std::stoi(subcommand.substr(1));
-                auto history = hist->getHistory();
-                size_t start = history.size() > n ? history.size() - n : 0;
-                
-                for (size_t i = start; i < history.size(); ++i) {
-                    std::cout << std::setw(4) << (i + 1) << "  " << history[i] << std::endl;
-                }
+                last = std::stoul(arg.substr(1));
             } catch (const std::exception&) {
                 std::cerr << "history: invalid number" << std::endl;
                 return 1;
             }
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "history: unknown option '" << arg << "'" << std::endl;
+            std::cerr << "usage: history [-c] [-v] [-N] [--stats] [--failed] [--session] [--cwd [DIR]] [--since WHEN] [--export] [pattern...]" << std::endl;
+            return 1;
         } else {
-            // 搜索历史记录
-            auto results = hist->search(subcommand);
-            if (results.empty()) {
-                std::cout << "No matching commands found." << std::endl;
-            } else {
-                auto history = hist->getHistory();
-                for (size_t index : results) {
-                    std::cout << std::setw(4) << (index + 1) << "  " << history[index] << std::endl;
-                }
-            }
+            terms.push_back(arg);
+        }
+    }
+    
+    auto print = [&](size_t index) {
+        HistoryRecord record = hist->getRecord(index);
+        std::cout << std::setw(4) << (index + 1) << "  ";
+        if (verbose) {
+            printHistoryDetails(record);
+        }
+        std::cout << record.command << std::endl;
+    };
+    
+    // 没有关键字和过滤条件时直接按序号输出，不复制历史
+    if (terms.empty() && !filtered) {
+        size_t count = hist->size();
+        for (size_t i = last > 0 && count > last ? count - last : 0; i < count; ++i) {
+            print(i);
         }
+        return 0;
+    }
+    
+    // 多个关键字时查找同时包含所有关键字的命令
+    std::vector<size_t> results;
+    if (!terms.empty()) {
+        results = hist->searchAll(terms);
+    } else {
+        results = hist->filter(filter);
+    }
+    
+    // 过滤条件与搜索同时给出时取交集（两者都是递增的序号）
+    if (filtered && !terms.empty()) {
+        std::vector<size_t> matched = hist->filter(filter);
+        std::vector<size_t> both;
+        std::set_intersection(results.begin(), results.end(), matched.begin(), matched.end(),
+                              std::back_inserter(both));
+        results.swap(both);
+    }
+    
+    if (results.empty()) {
+        std::cout << "No matching commands found." << std::endl;
+        return 0;
+    }
+    
+    size_t start = last > 0 && results.size() > last ? results.size() - last : 0;
+    for (size_t i = start; i < results.size(); ++i) {
+        print(results[i]);
     }
     
     return 0;
@@ -283,16 +563,22 @@ void BuiltinCommands::printHelp() {
     std::cout << "  help      - 显示此帮助信息" << std::endl;
     std::cout << "  exit [n]  - 退出shell，可选择退出码" << std::endl;
     std::cout << "  pwd       - 显示当前工作目录" << std::endl;
-    std::cout << "  cd [dir]  - 切换目录，无参数时切换到HOME" << std::endl;
+    std::cout << "  cd [dir]  - 切换目录，无参数时切换到HOME，cd - 返回上一个目录" << std::endl;
+    std::cout << "  pushd/popd/dirs - 目录栈操作" << std::endl;
+    std::cout << "  z <关键字> - 按访问频率和最近访问时间跳转目录（-l 列出，-x 删除当前目录）" << std::endl;
     std::cout << "  echo [-n] - 显示文本，-n选项不换行" << std::endl;
     std::cout << "  export    - 设置环境变量" << std::endl;
     std::cout << "  env       - 显示所有环境变量" << std::endl;
     std::cout << "  unset     - 删除环境变量" << std::endl;
-    std::cout << "  history   - 显示命令历史" << std::endl;
+    std::cout << "  history   - 显示命令历史（-v 显示时间/耗时/退出码，--failed、--cwd、--since 过滤，--export 导出，--stats 统计）" << std::endl;
     std::cout << "  clear     - 清屏" << std::endl;
     std::cout << "  which     - 查找命令位置" << std::endl;
     std::cout << "  set       - 配置自动补全和语法高亮" << std::endl;
     std::cout << "  ai        - 向AI助手提问" << std::endl;
+    std::cout << "  enable -f lib.so name - 从共享库加载内置命令（-d 卸载）" << std::endl;
+    std::cout << "  timeout [-s SIG] [-k DUR] DUR cmd - 超时后发送信号终止命令" << std::endl;
+    std::cout << "  retry [-n N] [--backoff exp|linear|none] cmd - 失败时按退避策略重试命令" << std::endl;
+    std::cout << "  complete [-W 词表] [-G 通配] [-F 函数] [-C 命令] [-fdcv] name - 注册补全规格（-p 列出，-r 删除）" << std::endl;
     std::cout << std::endl;
     std::cout << "特殊功能：" << std::endl;
     std::cout << "  > file    - 输出重定向" << std::endl;
@@ -302,6 +588,8 @@ void BuiltinCommands::printHelp() {
     std::cout << "  cmd &     - 后台运行" << std::endl;
     std::cout << "  $VAR      - 环境变量替换" << std::endl;
     std::cout << "  Tab       - 自动补全（安装readline时）" << std::endl;
+    std::cout << "  Ctrl-R    - 模糊查找历史命令（安装readline时）" << std::endl;
+    std::cout << "  →         - 接受灰色显示的历史建议（安装readline时）" << std::endl;
     std::cout << std::endl;
     std::cout << "AI助手设置：" << std::endl;
     std::cout << "  set ai-mode local|remote  - 设置AI模式为本地或远程" << std::endl;
@@ -310,22 +598,135 @@ void BuiltinCommands::printHelp() {
     std::cout << "  export LOCAL_AI_MODEL_PATH=<path> - 设置本地AI模型路径" << std::endl;
 }
 
+int BuiltinCommands::cmdEnable(std::shared_ptr<Command> command) {
+    const auto& args = command->arguments;
+    
+    if (args.empty()) {
+        // 列出所有内置命令，插件命令标注来源
+        for (const auto& item : builtinMap) {
+            std::cout << "enable " << item.first;
+            if (pluginLoader_->isLoaded(item.first)) {
+                for (const auto& plugin : pluginLoader_->list()) {
+                    if (plugin.first == item.first) {
+                        std::cout << "  (" << plugin.second << ")";
+                    }
+                }
+            }
+            std::cout << std::endl;
+        }
+        return 0;
+    }
+    
+    if (args[0] == "-f") {
+        if (args.size() < 3) {
+            std::cerr << "enable: usage: enable -f file name [name ...]" << std::endl;
+            return 1;
+        }
+        
+        int status = 0;
+        for (size_t i = 2; i < args.size(); ++i) {
+            const std::string& name = args[i];
+            if (isBuiltinCommand(name) && !pluginLoader_->isLoaded(name)) {
+                std::cerr << "enable: " << name << ": cannot override shell builtin" << std::endl;
+                status = 1;
+                continue;
+            }
+            
+            std::string error;
+            if (!pluginLoader_->load(args[1], name, error)) {
+                std::cerr << "enable: " << error << std::endl;
+                status = 1;
+                continue;
+            }
+            builtinMap[name] = [this](std::shared_ptr<Command> cmd) { return pluginLoader_->run(cmd); };
+        }
+        return status;
+    }
+    
+    if (args[0] == "-d") {
+        int status = 0;
+        for (size_t i = 1; i < args.size(); ++i) {
+            if (!pluginLoader_->isLoaded(args[i])) {
+                std::cerr << "enable: " << args[i] << ": not dynamically loaded" << std::endl;
+                status = 1;
+                continue;
+            }
+            builtinMap.erase(args[i]);
+            pluginLoader_->unload(args[i]);
+        }
+        return status;
+    }
+    
+    std::cerr << "enable: usage: enable [-f file name ...] [-d name ...]" << std::endl;
+    return 1;
+}
+
+int BuiltinCommands::cmdComplete(std::shared_ptr<Command> command) {
+    CompletionEngine* engine = shell->getCompletionEngine();
+    if (!engine) {
+        std::cerr << "complete: completion is not available" << std::endl;
+        return 1;
+    }
+    
+    std::string error;
+    if (!engine->getSpecs().execute(command->arguments, std::cout, error)) {
+        std::cerr << "complete: " << error << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
 bool BuiltinCommands::changeDirectory(const std::string& path) {
+    std::string oldPwd = shell->getCurrentDirectory();
+    
     if (chdir(path.c_str()) == -1) {
         perror("cd");
         return false;
     }
     
-    // 更新PWD环境变量
+    // 更新OLDPWD和PWD环境变量
+    shell->setEnvironmentVariable("OLDPWD", oldPwd);
     char* newPwd = getcwd(nullptr, 0);
     if (newPwd) {
         shell->setEnvironmentVariable("PWD", newPwd);
+        // 记录访问，供z命令跳转使用
+        dirDatabase_->recordVisit(newPwd);
         free(newPwd);
     }
     
     return true;
 }
 
+std::string BuiltinCommands::expandHome(const std::string& path) {
+    if (path != "~" && path.substr(0, 2) != "~/") {
+        return path;
+    }
+    
+    std::string home = shell->getEnvironmentVariable("HOME");
+    if (home.empty()) {
+        return "";
+    }
+    return path == "~" ? home : home + path.substr(1);
+}
+
+void BuiltinCommands::printDirStack() {
+    std::string home = shell->getEnvironmentVariable("HOME");
+    auto shorten = [&home](const std::string& dir) {
+        if (!home.empty() && dir.compare(0, home.size(), home) == 0 &&
+            (dir.size() == home.size() || dir[home.size()] == '/')) {
+            return "~" + dir.substr(home.size());
+        }
+        return dir;
+    };
+    
+    // 栈顶（当前目录）在最左边
+    std::cout << shorten(shell->getCurrentDirectory());
+    for (auto it = dirStack_.rbegin(); it != dirStack_.rend(); ++it) {
+        std::cout << " " << shorten(*it);
+    }
+    std::cout << std::endl;
+}
+
 
 
 int BuiltinCommands::cmdSet(std::shared_ptr<Command> command) {
@@ -334,12 +735,27 @@ int BuiltinCommands::cmdSet(std::shared_ptr<Command> command) {
         std::cout << "MyShell 设置:" << std::endl;
         std::cout << "  completion: " << (shell->isCompletionEnabled() ? "enabled" : "disabled") << std::endl;
         std::cout << "  syntax-highlight: " << (shell->isSyntaxHighlightEnabled() ? "enabled" : "disabled") << std::endl;
+        std::cout << "  autosuggest: " << (shell->isAutosuggestEnabled() ? "enabled" : "disabled") << std::endl;
+        std::string theme = shell->getThemePath();
+        std::cout << "  theme: " << (theme.empty() ? "default" : theme) << std::endl;
+        if (History* hist = shell->getHistory()) {
+            size_t maxSize = hist->getMaxSize();
+            std::cout << "  history-size: "
+                      << (maxSize == History::kUnlimited ? std::string("unlimited") : std::to_string(maxSize))
+                      << std::endl;
+            std::string control = hist->getControl();
+            std::cout << "  history-control: " << (control.empty() ? "none" : control) << std::endl;
+        }
         std::cout << std::endl;
         std::cout << "用法:" << std::endl;
         std::cout << "  set completion on|off     - 启用/禁用自动补全" << std::endl;
         std::cout << "  set syntax-highlight on|off - 启用/禁用语法高亮" << std::endl;
+        std::cout << "  set autosuggest on|off    - 启用/禁用历史命令自动建议" << std::endl;
+        std::cout << "  set theme <file>|default  - 设置语法高亮的配色主题" << std::endl;
         std::cout << "  set ai-mode local|remote  - 设置AI模式为本地或远程" << std::endl;
         std::cout << "  set ai-model-path <path>  - 设置本地AI模型路径" << std::endl;
+        std::cout << "  set history-size N|unlimited - 设置保留的历史条数" << std::endl;
+        std::cout << "  set history-control OPTS  - ignorespace、ignoredups、ignoreboth、erasedups（冒号分隔）或none" << std::endl;
         return 0;
     }
     
@@ -364,6 +780,20 @@ int BuiltinCommands::cmdSet(std::shared_ptr<Command> command) {
         shell->setSyntaxHighlightEnabled(enable);
         std::cout << "Syntax highlighting " << (enable ? "enabled" : "disabled") << std::endl;
         return 0;
+    } else if (option == "autosuggest") {
+        shell->setAutosuggestEnabled(enable);
+        std::cout << "Autosuggestions " << (enable ? "enabled" : "disabled") << std::endl;
+        return 0;
+    } else if (option == "theme") {
+        // 文件名区分大小写，用原始参数
+        std::string path = value == "default" ? "" : command->arguments[1];
+        std::string error;
+        if (!shell->loadTheme(path, error)) {
+            std::cerr << "set: theme: " << error << std::endl;
+            return 1;
+        }
+        std::cout << "Theme set to " << (path.empty() ? "default" : path) << std::endl;
+        return 0;
     } else if (option == "ai-mode") {
         if (aiClient_) {
             if (value == "local") {
@@ -391,9 +821,27 @@ int BuiltinCommands::cmdSet(std::shared_ptr<Command> command) {
             std::cerr << "set: AI client not available" << std::endl;
             return 1;
         }
+    } else if (option == "history-size") {
+        size_t maxSize;
+        History* hist = shell->getHistory();
+        if (!hist || !History::parseSize(value, maxSize)) {
+            std::cerr << "set: history-size expects a number or 'unlimited'" << std::endl;
+            return 1;
+        }
+        hist->setMaxSize(maxSize);
+        std::cout << "History size set to " << value << std::endl;
+        return 0;
+    } else if (option == "history-control") {
+        History* hist = shell->getHistory();
+        if (!hist || !hist->setControl(value == "none" ? "" : value)) {
+            std::cerr << "set: history-control expects ignorespace, ignoredups, ignoreboth, erasedups or none" << std::endl;
+            return 1;
+        }
+        std::cout << "History control set to " << value << std::endl;
+        return 0;
     } else {
         std::cerr << "set: unknown option '" << option << "'" << std::endl;
-        std::cerr << "Available options: completion, syntax-highlight, ai-mode, ai-model-path" << std::endl;
+        std::cerr << "Available options: completion, syntax-highlight, autosuggest, theme, ai-mode, ai-model-path, history-size, history-control" << std::endl;
         return 1;
     }
 }
\ No newline at end of file
@@ -3,8 +3,11 @@
 
 #include "parser.h"
 #include "ai_client.h"  // 添加AI客户端头文件
+#include "directory_db.h"
+#include "plugin_loader.h"
 #include <memory>
 #include <map>
+#include <vector>
 #include <functional>
 
 class Shell;
@@ -17,12 +20,18 @@ public:
     // 检查是否是内置命令
     bool isBuiltinCommand(const std::string& command);
     
+    // 所有内置命令的名字（有序）
+    std::vector<std::string> getCommandNames() const;
+    
     // 执行内置命令
     int execute(std::shared_ptr<Command> command);
     
 private:
     Shell* shell;
     std::unique_ptr<AIClient> aiClient_;  // 添加AI客户端成员
+    std::unique_ptr<DirectoryDatabase> dirDatabase_;  // 目录访问频率数据库（z命令）
+    std::vector<std::string> dirStack_;               // pushd/popd目录栈
+    std::unique_ptr<PluginLoader> pluginLoader_;      // enable -f 加载的插件命令
     std::map<std::string, std::function<int(std::shared_ptr<Command>)>> builtinMap;
     
     // 内置命令实现
@@ -39,6 +48,14 @@ private:
     int cmdWhich(std::shared_ptr<Command> command);
     int cmdSet(std::shared_ptr<Command> command);  // 新增：配置设置命令
     int cmdAi(std::shared_ptr<Command> command);   // 新增：AI问答命令
+    int cmdPushd(std::shared_ptr<Command> command);
+    int cmdPopd(std::shared_ptr<Command> command);
+    int cmdDirs(std::shared_ptr<Command> command);
+    int cmdZ(std::shared_ptr<Command> command);
+    int cmdEnable(std::shared_ptr<Command> command);
+    int cmdTimeout(std::shared_ptr<Command> command);
+    int cmdRetry(std::shared_ptr<Command> command);
+    int cmdComplete(std::shared_ptr<Command> command);
     
     // 初始化内置命令映射
     void initializeBuiltins();
@@ -46,6 +63,8 @@ private:
     // 辅助函数
     void printHelp();
     bool changeDirectory(const std::string& path);
+    std::string expandHome(const std::string& path);
+    void printDirStack();
 };
 
 #endif // BUILTIN_H
\ No newline at end of file
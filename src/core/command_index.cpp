@@ -0,0 +1,245 @@
+#include "command_index.h"
+#include "platform.h"
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <sstream>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#ifdef PLATFORM_LINUX
+#include <sys/inotify.h>
+#endif
+
+namespace {
+
+// 目录变化后等待这么久没有新的变化再重新扫描（安装软件包时会连续产生大量事件）
+constexpr int kSettleMs = 200;
+
+std::vector<std::string> splitPath(const std::string& path) {
+    std::vector<std::string> dirs;
+    std::istringstream iss(path);
+    std::string dir;
+    while (std::getline(iss, dir, ':')) {
+        if (!dir.empty() && std::find(dirs.begin(), dirs.end(), dir) == dirs.end()) {
+            dirs.push_back(dir);
+        }
+    }
+    return dirs;
+}
+
+void drain(int fd) {
+    char buffer[4096];
+    while (read(fd, buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+} // namespace
+
+CommandIndex::CommandIndex()
+    : wakeFds_{-1, -1}, pathChanged_(false), stop_(false),
+      snapshot_(std::make_shared<const std::vector<std::string>>()), ready_(false) {}
+
+CommandIndex::~CommandIndex() {
+    if (worker_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake();
+        worker_.join();
+    }
+    for (int fd : wakeFds_) {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+}
+
+void CommandIndex::update(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (worker_.joinable() && path == path_) {
+            return;
+        }
+        path_ = path;
+        pathChanged_ = true;
+    }
+
+    if (!worker_.joinable()) {
+        if (pipe(wakeFds_) == -1) {
+            // 没有管道就无法通知后台线程，退回同步扫描一次
+            publish(std::make_shared<const std::vector<std::string>>(scan(path)));
+            return;
+        }
+        for (int fd : wakeFds_) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+        worker_ = std::thread(&CommandIndex::run, this);
+    } else {
+        wake();
+    }
+}
+
+CommandIndex::Snapshot CommandIndex::snapshot() const {
+    return std::atomic_load(&snapshot_);
+}
+
+void CommandIndex::setListener(std::function<void()> listener) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    listener_ = std::move(listener);
+}
+
+std::vector<BkTree::Match> CommandIndex::similar(const std::string& word, int maxDistance, size_t limit) const {
+    std::lock_guard<std::mutex> lock(treeMutex_);
+    return tree_.search(word, maxDistance, limit);
+}
+
+void CommandIndex::publish(Snapshot commands) {
+    Snapshot previous = std::atomic_exchange(&snapshot_, commands);
+
+    // 两个快照都有序，求出增加和删除的命令后增量更新BK树
+    std::vector<std::string> added, removed;
+    std::set_difference(commands->begin(), commands->end(), previous->begin(), previous->end(),
+                        std::back_inserter(added));
+    std::set_difference(previous->begin(), previous->end(), commands->begin(), commands->end(),
+                        std::back_inserter(removed));
+
+    {
+        std::lock_guard<std::mutex> lock(treeMutex_);
+        for (const std::string& command : removed) {
+            tree_.erase(command);
+        }
+        for (const std::string& command : added) {
+            tree_.insert(command);
+        }
+    }
+    
+    bool first = !ready_.exchange(true, std::memory_order_acq_rel);
+    std::function<void()> listener;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        listener = listener_;
+    }
+    if (listener && (first || !added.empty() || !removed.empty())) {
+        listener();
+    }
+}
+
+void CommandIndex::wake() {
+    char byte = 0;
+    ssize_t written = write(wakeFds_[1], &byte, 1);
+    (void)written; // 管道满时后台线程本来就会被唤醒
+}
+
+void CommandIndex::run() {
+    int inotifyFd = -1;
+    bool dirty = false;
+
+    while (true) {
+        std::string path;
+        bool rewatch = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stop_) {
+                break;
+            }
+            if (pathChanged_) {
+                path = path_;
+                pathChanged_ = false;
+                rewatch = dirty = true;
+            }
+        }
+
+#ifdef PLATFORM_LINUX
+        if (rewatch) {
+            // 重新创建inotify实例，旧的监视随之全部移除
+            if (inotifyFd != -1) {
+                close(inotifyFd);
+            }
+            inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (inotifyFd != -1) {
+                for (const std::string& dir : splitPath(path)) {
+                    // 不存在的目录无法监视，等PATH变化时再试
+                    inotify_add_watch(inotifyFd, dir.c_str(),
+                                      IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB |
+                                      IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+                }
+            }
+        }
+#else
+        (void)rewatch;  // 没有inotify：只在PATH变化时重新扫描
+#endif
+
+        if (dirty) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                path = path_;
+            }
+            publish(std::make_shared<const std::vector<std::string>>(scan(path)));
+            dirty = false;
+        }
+
+        struct pollfd fds[2] = {{wakeFds_[0], POLLIN, 0}, {inotifyFd, POLLIN, 0}};
+        int count = inotifyFd != -1 ? 2 : 1;
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            drain(wakeFds_[0]);
+        }
+        if (count == 2 && (fds[1].revents & POLLIN)) {
+            // 合并连续的变化：直到一段时间内没有新事件（或被唤醒）才扫描
+            drain(inotifyFd);
+            while (poll(fds, 2, kSettleMs) > 0 && !(fds[0].revents & POLLIN)) {
+                drain(inotifyFd);
+            }
+            dirty = true;
+        }
+    }
+
+    if (inotifyFd != -1) {
+        close(inotifyFd);
+    }
+}
+
+std::vector<std::string> CommandIndex::scan(const std::string& path) {
+    std::vector<std::string> commands;
+
+    for (const std::string& dir : splitPath(path)) {
+        DIR* d = opendir(dir.c_str());
+        if (!d) {
+            continue; // 忽略不存在或无法访问的目录
+        }
+        int fd = dirfd(d);
+        struct dirent* entry;
+        while ((entry = readdir(d)) != nullptr) {
+            if (entry->d_name[0] == '.' || entry->d_type == DT_DIR) {
+                continue;
+            }
+            // 符号链接和未知类型需要确认指向的是普通文件（目录也有执行权限）
+            if (entry->d_type != DT_REG) {
+                struct stat st;
+                if (fstatat(fd, entry->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+                    continue;
+                }
+            }
+            if (faccessat(fd, entry->d_name, X_OK, 0) == 0) {
+                commands.emplace_back(entry->d_name);
+            }
+        }
+        closedir(d);
+    }
+
+    std::sort(commands.begin(), commands.end());
+    commands.erase(std::unique(commands.begin(), commands.end()), commands.end());
+    return commands;
+}
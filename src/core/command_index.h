@@ -0,0 +1,68 @@
+#ifndef COMMAND_INDEX_H
+#define COMMAND_INDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "bk_tree.h"
+
+// PATH中可执行命令的索引（命令补全用）
+//
+// 扫描在后台线程进行，完成后整体替换快照；补全时只取一个shared_ptr，从不等待扫描。
+// Linux上用inotify监视PATH中的目录，安装、删除命令后（合并短时间内的多次变化）重新扫描。
+// 后台线程还按新旧快照的差异增量维护一棵BK树，用于按编辑距离查找相近的命令。
+class CommandIndex {
+public:
+    // 按名字排序、去重的命令列表
+    using Snapshot = std::shared_ptr<const std::vector<std::string>>;
+
+    CommandIndex();
+    ~CommandIndex();
+
+    CommandIndex(const CommandIndex&) = delete;
+    CommandIndex& operator=(const CommandIndex&) = delete;
+
+    // 设置PATH并在后台扫描（第一次调用时启动后台线程）；PATH没有变化时什么也不做
+    void update(const std::string& path);
+
+    // 当前的命令列表；第一次扫描完成前为空列表
+    Snapshot snapshot() const;
+    
+    // 第一次扫描是否已经完成
+    bool ready() const { return ready_.load(std::memory_order_acquire); }
+    
+    // 每次替换快照后调用（在后台线程中）
+    void setListener(std::function<void()> listener);
+    
+    // 与word的编辑距离不超过maxDistance的命令，按距离、名字排序，最多limit个
+    std::vector<BkTree::Match> similar(const std::string& word, int maxDistance, size_t limit) const;
+
+private:
+    std::thread worker_;
+    int wakeFds_[2];            // 管道：通知后台线程PATH变化或退出
+
+    std::mutex mutex_;          // 保护path_、pathChanged_、stop_、listener_
+    std::string path_;
+    bool pathChanged_;
+    bool stop_;
+    std::function<void()> listener_;
+
+    Snapshot snapshot_;         // 用std::atomic_load/atomic_store读写
+    std::atomic<bool> ready_;
+    
+    mutable std::mutex treeMutex_;
+    BkTree tree_;
+
+    void run();
+    void publish(Snapshot commands);
+    void wake();
+
+    // 扫描PATH中的目录，返回排序去重后的可执行文件名
+    static std::vector<std::string> scan(const std::string& path);
+};
+
+#endif // COMMAND_INDEX_H
@@ -5,52 +5,220 @@
 #include <sstream>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <poll.h>
+#include <csignal>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <iterator>
+
+extern char** environ;
+
+namespace {
+
+// 有序数组中以prefix开头的连续区间：lower_bound定位起点，向后扫描到第一个不匹配的
+std::pair<std::vector<std::string>::const_iterator, std::vector<std::string>::const_iterator>
+prefixRange(const std::vector<std::string>& sorted, const std::string& prefix) {
+    auto first = std::lower_bound(sorted.begin(), sorted.end(), prefix);
+    auto last = first;
+    while (last != sorted.end() && last->compare(0, prefix.size(), prefix) == 0) {
+        ++last;
+    }
+    return {first, last};
+}
+
+// 加上单引号，作为sh命令的一个参数
+std::string shellQuote(const std::string& text) {
+    std::string quoted = "'";
+    for (char c : text) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+}
+
+// 文件补全最多返回的候选数；目录再大也只保留按名字排在最前的这些
+constexpr size_t kMaxFileCandidates = 1000;
+
+// 外部补全命令的输出多久检查一次是否被要求停止
+constexpr int kCommandPollMs = 20;
+
+struct DirectoryEntry {
+    std::string name;
+    unsigned char type;
+};
+
+// 列出目录中以prefix开头的条目，最多保留limit个（名字最小的），按名字排序。
+// total返回匹配的总数，common返回所有匹配（包括没有保留的）名字的最长公共前缀；
+// 被要求停止时返回已读到的部分并将partial置位。目录列表来自cache，目录没有变化时不重新读取
+std::vector<DirectoryEntry> listDirectory(DirectoryCache& cache, const std::string& dir, const std::string& prefix,
+                                          size_t limit, const CompletionContext& context,
+                                          size_t& total, std::string& common, bool& partial) {
+    std::vector<DirectoryEntry> entries;
+    total = 0;
+    common.clear();
+    
+    auto listing = cache.list(dir, context.stop, partial);
+    if (!listing) {
+        return entries;
+    }
+    
+    // 列表已排序：匹配的条目是一个连续区间，公共前缀就是首尾两项的公共前缀
+    auto range = listing->prefixRange(prefix);
+    total = range.second - range.first;
+    if (total > 0) {
+        const char* first = listing->name(range.first);
+        const char* last = listing->name(range.second - 1);
+        size_t i = prefix.size();
+        while (first[i] && first[i] == last[i]) {
+            ++i;
+        }
+        common.assign(first, i);
+    }
+    
+    // 只有文件系统不提供类型和符号链接才需要stat（跟随链接判断是否目录）；
+    // 链接指向的目标可能变化，所以不缓存结果
+    size_t count = std::min(total, limit);
+    entries.reserve(count);
+    for (size_t i = range.first; i < range.first + count; ++i) {
+        DirectoryEntry entry{listing->name(i), listing->type(i)};
+        if (entry.type == DT_UNKNOWN || entry.type == DT_LNK) {
+            struct stat st;
+            if (context.stopRequested()) {
+                partial = true;
+            } else if (stat((dir + entry.name).c_str(), &st) == 0) {
+                entry.type = S_ISDIR(st.st_mode) ? DT_DIR : DT_REG;
+            }
+        }
+        entries.push_back(std::move(entry));
+    }
+    return entries;
+}
+
+} // namespace
 
 CompletionEngine::CompletionEngine(Shell* shell) : shell_(shell) {
     initializeBuiltinCommands();
-    cacheSystemCommands();
+    
+    // 补全规格可以使用的内置补全函数
+    functions_["file"] = [this](const CompletionContext& context) { return completeFilePath(context); };
+    functions_["directory"] = [this](const CompletionContext& context) {
+        auto candidates = completeFilePath(context);
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                        [](const CompletionCandidate& c) { return c.text.back() != '/'; }),
+                         candidates.end());
+        return candidates;
+    };
+    functions_["command"] = [this](const CompletionContext& context) { return completeCommand(context); };
+    functions_["builtin"] = [this](const CompletionContext& context) { return completeBuiltinCommand(context); };
+    functions_["variable"] = [this](const CompletionContext& context) { return completeEnvironmentVariable(context); };
+}
+
+void CompletionEngine::refreshSystemCommands() {
+    system_commands_.update(shell_->getEnvironmentVariable("PATH"));
+}
+
+std::shared_ptr<const CompletionEnvironment> CompletionEngine::snapshotEnvironment() {
+    auto environment = std::make_shared<CompletionEnvironment>();
+    environment->cwd = shell_->getCurrentDirectory();
+    environment->path = shell_->getEnvironmentVariable("PATH");
+    for (char** entry = environ; entry && *entry; ++entry) {
+        environment->variables.emplace_back(*entry);
+    }
+    return environment;
+}
+
+CompletionEngine::Completer CompletionEngine::findCompleter(CompletionType type) {
+    std::lock_guard<std::mutex> lock(completers_mutex_);
+    auto it = custom_completers_.find(type);
+    return it != custom_completers_.end() ? it->second : Completer();
+}
+
+CompletionEngine::Completer CompletionEngine::findCompleter(const std::string& name) {
+    std::lock_guard<std::mutex> lock(completers_mutex_);
+    auto it = functions_.find(name);
+    return it != functions_.end() ? it->second : Completer();
+}
+
+void CompletionEngine::refresh() {
+    refreshSystemCommands();
+    
+    std::string directory = shell_->getEnvironmentVariable("MYSH_COMPLETION_DIR");
+    if (directory.empty()) {
+        std::string home = shell_->getEnvironmentVariable("HOME");
+        if (!home.empty()) {
+            directory = home + "/.mysh_completions";
+        }
+    }
+    specs_.setDirectory(directory);
+    
+    std::string home = shell_->getEnvironmentVariable("HOME");
+    options_.setCacheDirectory(home.empty() ? "" : home + "/.mysh_options");
+}
+
+std::vector<CompletionCandidate> CompletionEngine::run(CompletionType type,
+    std::vector<CompletionCandidate> (CompletionEngine::*builtin)(const CompletionContext&),
+    const CompletionContext& context) {
+    if (Completer completer = findCompleter(type)) {
+        auto candidates = completer(context);
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const CompletionCandidate& a, const CompletionCandidate& b) { return a.text < b.text; });
+        return candidates;
+    }
+    return (this->*builtin)(context);
 }
 
 std::vector<CompletionCandidate> CompletionEngine::complete(const CompletionContext& context) {
     std::vector<CompletionCandidate> candidates;
+    context.truncated = false;
+    context.common_prefix.clear();
     
     // 根据上下文决定补全类型
     if (context.is_first_word) {
         // 第一个词：补全命令
-        auto command_candidates = completeCommand(context);
-        candidates.insert(candidates.end(), command_candidates.begin(), command_candidates.end());
-    } else {
-        // 其他位置：根据内容类型补全
-        if (context.word.empty() || context.word[0] == '/') {
-            // 绝对路径或空词：文件路径补全
-            auto file_candidates = completeFilePath(context);
-            candidates.insert(candidates.end(), file_candidates.begin(), file_candidates.end());
-        } else if (context.word[0] == '$') {
-            // 环境变量补全
-            auto env_candidates = completeEnvironmentVariable(context);
-            candidates.insert(candidates.end(), env_candidates.begin(), env_candidates.end());
-        } else if (context.word[0] == '-') {
-            // 选项补全（暂时不实现具体选项）
-            // 可以根据第一个命令来提供相应的选项补全
-        } else {
-            // 默认：文件路径补全
-            auto file_candidates = completeFilePath(context);
-            candidates.insert(candidates.end(), file_candidates.begin(), file_candidates.end());
+        candidates = run(CompletionType::COMMAND, &CompletionEngine::completeCommand, context);
+    } else if ((!context.word.empty() && context.word[0] == '$') ||
+               (context.word_start > 0 && context.line[context.word_start - 1] == '$')) {
+        // 环境变量补全（readline把$当作分词符，当前词可能不含$）
+        candidates = run(CompletionType::ENVIRONMENT, &CompletionEngine::completeEnvironmentVariable, context);
+    } else if (auto spec = specs_.find(context.words)) {
+        // 命令注册了补全规格（complete内置命令或规格文件）；规格中没有匹配的选项时用命令自己的选项
+        candidates = completeFromSpec(*spec, context);
+        if (candidates.empty() && !context.word.empty() && context.word[0] == '-') {
+            candidates = run(CompletionType::OPTION, &CompletionEngine::completeOption, context);
         }
+    } else if (!context.word.empty() && context.word[0] == '-') {
+        // 选项补全：从命令的man手册或--help输出中提取
+        candidates = run(CompletionType::OPTION, &CompletionEngine::completeOption, context);
+    } else {
+        // 默认：文件路径补全
+        candidates = run(CompletionType::FILE_PATH, &CompletionEngine::completeFilePath, context);
     }
     
-    // 排序候选项
-    std::sort(candidates.begin(), candidates.end(), 
-        [](const CompletionCandidate& a, const CompletionCandidate& b) {
-            return a.text < b.text;
-        });
-    
+    // 各补全器返回的候选已经按文本排序
     return candidates;
 }
 
-std::vector<std::string> CompletionEngine::getCompletions(const std::string& text, int start, int end) {
+std::vector<std::string> CompletionEngine::getCompletions(const std::string& text, int start, int end,
+                                                          std::string* common_prefix,
+                                                          const std::atomic<bool>* stop,
+                                                          std::shared_ptr<const CompletionEnvironment> environment) {
+    return getCompletions(text, Lexer::tokenize(text), start, end, common_prefix, stop, std::move(environment));
+}
+
+std::vector<std::string> CompletionEngine::getCompletions(const std::string& text, const std::vector<Token>& tokens,
+                                                          int start, int end, std::string* common_prefix,
+                                                          const std::atomic<bool>* stop,
+                                                          std::shared_ptr<const CompletionEnvironment> environment) {
     // 解析上下文
     CompletionContext context;
     context.line = text;
@@ -59,22 +227,50 @@ std::vector<std::string> CompletionEngine::getCompletions(const std::string& tex
     context.word_end = end;
     context.word = text.substr(start, end - start);
     
-    // 简单的分词
-    std::istringstream iss(text.substr(0, start));
-    std::string word;
-    while (iss >> word) {
-        context.words.push_back(word);
+    // 当前词之前、同一条命令（最后一个| ; && || &之后）中的词；重定向和它的目标不算
+    bool redirect = false;
+    for (const Token& token : tokens) {
+        if (token.end > static_cast<size_t>(start)) {
+            break;
+        }
+        if (Lexer::separatesCommands(token.kind)) {
+            context.words.clear();
+        } else if (token.kind == TokenKind::WORD && !redirect) {
+            std::string_view word = std::string_view(text).substr(token.start, token.end - token.start);
+            context.words.push_back(Lexer::unquote(word));
+        }
+        redirect = token.kind == TokenKind::REDIRECT;
     }
     context.is_first_word = context.words.empty();
+    context.stop = stop;
+    context.environment = environment ? std::move(environment) : snapshotEnvironment();
     
     // 获取补全候选项
     auto candidates = complete(context);
     
-    // 转换为字符串列表
+    // 转换为字符串列表（候选都以当前词开头，不需要再过滤）
     std::vector<std::string> completions;
-    for (const auto& candidate : candidates) {
-        if (candidate.text.find(context.word) == 0) {
-            completions.push_back(candidate.text);
+    completions.reserve(candidates.size());
+    for (auto& candidate : candidates) {
+        completions.push_back(std::move(candidate.text));
+    }
+    
+    // 候选被截断时公共前缀由补全器给出，否则在这里计算
+    if (common_prefix) {
+        if (context.truncated) {
+            *common_prefix = context.common_prefix;
+        } else if (!completions.empty()) {
+            size_t common = completions[0].size();
+            for (const auto& completion : completions) {
+                size_t i = 0;
+                while (i < common && i < completion.size() && completion[i] == completions[0][i]) {
+                    ++i;
+                }
+                common = i;
+            }
+            *common_prefix = completions[0].substr(0, common);
+        } else {
+            common_prefix->clear();
         }
     }
     
@@ -84,57 +280,104 @@ std::vector<std::string> CompletionEngine::getCompletions(const std::string& tex
 std::vector<CompletionCandidate> CompletionEngine::completeCommand(const CompletionContext& context) {
     std::vector<CompletionCandidate> candidates;
     
-    // 内置命令补全
-    for (const auto& cmd : builtin_commands_) {
-        if (cmd.find(context.word) == 0) {
-            candidates.emplace_back(cmd, "内置命令", CompletionType::BUILTIN);
+    // 系统命令使用后台扫描的快照，第一次扫描完成前只有内置命令
+    system_commands_.update(context.environment->path);
+    auto system_commands = system_commands_.snapshot();
+    
+    // 两个有序区间归并，结果仍然有序；与内置命令同名的系统命令只保留内置命令
+    auto builtins = prefixRange(builtin_commands_, context.word);
+    auto commands = prefixRange(*system_commands, context.word);
+    candidates.reserve((builtins.second - builtins.first) + (commands.second - commands.first));
+    auto b = builtins.first;
+    auto c = commands.first;
+    while (b != builtins.second || c != commands.second) {
+        if (c == commands.second || (b != builtins.second && *b <= *c)) {
+            if (c != commands.second && *b == *c) {
+                ++c;
+            }
+            candidates.emplace_back(*b++, "内置命令", CompletionType::BUILTIN);
+        } else {
+            candidates.emplace_back(*c++, "系统命令", CompletionType::COMMAND);
         }
     }
     
-    // 系统命令补全
-    for (const auto& cmd : system_commands_) {
-        if (cmd.find(context.word) == 0) {
-            candidates.emplace_back(cmd, "系统命令", CompletionType::COMMAND);
+    // 没有以当前词开头的命令时，给出编辑距离相近的命令（拼写错误）
+    if (candidates.empty() && context.word.size() >= 2) {
+        for (const std::string& command : suggestCommands(context.word)) {
+            candidates.emplace_back(command, "近似命令", CompletionType::COMMAND);
         }
     }
     
     return candidates;
 }
 
+std::vector<std::string> CompletionEngine::suggestCommands(const std::string& word, size_t limit) {
+    // 短的词只允许一处错误，否则太多不相干的命令
+    int max_distance = word.size() <= 4 ? 1 : 2;
+    
+    std::vector<BkTree::Match> matches = system_commands_.similar(word, max_distance, limit);
+    for (const std::string& builtin : builtin_commands_) {
+        int distance = BkTree::distance(word, builtin);
+        if (distance <= max_distance) {
+            matches.push_back({builtin, distance});
+        }
+    }
+    std::stable_sort(matches.begin(), matches.end(), [](const BkTree::Match& a, const BkTree::Match& b) {
+        return a.distance < b.distance;
+    });
+    
+    std::vector<std::string> commands;
+    for (const auto& match : matches) {
+        if (commands.size() < limit && std::find(commands.begin(), commands.end(), match.word) == commands.end()) {
+            commands.push_back(match.word);
+        }
+    }
+    return commands;
+}
+
 std::vector<CompletionCandidate> CompletionEngine::completeFilePath(const CompletionContext& context) {
     std::vector<CompletionCandidate> candidates;
     
     std::string word = context.word;
     std::string dir_path;
+    std::string typed_dir;      // 用户输入的目录部分，候选需要带上它才能替换当前词
     std::string file_prefix;
     
     // 解析目录和文件前缀
     size_t last_slash = word.find_last_of('/');
     if (last_slash != std::string::npos) {
         dir_path = word.substr(0, last_slash + 1);
+        typed_dir = dir_path;
         file_prefix = word.substr(last_slash + 1);
         if (dir_path[0] != '/') {
             // 相对路径，前面加上当前目录
-            dir_path = shell_->getCurrentDirectory() + "/" + dir_path;
+            dir_path = context.environment->cwd + "/" + dir_path;
         }
     } else {
         // 当前目录
-        dir_path = shell_->getCurrentDirectory() + "/";
+        dir_path = context.environment->cwd + "/";
         file_prefix = word;
     }
     
-    // 获取目录中的文件
-    auto files = getFilesInDirectory(dir_path, file_prefix);
+    // 获取目录中的文件（已排序）；超过上限时记下全部匹配的公共前缀，保证Tab插入的文本正确
+    size_t total = 0;
+    std::string common;
+    bool partial = false;
+    auto files = listDirectory(directories_, dir_path, file_prefix, kMaxFileCandidates, context, total, common, partial);
+    if (partial) {
+        // 没有读完目录，不知道全部匹配的公共前缀，不插入任何文本
+        context.truncated = true;
+        context.common_prefix = word;
+    } else if (total > files.size()) {
+        context.truncated = true;
+        context.common_prefix = typed_dir + common;
+    }
+    candidates.reserve(files.size());
     for (const auto& file : files) {
-        std::string full_path = dir_path + file;
-        struct stat st;
-        if (stat(full_path.c_str(), &st) == 0) {
-            std::string desc = S_ISDIR(st.st_mode) ? "目录" : "文件";
-            if (S_ISDIR(st.st_mode)) {
-                candidates.emplace_back(file + "/", desc, CompletionType::FILE_PATH);
-            } else {
-                candidates.emplace_back(file, desc, CompletionType::FILE_PATH);
-            }
+        if (file.type == DT_DIR) {
+            candidates.emplace_back(typed_dir + file.name + "/", "目录", CompletionType::FILE_PATH);
+        } else {
+            candidates.emplace_back(typed_dir + file.name, "文件", CompletionType::FILE_PATH);
         }
     }
     
@@ -144,121 +387,258 @@ std::vector<CompletionCandidate> CompletionEngine::completeFilePath(const Comple
 std::vector<CompletionCandidate> CompletionEngine::completeEnvironmentVariable(const CompletionContext& context) {
     std::vector<CompletionCandidate> candidates;
     
-    std::string var_name = context.word.substr(1); // 去掉 $
-    
-    // 常见环境变量
-    std::vector<std::string> common_vars = {
-        "HOME", "PATH", "USER", "SHELL", "PWD", "TERM", "LANG", "TZ"
-    };
+    // 当前词带$时候选也带$，否则$在当前词之前
+    bool dollar = !context.word.empty() && context.word[0] == '$';
+    std::string var_name = dollar ? context.word.substr(1) : context.word;
     
-    for (const auto& var : common_vars) {
-        if (var.find(var_name) == 0) {
-            std::string value = shell_->getEnvironmentVariable(var);
-            std::string desc = "环境变量";
-            if (!value.empty()) {
-                desc += " = " + value;
-            }
-            candidates.emplace_back("$" + var, desc, CompletionType::ENVIRONMENT);
-        }
+    // 在shell维护的有序变量名快照中查找前缀区间；不读取变量的值
+    auto names = shell_->getVariableNames();
+    if (!names) {
+        return candidates;
+    }
+    auto range = prefixRange(*names, var_name);
+    candidates.reserve(range.second - range.first);
+    for (auto it = range.first; it != range.second; ++it) {
+        candidates.emplace_back(dollar ? "$" + *it : *it, "变量", CompletionType::ENVIRONMENT);
     }
     
     return candidates;
 }
 
-std::vector<CompletionCandidate> CompletionEngine::completeBuiltinCommand(const CompletionContext& context) {
+std::vector<CompletionCandidate> CompletionEngine::completeFromSpec(const CompletionSpec& spec,
+                                                                   const CompletionContext& context) {
     std::vector<CompletionCandidate> candidates;
+    int sources = 0;
+    
+    // 固定词表和子命令名
+    auto words = prefixRange(spec.words, context.word);
+    for (auto it = words.first; it != words.second; ++it) {
+        if ((*it)[0] == '-') {
+            candidates.emplace_back(*it, "选项", CompletionType::OPTION);
+        } else {
+            candidates.emplace_back(*it, "", CompletionType::COMMAND);
+        }
+    }
+    for (auto it = spec.subcommands.lower_bound(context.word);
+         it != spec.subcommands.end() && it->first.compare(0, context.word.size(), context.word) == 0; ++it) {
+        candidates.emplace_back(it->first, "子命令", CompletionType::COMMAND);
+    }
+    sources += !candidates.empty();
     
-    for (const auto& cmd : builtin_commands_) {
-        if (cmd.find(context.word) == 0) {
-            candidates.emplace_back(cmd, "内置命令", CompletionType::BUILTIN);
+    // 补全函数
+    for (const std::string& name : spec.functions) {
+        Completer function = findCompleter(name);
+        if (function && !context.stopRequested()) {
+            auto found = function(context);
+            sources += !found.empty();
+            std::move(found.begin(), found.end(), std::back_inserter(candidates));
         }
     }
     
+    // 文件名通配：目录保留，以便继续补全其中的文件
+    if (!spec.globs.empty() && !context.stopRequested()) {
+        auto files = completeFilePath(context);
+        size_t before = candidates.size();
+        for (auto& file : files) {
+            std::string name = file.text.substr(file.text.find_last_of('/', file.text.size() - 2) + 1);
+            bool keep = name.back() == '/';
+            for (size_t i = 0; !keep && i < spec.globs.size(); ++i) {
+                keep = fnmatch(spec.globs[i].c_str(), name.c_str(), 0) == 0;
+            }
+            if (keep) {
+                candidates.push_back(std::move(file));
+            }
+        }
+        sources += candidates.size() > before;
+    }
+    
+    // 外部命令
+    if (!spec.command.empty() && !context.stopRequested()) {
+        auto found = completeFromCommand(spec.command, context);
+        sources += !found.empty();
+        std::move(found.begin(), found.end(), std::back_inserter(candidates));
+    }
+    
+    // 合并各来源的候选：按文本排序去重；文件候选被截断且还有其他来源时，公共前缀无法确定
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const CompletionCandidate& a, const CompletionCandidate& b) { return a.text < b.text; });
+    candidates.erase(std::unique(candidates.begin(), candidates.end(),
+                                 [](const CompletionCandidate& a, const CompletionCandidate& b) {
+                                     return a.text == b.text;
+                                 }),
+                     candidates.end());
+    if (context.truncated && sources > 1) {
+        context.common_prefix = context.word;
+    }
+    
     return candidates;
 }
 
-std::vector<std::string> CompletionEngine::getSystemCommands() {
-    std::vector<std::string> commands;
-    std::set<std::string> unique_commands;
+std::vector<CompletionCandidate> CompletionEngine::completeOption(const CompletionContext& context) {
+    std::vector<CompletionCandidate> candidates;
     
-    // 获取PATH环境变量
-    std::string path = shell_->getEnvironmentVariable("PATH");
-    if (path.empty()) {
-        return commands;
-    }
-    
-    // 分割PATH
-    std::istringstream iss(path);
-    std::string dir;
-    while (std::getline(iss, dir, ':')) {
-        if (dir.empty()) continue;
-        
-        try {
-            // 使用传统的dirent方法而不是filesystem
-            DIR* d = opendir(dir.c_str());
-            if (d) {
-                struct dirent* entry;
-                while ((entry = readdir(d)) != nullptr) {
-                    if (entry->d_type == DT_REG || entry->d_type == DT_LNK) {
-                        std::string filename = entry->d_name;
-                        std::string full_path = dir + "/" + filename;
-                        if (isExecutable(full_path) && unique_commands.find(filename) == unique_commands.end()) {
-                            unique_commands.insert(filename);
-                            commands.push_back(filename);
-                        }
-                    }
-                }
-                closedir(d);
+    // 找到命令的可执行文件；内置命令没有
+    const std::string& name = context.words[0];
+    std::string path;
+    if (name.find('/') != std::string::npos) {
+        path = name[0] == '/' ? name : context.environment->cwd + "/" + name;
+    } else if (!std::binary_search(builtin_commands_.begin(), builtin_commands_.end(), name)) {
+        std::istringstream dirs(context.environment->path);
+        std::string dir;
+        while (std::getline(dirs, dir, ':')) {
+            std::string candidate = (dir.empty() ? "." : dir) + "/" + name;
+            struct stat st;
+            if (stat(candidate.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(candidate.c_str(), X_OK) == 0) {
+                path = candidate;
+                break;
             }
-        } catch (const std::exception&) {
-            // 忽略无法访问的目录
         }
     }
+    if (path.empty()) {
+        return candidates;
+    }
     
-    return commands;
+    // 第一次补全某个命令的选项时在后台解析，最多等到补全期限
+    auto options = options_.lookup(path, context.stop);
+    if (!options) {
+        return candidates;
+    }
+    auto first = std::lower_bound(options->begin(), options->end(), context.word,
+                                  [](const OptionIndex::Option& option, const std::string& word) {
+                                      return option.name < word;
+                                  });
+    for (auto it = first; it != options->end() && it->name.compare(0, context.word.size(), context.word) == 0; ++it) {
+        candidates.emplace_back(it->name, it->description, CompletionType::OPTION);
+    }
+    
+    return candidates;
 }
 
-std::vector<std::string> CompletionEngine::getFilesInDirectory(const std::string& dir, const std::string& prefix) {
-    std::vector<std::string> files;
-    
-    try {
-        DIR* d = opendir(dir.c_str());
-        if (d) {
-            struct dirent* entry;
-            while ((entry = readdir(d)) != nullptr) {
-                std::string filename = entry->d_name;
-                if (filename != "." && filename != ".." && filename.find(prefix) == 0) {
-                    files.push_back(filename);
-                }
+std::vector<CompletionCandidate> CompletionEngine::completeFromCommand(const std::string& command,
+                                                                      const CompletionContext& context) {
+    std::vector<CompletionCandidate> candidates;
+    
+    // 命令通过环境变量得到当前命令行和要补全的词，错误输出丢弃；
+    // 环境和当前目录用主线程的快照，参数在fork之前准备好（子进程中只调用异步信号安全的函数）
+    std::string script = "COMP_LINE=" + shellQuote(context.line) +
+                         " COMP_POINT=" + std::to_string(context.position) +
+                         " COMP_WORD=" + shellQuote(context.word) +
+                         " exec 2>/dev/null; " + command;
+    const char* argv[] = {"sh", "-c", script.c_str(), nullptr};
+    std::vector<const char*> envp;
+    for (const std::string& variable : context.environment->variables) {
+        envp.push_back(variable.c_str());
+    }
+    envp.push_back(nullptr);
+    const char* cwd = context.environment->cwd.c_str();
+    
+    int output[2];
+    if (pipe(output) == -1) {
+        return candidates;
+    }
+    int input = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    pid_t pid = fork();
+    if (pid == 0) {
+        // 自己的进程组：到期限时连同它启动的进程一起结束；不从终端读取
+        setpgid(0, 0);
+        if (input != -1) {
+            dup2(input, STDIN_FILENO);
+        }
+        dup2(output[1], STDOUT_FILENO);
+        close(output[0]);
+        close(output[1]);
+        if (chdir(cwd) == -1) {
+            _exit(126);
+        }
+        execve("/bin/sh", const_cast<char* const*>(argv), const_cast<char* const*>(envp.data()));
+        _exit(127);
+    }
+    if (input != -1) {
+        close(input);
+    }
+    close(output[1]);
+    if (pid == -1) {
+        close(output[0]);
+        return candidates;
+    }
+    setpgid(pid, pid);
+    
+    // 逐行读取输出；被要求停止（到了补全期限或用户按了键）时结束命令，返回已读到的候选
+    std::string pending;
+    char buffer[4096];
+    auto addLine = [&](std::string line) {
+        while (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty() && line.compare(0, context.word.size(), context.word) == 0) {
+            candidates.emplace_back(line, "", CompletionType::COMMAND);
+        }
+    };
+    while (true) {
+        if (context.stopRequested()) {
+            kill(-pid, SIGKILL);
+            break;
+        }
+        struct pollfd pfd = {output[0], POLLIN, 0};
+        int ready = poll(&pfd, 1, kCommandPollMs);
+        if (ready < 0 && errno != EINTR) {
+            kill(-pid, SIGKILL);
+            break;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        ssize_t n = read(output[0], buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (!pending.empty()) {
+                addLine(std::move(pending));
             }
-            closedir(d);
+            break;
+        }
+        pending.append(buffer, n);
+        size_t start = 0;
+        for (size_t newline; (newline = pending.find('\n', start)) != std::string::npos; start = newline + 1) {
+            addLine(pending.substr(start, newline - start));
         }
-    } catch (const std::exception&) {
-        // 忽略错误
+        pending.erase(0, start);
+    }
+    close(output[0]);
+    
+    // 命令关闭了输出但还在运行时也不等待它
+    int status;
+    if (waitpid(pid, &status, WNOHANG) == 0) {
+        kill(-pid, SIGKILL);
+        waitpid(pid, &status, 0);
     }
     
-    return files;
+    return candidates;
 }
 
-bool CompletionEngine::isExecutable(const std::string& path) {
-    return access(path.c_str(), X_OK) == 0;
+std::vector<CompletionCandidate> CompletionEngine::completeBuiltinCommand(const CompletionContext& context) {
+    std::vector<CompletionCandidate> candidates;
+    
+    auto range = prefixRange(builtin_commands_, context.word);
+    for (auto it = range.first; it != range.second; ++it) {
+        candidates.emplace_back(*it, "内置命令", CompletionType::BUILTIN);
+    }
+    
+    return candidates;
 }
 
 void CompletionEngine::initializeBuiltinCommands() {
-    builtin_commands_ = {
-        "help", "exit", "pwd", "cd", "echo", "export", 
-        "env", "unset", "history", "clear", "which"
-    };
+    // 取自BuiltinCommands（已排序），新增的内置命令不需要在这里登记
+    builtin_commands_ = shell_->getBuiltinCommandNames();
 }
 
-void CompletionEngine::cacheSystemCommands() {
-    // 暂时禁用系统命令缓存以避免初始化问题
-    // system_commands_ = std::set<std::string>(getSystemCommands().begin(), getSystemCommands().end());
-    // 简单的默认命令集合
-    system_commands_ = {"ls", "cat", "grep", "find", "ps", "top", "nano", "vim"};
+void CompletionEngine::registerCompleter(CompletionType type, Completer completer) {
+    std::lock_guard<std::mutex> lock(completers_mutex_);
+    custom_completers_[type] = std::move(completer);
 }
 
-void CompletionEngine::registerCompleter(CompletionType type, 
-                                        std::function<std::vector<CompletionCandidate>(const CompletionContext&)> completer) {
-    custom_completers_[type] = completer;
+void CompletionEngine::registerCompleter(const std::string& name, Completer completer) {
+    std::lock_guard<std::mutex> lock(completers_mutex_);
+    functions_[name] = std::move(completer);
 }
\ No newline at end of file
@@ -6,6 +6,14 @@
 #include <set>
 #include <map>
 #include <functional>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "command_index.h"
+#include "completion_spec.h"
+#include "option_index.h"
+#include "directory_cache.h"
+#include "lexer.h"
 
 class Shell;
 
@@ -29,6 +37,14 @@ struct CompletionCandidate {
         : text(t), description(desc), type(tp) {}
 };
 
+// 补全用到的shell状态：在主线程取得快照，补全线程只读它，不访问Shell
+// （主线程同时可能在执行cd、export）
+struct CompletionEnvironment {
+    std::string cwd;                    // 当前目录
+    std::string path;                   // PATH
+    std::vector<std::string> variables; // 环境变量（NAME=value），传给补全规格中的外部命令
+};
+
 // 补全上下文信息
 struct CompletionContext {
     std::string line;           // 当前完整命令行
@@ -37,45 +53,101 @@ struct CompletionContext {
     size_t word_start;          // 当前词的开始位置
     size_t word_end;            // 当前词的结束位置
     bool is_first_word;         // 是否是第一个词（命令）
-    std::vector<std::string> words; // 已分析的所有词
+    std::vector<std::string> words; // 当前命令中当前词之前的词（去掉引号，不含重定向）
+    const std::atomic<bool>* stop = nullptr; // 被置位时补全器应尽快返回已有的结果
+    std::shared_ptr<const CompletionEnvironment> environment;
+    
+    // 补全器填写的结果：候选是否被截断，以及截断时全部匹配的公共前缀
+    mutable bool truncated = false;
+    mutable std::string common_prefix;
+    
+    bool stopRequested() const { return stop && stop->load(std::memory_order_relaxed); }
 };
 
 // 补全引擎类
 class CompletionEngine {
 public:
+    using Completer = std::function<std::vector<CompletionCandidate>(const CompletionContext&)>;
+    
     explicit CompletionEngine(Shell* shell);
     ~CompletionEngine() = default;
     
     // 执行补全
     std::vector<CompletionCandidate> complete(const CompletionContext& context);
     
-    // 获取可能的补全列表
-    std::vector<std::string> getCompletions(const std::string& text, int start, int end);
+    // 获取可能的补全列表；common_prefix非空时返回所有匹配的最长公共前缀
+    // （候选数超过上限被截断时，它仍然覆盖全部匹配）。
+    // stop被置位时（可以在另一个线程中）尽快返回已经找到的部分候选，此时公共前缀就是当前词。
+    // 在补全线程中调用时environment必须是主线程取得的快照；为空时在调用的线程中取得
+    std::vector<std::string> getCompletions(const std::string& text, int start, int end,
+                                            std::string* common_prefix = nullptr,
+                                            const std::atomic<bool>* stop = nullptr,
+                                            std::shared_ptr<const CompletionEnvironment> environment = nullptr);
+    
+    // 同上，使用已有的分词结果（tokens是text的Lexer分词结果）
+    std::vector<std::string> getCompletions(const std::string& text, const std::vector<Token>& tokens,
+                                            int start, int end, std::string* common_prefix = nullptr,
+                                            const std::atomic<bool>* stop = nullptr,
+                                            std::shared_ptr<const CompletionEnvironment> environment = nullptr);
+    
+    // 当前目录、PATH和环境变量的快照（在主线程调用）
+    std::shared_ptr<const CompletionEnvironment> snapshotEnvironment();
+    
+    // 编辑距离相近的命令（内置命令和PATH中的命令），最相近的在前；用于"did you mean"和模糊补全
+    std::vector<std::string> suggestCommands(const std::string& word, size_t limit = 3);
     
-    // 注册自定义补全器
-    void registerCompleter(CompletionType type, 
-                          std::function<std::vector<CompletionCandidate>(const CompletionContext&)> completer);
+    // 按当前PATH更新系统命令索引（在后台扫描，不阻塞；在主线程调用）
+    void refreshSystemCommands();
+    
+    // 按当前环境更新系统命令索引、补全规格目录和选项缓存目录（每次显示提示符前在主线程调用）
+    void refresh();
+    
+    // 注册自定义补全器：按类型注册的替换对应的内置补全器，
+    // 按名字注册的供补全规格使用（complete -F name）
+    void registerCompleter(CompletionType type, Completer completer);
+    void registerCompleter(const std::string& name, Completer completer);
+    
+    // complete内置命令注册的补全规格
+    CompletionSpecs& getSpecs() { return specs_; }
+    
+    // PATH命令索引（语法高亮用它判断命令是否存在）
+    CommandIndex& getSystemCommands() { return system_commands_; }
     
 private:
     Shell* shell_;
-    std::set<std::string> builtin_commands_;
-    std::set<std::string> system_commands_;
+    std::vector<std::string> builtin_commands_;     // 有序，前缀查找用lower_bound
+    CommandIndex system_commands_;
+    CompletionSpecs specs_;
+    OptionIndex options_;           // 外部命令的选项（从man手册或--help提取，磁盘缓存）
+    DirectoryCache directories_;    // 最近补全过的目录的列表
     
     // 各种补全器
     std::vector<CompletionCandidate> completeCommand(const CompletionContext& context);
     std::vector<CompletionCandidate> completeFilePath(const CompletionContext& context);
     std::vector<CompletionCandidate> completeEnvironmentVariable(const CompletionContext& context);
     std::vector<CompletionCandidate> completeBuiltinCommand(const CompletionContext& context);
+    std::vector<CompletionCandidate> completeFromSpec(const CompletionSpec& spec, const CompletionContext& context);
+    std::vector<CompletionCandidate> completeOption(const CompletionContext& context);
+    std::vector<CompletionCandidate> completeFromCommand(const std::string& command, const CompletionContext& context);
+    
+    // 有自定义补全器时用它代替内置的
+    std::vector<CompletionCandidate> run(CompletionType type,
+        std::vector<CompletionCandidate> (CompletionEngine::*builtin)(const CompletionContext&),
+        const CompletionContext& context);
     
     // 工具方法
-    std::vector<std::string> getSystemCommands();
-    std::vector<std::string> getFilesInDirectory(const std::string& dir, const std::string& prefix = "");
-    bool isExecutable(const std::string& path);
     void initializeBuiltinCommands();
-    void cacheSystemCommands();
+    
+    // 按类型或名字取得补全器的副本，没有时返回空（补全线程调用，注册在主线程）
+    Completer findCompleter(CompletionType type);
+    Completer findCompleter(const std::string& name);
     
     // 自定义补全器映射
-    std::map<CompletionType, std::function<std::vector<CompletionCandidate>(const CompletionContext&)>> custom_completers_;
+    std::map<CompletionType, Completer> custom_completers_;
+    
+    // 补全规格可以使用的补全函数（complete -F/-A），内置的有file、directory、command、variable、builtin
+    std::map<std::string, Completer> functions_;
+    std::mutex completers_mutex_;   // 保护custom_completers_和functions_
 };
 
 #endif // COMPLETION_H
\ No newline at end of file
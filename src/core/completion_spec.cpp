@@ -0,0 +1,353 @@
+#include "completion_spec.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+
+namespace {
+
+// -A 可用的补全动作（-f/-d/-c/-v 是前四个的简写）
+const char* const kActions[] = {"file", "directory", "command", "variable", "builtin"};
+
+bool isAction(const std::string& name) {
+    return std::find(std::begin(kActions), std::end(kActions), name) != std::end(kActions);
+}
+
+std::vector<std::string> splitWords(const std::string& text) {
+    std::vector<std::string> words;
+    std::istringstream iss(text);
+    std::string word;
+    while (iss >> word) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// 输出时需要时加上单引号，使结果可以再作为complete命令读入
+std::string quote(const std::string& text) {
+    if (!text.empty() && text.find_first_of(" \t'\"\\|&;<>$*?[]") == std::string::npos) {
+        return text;
+    }
+    std::string quoted = "'";
+    for (char c : text) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+}
+
+// 规格文件中一行的分词：空白分隔，引号和反斜杠的规则同sh，不展开变量
+std::vector<std::string> tokenizeLine(const std::string& line) {
+    std::vector<std::string> tokens;
+    std::string current;
+    bool inToken = false;
+    char quoteChar = '\0';
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (quoteChar) {
+            if (c == quoteChar) {
+                quoteChar = '\0';
+            } else if (c == '\\' && quoteChar == '"' && i + 1 < line.size() &&
+                       strchr("\"\\$`", line[i + 1])) {
+                current += line[++i];
+            } else {
+                current += c;
+            }
+        } else if (c == '\'' || c == '"') {
+            quoteChar = c;
+            inToken = true;
+        } else if (c == '\\' && i + 1 < line.size()) {
+            current += line[++i];
+            inToken = true;
+        } else if (c == ' ' || c == '\t') {
+            if (inToken) {
+                tokens.push_back(current);
+                current.clear();
+                inToken = false;
+            }
+        } else if (c == '#' && !inToken) {
+            break;
+        } else {
+            current += c;
+            inToken = true;
+        }
+    }
+    if (inToken) {
+        tokens.push_back(current);
+    }
+    return tokens;
+}
+
+} // namespace
+
+bool CompletionSpecs::execute(const std::vector<std::string>& args, std::ostream& out, std::string& error) {
+    CompletionSpec spec;
+    std::vector<std::string> names;
+    bool printSpecs = false;
+    bool removeSpecs = false;
+
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (arg.size() < 2 || arg[0] != '-') {
+            names.push_back(arg);
+            continue;
+        }
+        if (arg == "-p") {
+            printSpecs = true;
+        } else if (arg == "-r") {
+            removeSpecs = true;
+        } else if (arg == "-f" || arg == "-d" || arg == "-c" || arg == "-v") {
+            static const std::map<std::string, std::string> shorthands = {
+                {"-f", "file"}, {"-d", "directory"}, {"-c", "command"}, {"-v", "variable"},
+            };
+            spec.functions.push_back(shorthands.at(arg));
+        } else if (arg == "-W" || arg == "-G" || arg == "-F" || arg == "-A" || arg == "-C") {
+            if (i + 1 >= args.size()) {
+                error = arg + ": option requires an argument";
+                return false;
+            }
+            const std::string& value = args[++i];
+            if (arg == "-W") {
+                for (std::string& word : splitWords(value)) {
+                    spec.words.push_back(std::move(word));
+                }
+            } else if (arg == "-G") {
+                spec.globs.push_back(value);
+            } else if (arg == "-C") {
+                spec.command = value;
+            } else if (arg == "-A" && !isAction(value)) {
+                error = value + ": invalid action name";
+                return false;
+            } else {
+                spec.functions.push_back(value);
+            }
+        } else {
+            error = arg + ": invalid option";
+            return false;
+        }
+    }
+
+    if (removeSpecs) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 删除后再次补全时会重新读入规格文件
+        if (names.empty()) {
+            specs_.clear();
+            loaded_.clear();
+            return true;
+        }
+        for (const std::string& name : names) {
+            if (!remove(splitWords(name))) {
+                error = name + ": no completion specification";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (printSpecs || args.empty()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (names.empty()) {
+            for (const auto& entry : specs_) {
+                print(out, entry.first, *entry.second);
+            }
+            return true;
+        }
+        for (const std::string& name : names) {
+            auto path = splitWords(name);
+            auto it = path.empty() ? specs_.end() : specs_.find(path[0]);
+            SpecPtr found = it != specs_.end() ? it->second : nullptr;
+            for (size_t i = 1; found && i < path.size(); ++i) {
+                auto sub = found->subcommands.find(path[i]);
+                found = sub != found->subcommands.end() ? sub->second : nullptr;
+            }
+            if (!found) {
+                error = name + ": no completion specification";
+                return false;
+            }
+            print(out, name, *found);
+        }
+        return true;
+    }
+
+    if (names.empty() || !spec.hasSources()) {
+        error = "usage: complete [-pr] [-fdcv] [-W words] [-G glob] [-F function] [-A action] [-C command] name ...";
+        return false;
+    }
+    std::sort(spec.words.begin(), spec.words.end());
+    spec.words.erase(std::unique(spec.words.begin(), spec.words.end()), spec.words.end());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const std::string& name : names) {
+        auto path = splitWords(name);
+        if (!path.empty()) {
+            define(path, spec);
+        }
+    }
+    return true;
+}
+
+void CompletionSpecs::define(const std::vector<std::string>& path, const CompletionSpec& spec) {
+    // 规格不可变：沿路径复制每一层，替换目标后再逐层挂回去
+    std::vector<CompletionSpec> chain;
+    auto it = specs_.find(path[0]);
+    SpecPtr current = it != specs_.end() ? it->second : nullptr;
+    for (size_t i = 0; i < path.size(); ++i) {
+        chain.push_back(current ? *current : CompletionSpec());
+        if (i + 1 < path.size()) {
+            SpecPtr next;
+            if (current) {
+                auto sub = current->subcommands.find(path[i + 1]);
+                if (sub != current->subcommands.end()) {
+                    next = sub->second;
+                }
+            }
+            current = next;
+        }
+    }
+
+    CompletionSpec replaced = spec;
+    replaced.subcommands = std::move(chain.back().subcommands);
+    chain.back() = std::move(replaced);
+
+    for (size_t i = chain.size() - 1; i > 0; --i) {
+        chain[i - 1].subcommands[path[i]] = std::make_shared<const CompletionSpec>(std::move(chain[i]));
+    }
+    specs_[path[0]] = std::make_shared<const CompletionSpec>(std::move(chain[0]));
+}
+
+bool CompletionSpecs::remove(const std::vector<std::string>& path) {
+    auto it = path.empty() ? specs_.end() : specs_.find(path[0]);
+    if (it == specs_.end()) {
+        return false;
+    }
+    if (path.size() == 1) {
+        specs_.erase(it);
+        loaded_.erase(path[0]);
+        return true;
+    }
+
+    std::vector<CompletionSpec> chain;
+    SpecPtr current = it->second;
+    for (size_t i = 1; i < path.size(); ++i) {
+        chain.push_back(*current);
+        auto sub = current->subcommands.find(path[i]);
+        if (sub == current->subcommands.end()) {
+            return false;
+        }
+        current = sub->second;
+    }
+    chain.back().subcommands.erase(path.back());
+    for (size_t i = chain.size() - 1; i > 0; --i) {
+        chain[i - 1].subcommands[path[i]] = std::make_shared<const CompletionSpec>(std::move(chain[i]));
+    }
+    it->second = std::make_shared<const CompletionSpec>(std::move(chain[0]));
+    return true;
+}
+
+void CompletionSpecs::print(std::ostream& out, const std::string& name, const CompletionSpec& spec) const {
+    if (spec.hasSources()) {
+        out << "complete";
+        if (!spec.words.empty()) {
+            std::string words;
+            for (const std::string& word : spec.words) {
+                words += (words.empty() ? "" : " ") + word;
+            }
+            out << " -W " << quote(words);
+        }
+        for (const std::string& glob : spec.globs) {
+            out << " -G " << quote(glob);
+        }
+        for (const std::string& function : spec.functions) {
+            out << (isAction(function) ? " -A " : " -F ") << quote(function);
+        }
+        if (!spec.command.empty()) {
+            out << " -C " << quote(spec.command);
+        }
+        out << " " << quote(name) << std::endl;
+    }
+    for (const auto& entry : spec.subcommands) {
+        print(out, name + " " + entry.first, *entry.second);
+    }
+}
+
+CompletionSpecs::SpecPtr CompletionSpecs::find(const std::vector<std::string>& words) {
+    if (words.empty()) {
+        return nullptr;
+    }
+    std::string command = baseName(words[0]);
+    if (command.empty() || command[0] == '.') {
+        return nullptr;
+    }
+
+    bool needLoad = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (specs_.find(command) == specs_.end() && loaded_.insert(command).second) {
+            needLoad = !directory_.empty();
+        }
+    }
+    if (needLoad) {
+        load(command);
+    }
+
+    SpecPtr spec;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = specs_.find(command);
+        if (it == specs_.end()) {
+            return nullptr;
+        }
+        spec = it->second;
+    }
+
+    // 沿子命令下降；选项和不认识的词（例如选项的参数）跳过
+    for (size_t i = 1; i < words.size(); ++i) {
+        auto sub = spec->subcommands.find(words[i]);
+        if (sub != spec->subcommands.end()) {
+            spec = sub->second;
+        }
+    }
+    return spec;
+}
+
+void CompletionSpecs::setDirectory(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (directory != directory_) {
+        directory_ = directory;
+        loaded_.clear();
+    }
+}
+
+void CompletionSpecs::load(const std::string& command) {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        path = directory_ + "/" + command;
+    }
+
+    std::ifstream file(path);
+    if (!file) {
+        return;
+    }
+
+    // 补全在后台进行，不输出错误；出错的行忽略，complete -p 可以查看读入的结果
+    std::ostringstream ignored;
+    std::string line;
+    while (std::getline(file, line)) {
+        auto tokens = tokenizeLine(line);
+        if (tokens.size() < 2 || tokens[0] != "complete") {
+            continue;
+        }
+        tokens.erase(tokens.begin());
+        std::string error;
+        execute(tokens, ignored, error);
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef COMPLETION_SPEC_H
+#define COMPLETION_SPEC_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <ostream>
+
+// 一个命令（或子命令）的补全规格
+struct CompletionSpec {
+    std::vector<std::string> words;         // -W：固定候选（有序），以-开头的就是选项
+    std::vector<std::string> globs;         // -G：文件名通配，目录总是保留以便继续补全
+    std::vector<std::string> functions;     // -F/-A：补全函数名，如file、directory、command、variable
+    std::string command;                    // -C：执行命令，输出的每一行是一个候选
+    std::map<std::string, std::shared_ptr<const CompletionSpec>> subcommands;  // 子命令的规格
+
+    // 没有任何候选来源（只用来挂子命令）
+    bool hasSources() const {
+        return !words.empty() || !globs.empty() || !functions.empty() || !command.empty();
+    }
+};
+
+// 可编程补全规格表（complete内置命令）
+//
+// 规格按命令名注册，子命令用多个词的名字注册（complete -f "git add"）。
+// 规格文件按命令名存放在补全目录中（$MYSH_COMPLETION_DIR，默认~/.mysh_completions），
+// 每行是一条complete命令；第一次补全某个命令的参数时才读入，解析结果缓存在内存中。
+// 补全在后台线程查找，complete命令在主线程修改，规格本身不可变，修改时整体替换。
+class CompletionSpecs {
+public:
+    using SpecPtr = std::shared_ptr<const CompletionSpec>;
+
+    // 执行complete的参数（不含complete本身），输出写到out；出错时返回false和错误信息
+    bool execute(const std::vector<std::string>& args, std::ostream& out, std::string& error);
+
+    // 查找当前词之前的各词（words[0]是命令）对应的最深一层规格，需要时读入规格文件
+    SpecPtr find(const std::vector<std::string>& words);
+
+    // 设置补全目录；目录变化后没有规格的命令会重新尝试读入文件
+    void setDirectory(const std::string& directory);
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, SpecPtr> specs_;
+    std::set<std::string> loaded_;          // 已经尝试读入规格文件的命令（文件不存在也记录）
+    std::string directory_;
+
+    // 注册规格：path是命令和子命令，已有的子命令规格保留
+    void define(const std::vector<std::string>& path, const CompletionSpec& spec);
+    bool remove(const std::vector<std::string>& path);
+    void print(std::ostream& out, const std::string& name, const CompletionSpec& spec) const;
+
+    // 读入命令的规格文件（在锁外读文件）
+    void load(const std::string& command);
+};
+
+#endif // COMPLETION_SPEC_H
@@ -0,0 +1,231 @@
+#include "directory_cache.h"
+#include "platform.h"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#ifdef PLATFORM_LINUX
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+// 目录修改后至少经过这么久才缓存它的列表（大于常见文件系统的时间戳精度）
+constexpr int64_t kSettleSeconds = 2;
+
+// 分批读取目录项：Linux上直接用getdents64每次读入一大块，名字和d_type都在其中，
+// 不需要逐个stat；其他平台用readdir
+class DirectoryReader {
+public:
+    explicit DirectoryReader(const std::string& path) {
+        fd_ = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#ifndef PLATFORM_LINUX
+        dir_ = fd_ != -1 ? fdopendir(fd_) : nullptr;
+#endif
+    }
+
+    ~DirectoryReader() {
+#ifdef PLATFORM_LINUX
+        if (fd_ != -1) {
+            close(fd_);
+        }
+#else
+        if (dir_) {
+            closedir(dir_);
+        } else if (fd_ != -1) {
+            close(fd_);
+        }
+#endif
+    }
+
+    bool ok() const { return fd_ != -1; }
+
+    // 读取下一批目录项，对每一项调用fn(name, d_type)；目录读完或出错时返回false
+    template <typename Fn>
+    bool nextBatch(Fn&& fn) {
+#ifdef PLATFORM_LINUX
+        struct LinuxDirent64 {
+            uint64_t d_ino;
+            int64_t d_off;
+            unsigned short d_reclen;
+            unsigned char d_type;
+            char d_name[];
+        };
+        long bytes = syscall(SYS_getdents64, fd_, buffer_, sizeof(buffer_));
+        if (bytes <= 0) {
+            return false;
+        }
+        for (long offset = 0; offset < bytes;) {
+            auto* entry = reinterpret_cast<LinuxDirent64*>(buffer_ + offset);
+            fn(entry->d_name, entry->d_type);
+            offset += entry->d_reclen;
+        }
+        return true;
+#else
+        if (!dir_) {
+            return false;
+        }
+        for (int i = 0; i < 1024; ++i) {
+            struct dirent* entry = readdir(dir_);
+            if (!entry) {
+                return i > 0;
+            }
+            fn(entry->d_name, entry->d_type);
+        }
+        return true;
+#endif
+    }
+
+private:
+    int fd_;
+#ifdef PLATFORM_LINUX
+    alignas(8) char buffer_[256 * 1024];
+#else
+    DIR* dir_;
+#endif
+};
+
+int64_t nanoseconds(const struct timespec& time) {
+    return static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+int64_t modificationTime(const struct stat& st) {
+#ifdef __APPLE__
+    return nanoseconds(st.st_mtimespec);
+#else
+    return nanoseconds(st.st_mtim);
+#endif
+}
+
+} // namespace
+
+std::pair<size_t, size_t> DirectoryCache::Listing::prefixRange(const std::string& prefix) const {
+    auto less = [this](uint32_t offset, const std::string& key) {
+        return strcmp(data_.data() + offset + 1, key.c_str()) < 0;
+    };
+    auto first = std::lower_bound(entries_.begin(), entries_.end(), prefix, less);
+    auto last = first;
+    while (last != entries_.end() && strncmp(data_.data() + *last + 1, prefix.data(), prefix.size()) == 0) {
+        ++last;
+    }
+    return {static_cast<size_t>(first - entries_.begin()), static_cast<size_t>(last - entries_.begin())};
+}
+
+DirectoryCache::DirectoryCache(size_t maxDirectories, size_t maxBytes)
+    : maxDirectories_(maxDirectories), maxBytes_(maxBytes) {}
+
+DirectoryCache::Snapshot DirectoryCache::list(const std::string& path, const std::atomic<bool>* stop,
+                                              bool& partial) {
+    partial = false;
+
+    // 先stat再读取：读取期间目录被修改时，下次比较修改时间就会发现
+    struct stat st;
+    if (stat(path.c_str(), &st) == -1 || !S_ISDIR(st.st_mode)) {
+        return nullptr;
+    }
+    int64_t mtime = modificationTime(st);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(path);
+        if (it != index_.end()) {
+            Entry& entry = *it->second;
+            if (entry.device == static_cast<uint64_t>(st.st_dev) &&
+                entry.inode == static_cast<uint64_t>(st.st_ino) && entry.mtime == mtime) {
+                entries_.splice(entries_.begin(), entries_, it->second);
+                return entry.listing;
+            }
+            bytes_ -= entry.listing->bytes();
+            entries_.erase(it->second);
+            index_.erase(it);
+        }
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    Snapshot listing = read(path, stop, partial);
+    if (listing && !partial && mtime + kSettleSeconds * 1000000000 <= nanoseconds(now)) {
+        store({path, static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino), mtime, listing});
+    }
+    return listing;
+}
+
+void DirectoryCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+    bytes_ = 0;
+}
+
+DirectoryCache::Snapshot DirectoryCache::read(const std::string& path, const std::atomic<bool>* stop,
+                                              bool& partial) {
+    DirectoryReader reader(path);
+    if (!reader.ok()) {
+        return nullptr;
+    }
+
+    auto listing = std::make_shared<Listing>();
+    auto visit = [&](const char* name, unsigned char type) {
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+            return;
+        }
+        listing->entries_.push_back(static_cast<uint32_t>(listing->data_.size()));
+        listing->data_ += static_cast<char>(type);
+        listing->data_.append(name, strlen(name) + 1);
+    };
+    while (reader.nextBatch(visit)) {
+        if (stop && stop->load(std::memory_order_relaxed)) {
+            partial = true;
+            break;
+        }
+    }
+
+    // 按名字排序：先比较名字前8个字节组成的整数，相同时才strcmp，大部分比较不用访问名字
+    const char* data = listing->data_.data();
+    std::vector<std::pair<uint64_t, uint32_t>> keys;
+    keys.reserve(listing->entries_.size());
+    for (uint32_t offset : listing->entries_) {
+        uint64_t key = 0;
+        const char* name = data + offset + 1;
+        for (int i = 0; i < 8 && name[i]; ++i) {
+            key |= static_cast<uint64_t>(static_cast<unsigned char>(name[i])) << (56 - 8 * i);
+        }
+        keys.emplace_back(key, offset);
+    }
+    std::sort(keys.begin(), keys.end(), [data](const std::pair<uint64_t, uint32_t>& a,
+                                               const std::pair<uint64_t, uint32_t>& b) {
+        return a.first != b.first ? a.first < b.first : strcmp(data + a.second + 1, data + b.second + 1) < 0;
+    });
+    for (size_t i = 0; i < keys.size(); ++i) {
+        listing->entries_[i] = keys[i].second;
+    }
+    listing->data_.shrink_to_fit();
+    return listing;
+}
+
+void DirectoryCache::store(Entry entry) {
+    size_t bytes = entry.listing->bytes();
+    if (bytes > maxBytes_) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(entry.path);
+    if (it != index_.end()) {
+        bytes_ -= it->second->listing->bytes();
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+    while (!entries_.empty() && (entries_.size() >= maxDirectories_ || bytes_ + bytes > maxBytes_)) {
+        bytes_ -= entries_.back().listing->bytes();
+        index_.erase(entries_.back().path);
+        entries_.pop_back();
+    }
+    entries_.push_front(std::move(entry));
+    index_[entries_.front().path] = entries_.begin();
+    bytes_ += bytes;
+}
@@ -0,0 +1,75 @@
+#ifndef DIRECTORY_CACHE_H
+#define DIRECTORY_CACHE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+// 目录列表的LRU缓存（文件补全用）
+//
+// 缓存整个目录的名字和d_type，按名字排序；再次补全同一目录时只stat一次目录本身，
+// inode和修改时间都没变就直接在缓存中二分查找前缀，不再重新读取目录。
+// 刚修改过的目录（修改时间距读取时不到kSettleSeconds）不缓存：文件系统时间戳有精度，
+// 同一时间刻度内的后续修改不会改变修改时间。
+class DirectoryCache {
+public:
+    // 一个目录的全部条目（不含.和..），按名字排序
+    class Listing {
+    public:
+        size_t size() const { return entries_.size(); }
+        const char* name(size_t i) const { return data_.data() + entries_[i] + 1; }
+        unsigned char type(size_t i) const { return static_cast<unsigned char>(data_[entries_[i]]); }
+
+        // 以prefix开头的条目区间[first, last)
+        std::pair<size_t, size_t> prefixRange(const std::string& prefix) const;
+
+        // 占用的内存（近似）
+        size_t bytes() const { return data_.size() + entries_.size() * sizeof(uint32_t); }
+
+    private:
+        friend class DirectoryCache;
+        std::string data_;                  // 每个条目依次为：d_type一个字节、名字、'\0'
+        std::vector<uint32_t> entries_;     // 条目在data_中的偏移
+    };
+    using Snapshot = std::shared_ptr<const Listing>;
+
+    explicit DirectoryCache(size_t maxDirectories = 32, size_t maxBytes = 32 << 20);
+
+    DirectoryCache(const DirectoryCache&) = delete;
+    DirectoryCache& operator=(const DirectoryCache&) = delete;
+
+    // 目录的列表。stop被置位时返回已读到的部分并将partial置位（部分结果不缓存）；
+    // 目录无法打开时返回nullptr
+    Snapshot list(const std::string& path, const std::atomic<bool>* stop, bool& partial);
+
+    void clear();
+
+private:
+    struct Entry {
+        std::string path;
+        uint64_t device;
+        uint64_t inode;
+        int64_t mtime;                      // 纳秒
+        Snapshot listing;
+    };
+
+    size_t maxDirectories_;
+    size_t maxBytes_;
+
+    std::mutex mutex_;
+    std::list<Entry> entries_;              // 最近使用的在前
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    size_t bytes_ = 0;
+
+    static Snapshot read(const std::string& path, const std::atomic<bool>* stop, bool& partial);
+    void store(Entry entry);
+};
+
+#endif // DIRECTORY_CACHE_H
@@ -0,0 +1,463 @@
+#include "directory_db.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <string_view>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <pwd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+
+namespace {
+
+const char kMagic[8] = {'M', 'Y', 'S', 'H', 'D', 'I', 'R', '1'};
+
+struct RecordHeader {
+    uint32_t pathLength;
+    uint32_t count;         // 0 表示删除该目录
+    int64_t lastAccess;
+};
+
+constexpr size_t kMaxPathLength = 4096;
+
+size_t paddedSize(size_t pathLength) {
+    return (sizeof(RecordHeader) + pathLength + 7) & ~static_cast<size_t>(7);
+}
+
+std::string toLower(const std::string& str) {
+    std::string result(str);
+    std::transform(result.begin(), result.end(), result.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return result;
+}
+
+bool isDirectory(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+} // namespace
+
+DirectoryDatabase::DirectoryDatabase() : DirectoryDatabase(getDatabaseFilePath()) {}
+
+DirectoryDatabase::DirectoryDatabase(const std::string& file)
+    : databaseFile_(file), fd_(-1), loaded_(false), recordCount_(0), readOffset_(0) {
+    open();
+}
+
+DirectoryDatabase::~DirectoryDatabase() {
+    if (fd_ != -1) {
+        close(fd_);
+    }
+}
+
+void DirectoryDatabase::recordVisit(const std::string& path) {
+    if (path.empty() || path.size() > kMaxPathLength) {
+        return;
+    }
+
+    // 尚未加载时只追加文件，内存索引在首次查询时一并构建；
+    // 已加载时追加后读取文件尾部，同时合并其他会话追加的记录
+    int64_t now = static_cast<int64_t>(time(nullptr));
+    if (!append(path, 1, now) && loaded_) {
+        mergeRecord(path, 1, now);
+    }
+}
+
+std::string DirectoryDatabase::query(const std::vector<std::string>& terms, const std::string& exclude) {
+    load();
+    auto matches = match(terms);
+
+    // 按得分从高到低尝试，跳过已不存在的目录；通常前几名即可命中，无需全排序
+    for (size_t limit : {size_t(16), size_t(0)}) {
+        for (size_t i : rank(matches, limit)) {
+            std::string path = entryPath(entries_[i]);
+            if (path != exclude && isDirectory(path)) {
+                return path;
+            }
+        }
+        if (matches.size() <= 16) {
+            break;
+        }
+    }
+    return "";
+}
+
+std::vector<DirectoryEntry> DirectoryDatabase::list(const std::vector<std::string>& terms, size_t limit) {
+    load();
+    std::vector<DirectoryEntry> results;
+    int64_t now = static_cast<int64_t>(time(nullptr));
+
+    for (size_t i : rank(match(terms), limit)) {
+        const Entry& entry = entries_[i];
+        results.push_back({entryPath(entry), entry.count, entry.lastAccess, frecency(entry, now)});
+    }
+    return results;
+}
+
+bool DirectoryDatabase::remove(const std::string& path) {
+    load();
+    auto it = index_.find(path);
+    if (it == index_.end() || entries_[it->second].removed) {
+        return false;
+    }
+
+    int64_t now = static_cast<int64_t>(time(nullptr));
+    if (!append(path, 0, now)) {
+        mergeRecord(path, 0, now);
+    }
+    return true;
+}
+
+size_t DirectoryDatabase::size() {
+    load();
+    return index_.size();
+}
+
+void DirectoryDatabase::open() {
+    fd_ = ::open(databaseFile_.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd_ == -1) {
+        return; // 无法打开数据库，静默失败（目录跳转不可用）
+    }
+
+    // 新文件在lock()中写入文件头
+    if (lock(LOCK_SH)) {
+        flock(fd_, LOCK_UN);
+    } else if (fd_ != -1) {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool DirectoryDatabase::lock(int operation) {
+    // 加锁后检查：文件已被其他会话压缩替换时改用新文件；新文件还没有文件头时换成排他锁写入，
+    // 同时创建数据库的会话只有一个写入。锁的转换不是原子的，每次转换后重新检查
+    int current = operation;
+    while (fd_ != -1) {
+        if (flock(fd_, current) == -1) {
+            return false;
+        }
+        struct stat opened, named;
+        if (fstat(fd_, &opened) == -1) {
+            flock(fd_, LOCK_UN);
+            return false;
+        }
+        if (stat(databaseFile_.c_str(), &named) == 0 &&
+            (named.st_dev != opened.st_dev || named.st_ino != opened.st_ino)) {
+            flock(fd_, LOCK_UN);
+            close(fd_);
+            fd_ = ::open(databaseFile_.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+            readOffset_ = 0;
+            current = operation;
+            continue;
+        }
+        if (opened.st_size < static_cast<off_t>(sizeof(kMagic))) {
+            if (current != LOCK_EX) {
+                current = LOCK_EX;
+                continue;
+            }
+            // 写入文件头（之前写入一半时崩溃的也重新写）
+            if (ftruncate(fd_, 0) != 0 || write(fd_, kMagic, sizeof(kMagic)) != sizeof(kMagic)) {
+                flock(fd_, LOCK_UN);
+                return false;
+            }
+        }
+        if (current == operation) {
+            return true;
+        }
+        current = operation;
+    }
+    return false;
+}
+
+void DirectoryDatabase::load() {
+    loaded_ = true;
+    if (fd_ == -1 || !lock(LOCK_SH)) {
+        return;
+    }
+    // 首次读取全部记录，之后只读取其他会话新追加的
+    readRecords();
+    flock(fd_, LOCK_UN);
+
+    // 追加记录过多时压缩为每个目录一条
+    if (recordCount_ > 2 * index_.size() + 1024) {
+        compact();
+    }
+}
+
+void DirectoryDatabase::readRecords() {
+    if (readOffset_ == 0) {
+        entries_.clear();
+        paths_.clear();
+        lowerPaths_.clear();
+        pathSignatures_.clear();
+        baseSignatures_.clear();
+        index_.clear();
+        recordCount_ = 0;
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) == -1) {
+        return;
+    }
+
+    size_t fileSize = static_cast<size_t>(st.st_size);
+    if (fileSize < sizeof(kMagic) || fileSize <= readOffset_) {
+        return;
+    }
+
+    void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (mapped == MAP_FAILED) {
+        return;
+    }
+
+    const char* data = static_cast<const char*>(mapped);
+    if (std::memcmp(data, kMagic, sizeof(kMagic)) == 0) {
+        size_t offset = std::max(readOffset_, sizeof(kMagic));
+        while (offset + sizeof(RecordHeader) <= fileSize) {
+            RecordHeader header;
+            std::memcpy(&header, data + offset, sizeof(header));
+            size_t recordSize = paddedSize(header.pathLength);
+            // 末尾不完整的记录（写入时崩溃）直接忽略
+            if (header.pathLength == 0 || header.pathLength > kMaxPathLength ||
+                offset + recordSize > fileSize) {
+                break;
+            }
+
+            mergeRecord(std::string(data + offset + sizeof(header), header.pathLength), header.count,
+                        header.lastAccess);
+            ++recordCount_;
+            offset += recordSize;
+        }
+        readOffset_ = offset;
+    }
+
+    munmap(mapped, fileSize);
+}
+
+bool DirectoryDatabase::append(const std::string& path, uint32_t count, int64_t lastAccess) {
+    if (fd_ == -1) {
+        return false;
+    }
+
+    std::string record(paddedSize(path.size()), '\0');
+    RecordHeader header = {static_cast<uint32_t>(path.size()), count, lastAccess};
+    std::memcpy(&record[0], &header, sizeof(header));
+    std::memcpy(&record[sizeof(header)], path.data(), path.size());
+
+    // O_APPEND保证单条记录整体追加，多个会话可以同时写入（共享锁）；压缩期间等待
+    if (!lock(LOCK_SH)) {
+        return false;
+    }
+    bool written = write(fd_, record.data(), record.size()) == static_cast<ssize_t>(record.size());
+    if (written && loaded_) {
+        readRecords();
+    }
+    flock(fd_, LOCK_UN);
+    return written;
+}
+
+void DirectoryDatabase::compact() {
+    if (fd_ == -1 || !lock(LOCK_EX)) {
+        return;
+    }
+    // 读取之后其他会话可能又追加了记录：在排他锁内读取，重写的内容包含它们
+    readRecords();
+
+    std::string buffer(kMagic, sizeof(kMagic));
+    size_t records = 0;
+    for (const auto& entry : entries_) {
+        if (entry.removed) {
+            continue;
+        }
+        std::string path = entryPath(entry);
+        size_t offset = buffer.size();
+        buffer.resize(offset + paddedSize(path.size()), '\0');
+        RecordHeader header = {entry.pathLength, entry.count, entry.lastAccess};
+        std::memcpy(&buffer[offset], &header, sizeof(header));
+        std::memcpy(&buffer[offset + sizeof(header)], path.data(), path.size());
+        ++records;
+    }
+
+    // 写入临时文件后rename替换：任何一步失败都保留原文件。新文件的描述符直接作为fd_，
+    // 关闭旧描述符时释放旧文件上的锁，等待的会话加锁后会发现文件已被替换
+    std::string temp = databaseFile_ + ".tmp";
+    int fd = ::open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600);
+    bool replaced = fd != -1 &&
+                    write(fd, buffer.data(), buffer.size()) == static_cast<ssize_t>(buffer.size()) &&
+                    fsync(fd) == 0 && rename(temp.c_str(), databaseFile_.c_str()) == 0;
+    if (replaced) {
+        close(fd_);
+        fd_ = fd;
+        readOffset_ = buffer.size();
+        recordCount_ = records;
+        return;
+    }
+    if (fd != -1) {
+        close(fd);
+        unlink(temp.c_str());
+    }
+    flock(fd_, LOCK_UN);
+}
+
+void DirectoryDatabase::mergeRecord(const std::string& path, uint32_t count, int64_t lastAccess) {
+    // count为0的记录表示删除
+    auto it = index_.find(path);
+    if (it == index_.end()) {
+        size_t i = insertEntry(path, count, lastAccess);
+        entries_[i].removed = count == 0;
+        return;
+    }
+    Entry& entry = entries_[it->second];
+    entry.count = count == 0 ? 0 : (entry.removed ? 0 : entry.count) + count;
+    entry.lastAccess = std::max(entry.lastAccess, lastAccess);
+    entry.removed = count == 0;
+}
+
+size_t DirectoryDatabase::insertEntry(const std::string& path, uint32_t count, int64_t lastAccess) {
+    std::string lower = toLower(path);
+    size_t slash = lower.find_last_of('/', lower.size() > 1 ? lower.size() - 2 : 0);
+
+    Entry entry;
+    entry.pathOffset = static_cast<uint32_t>(paths_.size());
+    entry.pathLength = static_cast<uint32_t>(path.size());
+    entry.baseStart = slash == std::string::npos ? 0 : static_cast<uint32_t>(slash + 1);
+    entry.count = count;
+    entry.lastAccess = lastAccess;
+    entry.removed = false;
+
+    paths_ += path;
+    lowerPaths_ += lower;
+    pathSignatures_.push_back(signature(lower.data(), lower.size()));
+    baseSignatures_.push_back(signature(lower.data() + entry.baseStart, lower.size() - entry.baseStart));
+
+    entries_.push_back(entry);
+    index_[path] = entries_.size() - 1;
+    return entries_.size() - 1;
+}
+
+std::string DirectoryDatabase::entryPath(const Entry& entry) const {
+    return paths_.substr(entry.pathOffset, entry.pathLength);
+}
+
+std::vector<size_t> DirectoryDatabase::match(const std::vector<std::string>& terms) const {
+    std::vector<size_t> matches;
+    std::vector<std::string> lowerTerms;
+    uint64_t pathMask = 0;
+    for (const auto& term : terms) {
+        if (!term.empty()) {
+            lowerTerms.push_back(toLower(term));
+            pathMask |= signature(lowerTerms.back().data(), lowerTerms.back().size());
+        }
+    }
+
+    if (lowerTerms.empty()) {
+        for (size_t i = 0; i < entries_.size(); ++i) {
+            if (!entries_[i].removed) {
+                matches.push_back(i);
+            }
+        }
+        return matches;
+    }
+
+    // 签名筛选：关键字的每个二元组都必须出现在对应位置的签名里，
+    // 连续数组上的位与操作，5万条目录也只需几十微秒
+    uint64_t baseMask = signature(lowerTerms.back().data(), lowerTerms.back().size());
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if ((baseSignatures_[i] & baseMask) != baseMask || (pathSignatures_[i] & pathMask) != pathMask) {
+            continue;
+        }
+        if (!entries_[i].removed && matchesInOrder(entries_[i], lowerTerms)) {
+            matches.push_back(i);
+        }
+    }
+
+    return matches;
+}
+
+bool DirectoryDatabase::matchesInOrder(const Entry& entry, const std::vector<std::string>& terms) const {
+    // 关键字按顺序出现在路径中，最后一个关键字必须落在最后一级目录名内
+    std::string_view path(lowerPaths_.data() + entry.pathOffset, entry.pathLength);
+    size_t position = 0;
+    for (size_t i = 0; i + 1 < terms.size(); ++i) {
+        position = path.find(terms[i], position);
+        if (position == std::string_view::npos) {
+            return false;
+        }
+        position += terms[i].size();
+    }
+
+    return path.find(terms.back(), std::max<size_t>(position, entry.baseStart)) != std::string_view::npos;
+}
+
+std::vector<size_t> DirectoryDatabase::rank(const std::vector<size_t>& matches, size_t limit) const {
+    int64_t now = static_cast<int64_t>(time(nullptr));
+    std::vector<std::pair<double, size_t>> scored;
+    scored.reserve(matches.size());
+    for (size_t i : matches) {
+        scored.emplace_back(frecency(entries_[i], now), i);
+    }
+
+    auto byScore = [](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b) {
+        return a.first > b.first;
+    };
+    if (limit > 0 && scored.size() > limit) {
+        std::partial_sort(scored.begin(), scored.begin() + limit, scored.end(), byScore);
+        scored.resize(limit);
+    } else {
+        std::sort(scored.begin(), scored.end(), byScore);
+    }
+
+    std::vector<size_t> ranked;
+    ranked.reserve(scored.size());
+    for (const auto& item : scored) {
+        ranked.push_back(item.second);
+    }
+    return ranked;
+}
+
+uint64_t DirectoryDatabase::signature(const char* text, size_t length) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i + 1 < length; ++i) {
+        unsigned a = static_cast<unsigned char>(text[i]);
+        unsigned b = static_cast<unsigned char>(text[i + 1]);
+        bits |= uint64_t(1) << (((a * 31) ^ b) & 63);
+    }
+    return bits;
+}
+
+double DirectoryDatabase::frecency(const Entry& entry, int64_t now) {
+    int64_t age = now - entry.lastAccess;
+    double weight;
+    if (age < 3600) {
+        weight = 4.0;
+    } else if (age < 86400) {
+        weight = 2.0;
+    } else if (age < 604800) {
+        weight = 0.5;
+    } else {
+        weight = 0.25;
+    }
+    return entry.count * weight;
+}
+
+std::string DirectoryDatabase::getDatabaseFilePath() {
+    char* home = getenv("HOME");
+    if (home) {
+        return std::string(home) + "/.mysh_dirs";
+    }
+
+    // 如果没有HOME环境变量，尝试从passwd获取
+    struct passwd* pw = getpwuid(getuid());
+    if (pw) {
+        return std::string(pw->pw_dir) + "/.mysh_dirs";
+    }
+
+    return ".mysh_dirs";
+}
@@ -0,0 +1,94 @@
+#ifndef DIRECTORY_DB_H
+#define DIRECTORY_DB_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// 目录访问记录（频率 + 最近访问时间）
+struct DirectoryEntry {
+    std::string path;
+    uint32_t count;
+    int64_t lastAccess;
+    double score;
+};
+
+// 目录频率数据库（z风格跳转）
+//
+// 文件格式：8字节魔数，之后是若干条记录
+//   { uint32 路径长度, uint32 访问次数, int64 访问时间, 路径字节, 补齐到8字节 }
+// 每次切换目录只追加一条 count=1 的记录（O(1)），首次查询时才通过mmap扫描并合并，
+// 之后每次查询只读取上次读到的位置之后、其他会话追加的记录。
+// 追加和读取持有共享的flock，新文件在排他的flock内写入文件头。记录数明显多于目录数时
+// 压缩为每个目录一条记录：持有排他的flock并在锁内重新读取，写入临时文件后rename替换，
+// 中途崩溃或磁盘写满时原文件不受影响。其他会话加锁后发现文件已被替换时改用新文件并重新读取。
+// 查询时先用每个目录的64位二元组签名做位与筛选，只对少量候选做子串比较。
+class DirectoryDatabase {
+public:
+    DirectoryDatabase();
+    explicit DirectoryDatabase(const std::string& file);
+    ~DirectoryDatabase();
+
+    // 记录一次目录访问
+    void recordVisit(const std::string& path);
+
+    // 按关键字查找得分最高且仍然存在的目录，找不到返回空串
+    std::string query(const std::vector<std::string>& terms, const std::string& exclude = "");
+
+    // 按得分降序列出匹配的目录（terms为空时列出全部）
+    std::vector<DirectoryEntry> list(const std::vector<std::string>& terms, size_t limit = 0);
+
+    // 删除目录记录
+    bool remove(const std::string& path);
+
+    // 已记录的目录数
+    size_t size();
+
+private:
+    struct Entry {
+        uint32_t pathOffset;    // 在paths_/lowerPaths_中的偏移
+        uint32_t pathLength;
+        uint32_t baseStart;     // 最后一级目录名在路径中的起始位置
+        uint32_t count;
+        int64_t lastAccess;
+        bool removed;
+    };
+
+    std::string databaseFile_;
+    int fd_;
+    bool loaded_;
+    size_t recordCount_;
+    size_t readOffset_;         // 已合并到内存的文件长度，0表示需要从头读取（文件被替换）
+
+    std::vector<Entry> entries_;
+    std::string paths_;         // 所有路径连续存放
+    std::string lowerPaths_;    // 小写副本，偏移与paths_一致
+    std::vector<uint64_t> pathSignatures_;  // 整条路径的二元组签名
+    std::vector<uint64_t> baseSignatures_;  // 最后一级目录名的二元组签名
+    std::unordered_map<std::string, size_t> index_;
+
+    // 加载/追加/压缩数据库文件
+    void open();
+    bool lock(int operation);
+    void load();
+    void readRecords();
+    bool append(const std::string& path, uint32_t count, int64_t lastAccess);
+    void compact();
+
+    // 内存索引维护
+    void mergeRecord(const std::string& path, uint32_t count, int64_t lastAccess);
+    size_t insertEntry(const std::string& path, uint32_t count, int64_t lastAccess);
+    std::string entryPath(const Entry& entry) const;
+
+    // 关键字匹配与打分
+    std::vector<size_t> match(const std::vector<std::string>& terms) const;
+    bool matchesInOrder(const Entry& entry, const std::vector<std::string>& terms) const;
+    std::vector<size_t> rank(const std::vector<size_t>& matches, size_t limit) const;
+    static uint64_t signature(const char* text, size_t length);
+    static double frecency(const Entry& entry, int64_t now);
+
+    std::string getDatabaseFilePath();
+};
+
+#endif // DIRECTORY_DB_H
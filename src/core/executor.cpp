@@ -1,5 +1,6 @@
 #include "executor.h"
 #include "shell.h"
+#include "completion.h"
 #include <iostream>
 #include <cstring>
 #include <cstdlib>
@@ -38,42 +39,70 @@ int Executor::executePipeline(std::shared_ptr<PipelineCommand> pipeline) {
         return execute(pipeline->commands[0]);
     }
     
-    // 创建管道
-    std::vector<int> pipes;
+    auto pids = spawn(pipeline, false);
+    if (pids.empty()) {
+        return 1;
+    }
+    
+    return waitAll(pids);
+}
+
+std::vector<ProcessHandle> Executor::spawn(std::shared_ptr<PipelineCommand> pipeline, bool newProcessGroup) {
+    std::vector<pid_t> pids;
+    if (!pipeline || pipeline->commands.empty()) {
+        return pids;
+    }
+    
+    // 在父进程中查找可执行文件，找不到时直接失败
     int numCommands = pipeline->commands.size();
+    std::vector<std::string> executables;
+    for (const auto& command : pipeline->commands) {
+        std::string executable = findExecutable(command->command);
+        if (executable.empty()) {
+            reportNotFound(command->command);
+            return pids;
+        }
+        executables.push_back(executable);
+    }
     
     // 创建 (n-1) 个管道
+    std::vector<int> pipes;
     for (int i = 0; i < numCommands - 1; ++i) {
         int pipefd[2];
         if (pipe(pipefd) == -1) {
             perror("pipe");
-            return 1;
+            for (int fd : pipes) {
+                close(fd);
+            }
+            return pids;
         }
         pipes.push_back(pipefd[0]); // read end
         pipes.push_back(pipefd[1]); // write end
     }
     
-    std::vector<pid_t> pids;
-    
+    pid_t pgid = 0;
     for (int i = 0; i < numCommands; ++i) {
         pid_t pid = fork();
         if (pid == -1) {
             perror("fork");
-            return 1;
+            break;
         }
         
         if (pid == 0) {
             // 子进程
+            if (newProcessGroup) {
+                setpgid(0, pgid);
+            }
+            
+            // 恢复shell忽略的信号，否则子进程无法被Ctrl+C终止
+            signal(SIGINT, SIG_DFL);
+            signal(SIGQUIT, SIG_DFL);
             
-            // 设置输入重定向
+            // 不是第一个命令，从前一个管道读取；不是最后一个命令，写入到下一个管道
             if (i > 0) {
-                // 不是第一个命令，从前一个管道读取
                 dup2(pipes[(i-1)*2], STDIN_FILENO);
             }
-            
-            // 设置输出重定向
             if (i < numCommands - 1) {
-                // 不是最后一个命令，写入到下一个管道
                 dup2(pipes[i*2+1], STDOUT_FILENO);
             }
             
@@ -82,21 +111,31 @@ int Executor::executePipeline(std::shared_ptr<PipelineCommand> pipeline) {
                 close(fd);
             }
             
-            // 执行命令
-            auto argv = createArgv(pipeline->commands[i]);
-            std::string executable = findExecutable(pipeline->commands[i]->command);
-            if (executable.empty()) {
-                std::cerr << "Command not found: " << pipeline->commands[i]->command << std::endl;
-                exit(127);
+            // 命令自身的重定向优先于管道
+            int saved[3] = {-1, -1, -1};
+            if (!setupRedirection(pipeline->commands[i], saved)) {
+                _exit(1);
+            }
+            for (int fd : saved) {
+                if (fd != -1) {
+                    close(fd);
+                }
             }
             
-            execv(executable.c_str(), argv.data());
+            auto argv = createArgv(pipeline->commands[i]);
+            execv(executables[i].c_str(), argv.data());
             perror("execv");
-            exit(127);
-        } else {
-            // 父进程
-            pids.push_back(pid);
+            _exit(127);
         }
+        
+        // 父进程也设置进程组，避免与子进程的竞争
+        if (newProcessGroup) {
+            if (pgid == 0) {
+                pgid = pid;
+            }
+            setpgid(pid, pgid);
+        }
+        pids.push_back(pid);
     }
     
     // 父进程关闭所有管道描述符
@@ -104,33 +143,55 @@ int Executor::executePipeline(std::shared_ptr<PipelineCommand> pipeline) {
         close(fd);
     }
     
-    // 等待所有子进程
+    if (static_cast<int>(pids.size()) < numCommands) {
+        // 部分进程启动失败：终止并回收已启动的进程
+        for (pid_t pid : pids) {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        pids.clear();
+    }
+    
+    return pids;
+}
+
+int Executor::waitAll(const std::vector<ProcessHandle>& pids) {
     int status = 0;
     for (pid_t pid : pids) {
         waitpid(pid, &status, 0);
     }
     
-    return WEXITSTATUS(status);
+    return exitCode(status);
+}
+
+int Executor::exitCode(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    
+    return 1;
 }
 
 int Executor::executeExternal(std::shared_ptr<Command> command) {
     // 查找可执行文件
     std::string executable = findExecutable(command->command);
     if (executable.empty()) {
-        std::cerr << "Command not found: " << command->command << std::endl;
+        reportNotFound(command->command);
         return 127;
     }
     
     // 设置重定向
-    int savedStdin = -1, savedStdout = -1;
-    if (!setupRedirection(command, savedStdin, savedStdout)) {
+    int saved[3] = {-1, -1, -1};
+    if (!setupRedirection(command, saved)) {
         return 1;
     }
     
     pid_t pid = fork();
     if (pid == -1) {
         perror("fork");
-        restoreRedirection(savedStdin, savedStdout);
+        restoreRedirection(saved);
         return 1;
     }
     
@@ -143,60 +204,61 @@ int Executor::executeExternal(std::shared_ptr<Command> command) {
     } else {
         // 父进程
         int status = waitForChild(pid, command->runInBackground);
-        restoreRedirection(savedStdin, savedStdout);
+        restoreRedirection(saved);
         return status;
     }
 }
 
-bool Executor::setupRedirection(std::shared_ptr<Command> command, 
-                               int& savedStdin, int& savedStdout) {
-    // 输入重定向
-    if (!command->inputRedirect.empty()) {
-        savedStdin = dup(STDIN_FILENO);
-        int fd = open(command->inputRedirect.c_str(), O_RDONLY);
+bool Executor::setupRedirection(std::shared_ptr<Command> command, int saved[3]) {
+    // 依次替换标准输入、输出和错误输出；某一个失败时恢复已经替换的
+    auto redirect = [&](int target, const std::string& file, int flags, const char* what) {
+        int fd = open(file.c_str(), flags, 0644);
         if (fd == -1) {
-            perror("open input file");
+            perror(what);
+            restoreRedirection(saved);
             return false;
         }
-        dup2(fd, STDIN_FILENO);
+        saved[target] = dup(target);
+        dup2(fd, target);
         close(fd);
+        return true;
+    };
+    
+    // 输入重定向
+    if (!command->inputRedirect.empty() &&
+        !redirect(STDIN_FILENO, command->inputRedirect, O_RDONLY, "open input file")) {
+        return false;
     }
     
     // 输出重定向
     if (!command->outputRedirect.empty()) {
-        savedStdout = dup(STDOUT_FILENO);
-        int flags = O_WRONLY | O_CREAT;
-        if (command->appendOutput) {
-            flags |= O_APPEND;
-        } else {
-            flags |= O_TRUNC;
+        int flags = O_WRONLY | O_CREAT | (command->appendOutput ? O_APPEND : O_TRUNC);
+        if (!redirect(STDOUT_FILENO, command->outputRedirect, flags, "open output file")) {
+            return false;
         }
-        
-        int fd = open(command->outputRedirect.c_str(), flags, 0644);
-        if (fd == -1) {
-            perror("open output file");
-            if (savedStdin != -1) {
-                dup2(savedStdin, STDIN_FILENO);
-                close(savedStdin);
-            }
+    }
+    
+    // 错误输出重定向：2> 2>> 打开文件，&> 与标准输出共用同一个打开的文件
+    if (!command->errorRedirect.empty()) {
+        int flags = O_WRONLY | O_CREAT | (command->appendError ? O_APPEND : O_TRUNC);
+        if (!redirect(STDERR_FILENO, command->errorRedirect, flags, "open error file")) {
             return false;
         }
-        dup2(fd, STDOUT_FILENO);
-        close(fd);
+    } else if (command->errorToOutput) {
+        saved[STDERR_FILENO] = dup(STDERR_FILENO);
+        dup2(STDOUT_FILENO, STDERR_FILENO);
     }
     
     return true;
 }
 
-void Executor::restoreRedirection(int savedStdin, int savedStdout) {
-    if (savedStdin != -1) {
-        dup2(savedStdin, STDIN_FILENO);
-        close(savedStdin);
-    }
-    
-    if (savedStdout != -1) {
-        dup2(savedStdout, STDOUT_FILENO);
-        close(savedStdout);
+void Executor::restoreRedirection(int saved[3]) {
+    for (int target = 0; target < 3; ++target) {
+        if (saved[target] != -1) {
+            dup2(saved[target], target);
+            close(saved[target]);
+            saved[target] = -1;
+        }
     }
 }
 
@@ -228,6 +290,23 @@ std::string Executor::findExecutable(const std::string& command) {
     return "";
 }
 
+void Executor::reportNotFound(const std::string& command) {
+    std::cerr << "Command not found: " << command << std::endl;
+    
+    CompletionEngine* engine = shell->getCompletionEngine();
+    if (!engine || command.find('/') != std::string::npos) {
+        return;
+    }
+    auto suggestions = engine->suggestCommands(command);
+    if (!suggestions.empty()) {
+        std::cerr << "did you mean: ";
+        for (size_t i = 0; i < suggestions.size(); ++i) {
+            std::cerr << (i ? ", " : "") << suggestions[i];
+        }
+        std::cerr << "?" << std::endl;
+    }
+}
+
 std::vector<char*> Executor::createArgv(std::shared_ptr<Command> command) {
     std::vector<char*> argv;
     
@@ -254,13 +333,7 @@ int Executor::waitForChild(pid_t pid, bool background) {
     int status;
     waitpid(pid, &status, 0);
     
-    if (WIFEXITED(status)) {
-        return WEXITSTATUS(status);
-    } else if (WIFSIGNALED(status)) {
-        return 128 + WTERMSIG(status);
-    }
-    
-    return 1;
+    return exitCode(status);
 }
 
 void Executor::setupSignalHandlers() {
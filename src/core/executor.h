@@ -19,22 +19,35 @@ public:
     // 执行管道命令
     int executePipeline(std::shared_ptr<PipelineCommand> pipeline);
     
+    // 启动管道中的所有命令但不等待，各命令的重定向在子进程中设置
+    // newProcessGroup为true时所有子进程放入以第一个子进程为组长的新进程组
+    // 失败时返回空列表（已启动的子进程会被终止并回收）
+    std::vector<ProcessHandle> spawn(std::shared_ptr<PipelineCommand> pipeline, bool newProcessGroup);
+    
+    // 等待spawn启动的所有子进程，返回最后一个命令的退出码
+    int waitAll(const std::vector<ProcessHandle>& pids);
+    
+    // 将waitpid的状态转换为退出码
+    static int exitCode(int status);
+    
 private:
     Shell* shell;
     
     // 执行外部程序
     int executeExternal(std::shared_ptr<Command> command);
     
-    // 设置重定向
-    bool setupRedirection(std::shared_ptr<Command> command, 
-                         int& savedStdin, int& savedStdout);
+    // 设置重定向，被替换的标准输入、输出和错误输出保存在saved中（没有替换的为-1）
+    bool setupRedirection(std::shared_ptr<Command> command, int saved[3]);
     
     // 恢复重定向
-    void restoreRedirection(int savedStdin, int savedStdout);
+    void restoreRedirection(int saved[3]);
     
     // 查找可执行文件
     std::string findExecutable(const std::string& command);
     
+    // 报告找不到命令，并给出拼写相近的命令
+    void reportNotFound(const std::string& command);
+    
     // 将命令参数转换为char*数组
     std::vector<char*> createArgv(std::shared_ptr<Command> command);
     
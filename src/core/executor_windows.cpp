@@ -84,6 +84,12 @@ int Executor::executeCommand(std::shared_ptr<Command> command) {
         }
     }
     
+    if (!command->errorRedirect.empty()) {
+        cmdline += (command->appendError ? " 2>> \"" : " 2> \"") + command->errorRedirect + "\"";
+    } else if (command->errorToOutput) {
+        cmdline += " 2>&1";
+    }
+    
     // 后台执行
     if (command->runInBackground) {
         cmdline = "start /B " + cmdline;
@@ -0,0 +1,340 @@
+#include "fuzzy_finder.h"
+#include "history.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define FUZZY_X86_SIMD 1
+#else
+#define FUZZY_X86_SIMD 0
+#endif
+
+namespace {
+
+// 打分参数与fzf一致
+constexpr int kScoreMatch = 16;
+constexpr int kScoreGapStart = -3;
+constexpr int kScoreGapExtension = -1;
+constexpr int kBonusBoundary = kScoreMatch / 2;
+constexpr int kBonusBoundaryWhite = kBonusBoundary + 2;
+constexpr int kBonusBoundaryDelimiter = kBonusBoundary + 1;
+constexpr int kBonusNonWord = kScoreMatch / 2;
+constexpr int kBonusCamel = kBonusBoundary + kScoreGapExtension;
+constexpr int kBonusConsecutive = -(kScoreGapStart + kScoreGapExtension);
+constexpr int kBonusFirstCharMultiplier = 2;
+
+// 排序时频率和远近的权重（一个匹配字符约16分）
+constexpr double kFrequencyWeight = 4.0;
+constexpr double kRecencyWeight = 2.0;
+
+enum CharClass { White, Delimiter, NonWord, Lower, Upper, Number };
+
+CharClass classify(char c) {
+    if (c >= 'a' && c <= 'z') return Lower;
+    if (c >= 'A' && c <= 'Z') return Upper;
+    if (c >= '0' && c <= '9') return Number;
+    if (c == ' ' || c == '\t') return White;
+    if (c == '/' || c == ',' || c == ':' || c == ';' || c == '|' || c == '-' || c == '_' ||
+        c == '=' || c == '.') {
+        return Delimiter;
+    }
+    // UTF-8多字节字符按单词字符处理
+    return static_cast<unsigned char>(c) >= 0x80 ? Lower : NonWord;
+}
+
+int bonusFor(CharClass prev, CharClass cur) {
+    if (cur >= Lower) {
+        if (prev == White) return kBonusBoundaryWhite;
+        if (prev == Delimiter) return kBonusBoundaryDelimiter;
+        if (prev == NonWord) return kBonusBoundary;
+        if (prev == Lower && cur == Upper) return kBonusCamel;
+        if (prev != Number && cur == Number) return kBonusCamel;
+        return 0;
+    }
+    return cur == White ? kBonusBoundaryWhite : kBonusNonWord;
+}
+
+// 逐个字符查找下一个出现位置；三种实现结果相同
+using SubsequenceFn = bool (*)(const char* chars, const char* folds, size_t count,
+                               const char* text, size_t length);
+
+#if !FUZZY_X86_SIMD
+bool subsequenceScalar(const char* chars, const char* folds, size_t count,
+                       const char* text, size_t length) {
+    const char* p = text;
+    const char* end = text + length;
+    for (size_t i = 0; i < count; ++i) {
+        while (p < end && static_cast<char>(*p | folds[i]) != chars[i]) {
+            ++p;
+        }
+        if (p == end) {
+            return false;
+        }
+        ++p;
+    }
+    return true;
+}
+#endif
+
+#if FUZZY_X86_SIMD
+bool subsequenceSse2(const char* chars, const char* folds, size_t count,
+                     const char* text, size_t length) {
+    const char* p = text;
+    const char* end = text + length;
+    for (size_t i = 0; i < count; ++i) {
+        const __m128i needle = _mm_set1_epi8(chars[i]);
+        const __m128i fold = _mm_set1_epi8(folds[i]);
+        while (end - p >= 16) {
+            __m128i block = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), fold);
+            unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+            if (bits) {
+                p += __builtin_ctz(bits);
+                break;
+            }
+            p += 16;
+        }
+        while (p < end && static_cast<char>(*p | folds[i]) != chars[i]) {
+            ++p;
+        }
+        if (p == end) {
+            return false;
+        }
+        ++p;
+    }
+    return true;
+}
+
+__attribute__((target("avx2")))
+bool subsequenceAvx2(const char* chars, const char* folds, size_t count,
+                     const char* text, size_t length) {
+    const char* p = text;
+    const char* end = text + length;
+    for (size_t i = 0; i < count; ++i) {
+        const __m256i needle = _mm256_set1_epi8(chars[i]);
+        const __m256i fold = _mm256_set1_epi8(folds[i]);
+        while (end - p >= 32) {
+            __m256i block = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), fold);
+            unsigned bits = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+            if (bits) {
+                p += __builtin_ctz(bits);
+                break;
+            }
+            p += 32;
+        }
+        while (p < end && static_cast<char>(*p | folds[i]) != chars[i]) {
+            ++p;
+        }
+        if (p == end) {
+            return false;
+        }
+        ++p;
+    }
+    return true;
+}
+#endif
+
+SubsequenceFn selectSubsequence() {
+#if FUZZY_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return subsequenceAvx2;
+    }
+    return subsequenceSse2;
+#else
+    return subsequenceScalar;
+#endif
+}
+
+const SubsequenceFn subsequence = selectSubsequence();
+
+} // namespace
+
+uint64_t FuzzyPattern::charMask(std::string_view text) {
+    uint64_t mask = 0;
+    for (char ch : text) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        if (c >= 'A' && c <= 'Z') {
+            c |= 0x20;
+        }
+        unsigned bit;
+        if (c >= 'a' && c <= 'z') {
+            bit = c - 'a';
+        } else if (c >= '0' && c <= '9') {
+            bit = 26 + (c - '0');
+        } else {
+            bit = 36 + c % 28;
+        }
+        mask |= uint64_t(1) << bit;
+    }
+    return mask;
+}
+
+FuzzyPattern::FuzzyPattern(std::string_view query) : mask_(charMask(query)) {
+    bool caseSensitive = std::any_of(query.begin(), query.end(), [](char c) {
+        return c >= 'A' && c <= 'Z';
+    });
+
+    chars_.assign(query.begin(), query.end());
+    folds_.assign(chars_.size(), '\0');
+    if (!caseSensitive) {
+        // 只对字母忽略大小写：字母或上0x20即为小写，其他字节不能这样比较
+        for (size_t i = 0; i < chars_.size(); ++i) {
+            if (chars_[i] >= 'a' && chars_[i] <= 'z') {
+                folds_[i] = 0x20;
+            }
+        }
+    }
+}
+
+bool FuzzyPattern::prefilter(std::string_view text) const {
+    return subsequence(chars_.data(), folds_.data(), chars_.size(), text.data(), text.size());
+}
+
+int FuzzyPattern::score(std::string_view text, std::vector<size_t>* positions) const {
+    if (positions) {
+        positions->clear();
+    }
+    if (chars_.empty()) {
+        return 0;
+    }
+
+    // 正向找到第一个完整匹配的结尾，再反向收缩到最短的匹配区间
+    size_t pi = 0;
+    size_t end = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (equals(text[i], pi) && ++pi == chars_.size()) {
+            end = i + 1;
+            break;
+        }
+    }
+    if (pi < chars_.size()) {
+        return -1;
+    }
+
+    size_t start = end;
+    pi = chars_.size();
+    while (pi > 0) {
+        --start;
+        if (equals(text[start], pi - 1)) {
+            --pi;
+        }
+    }
+
+    int score = 0;
+    int consecutive = 0;
+    int firstBonus = 0;
+    bool inGap = false;
+    CharClass prev = start > 0 ? classify(text[start - 1]) : White;
+    pi = 0;
+    for (size_t i = start; i < end; ++i) {
+        CharClass cls = classify(text[i]);
+        if (pi < chars_.size() && equals(text[i], pi)) {
+            int bonus = bonusFor(prev, cls);
+            if (consecutive == 0) {
+                firstBonus = bonus;
+            } else {
+                // 连续匹配的一段沿用段首的边界加分
+                if (bonus >= kBonusBoundary && bonus > firstBonus) {
+                    firstBonus = bonus;
+                }
+                bonus = std::max({bonus, firstBonus, kBonusConsecutive});
+            }
+            score += kScoreMatch + (pi == 0 ? bonus * kBonusFirstCharMultiplier : bonus);
+            if (positions) {
+                positions->push_back(i);
+            }
+            inGap = false;
+            ++consecutive;
+            ++pi;
+        } else {
+            score += inGap ? kScoreGapExtension : kScoreGapStart;
+            inGap = true;
+            consecutive = 0;
+            firstBonus = 0;
+        }
+        prev = cls;
+    }
+    return score;
+}
+
+HistoryFinder::HistoryFinder(const History& history) : filtered_(false) {
+    // 从最新的记录往前，相同命令只保留最近一次的位置。命令文本直接使用驻留池中的
+    // （连续存放，不夹着日志的元数据），相同的命令编号相同，不需要再按文本查重
+    const HistoryPool& pool = history.getCommandPool();
+    std::vector<uint32_t> seen(pool.size(), UINT32_MAX);
+    for (size_t i = history.size(); i-- > 0;) {
+        uint32_t id = history.getCommandId(i);
+        if (seen[id] == UINT32_MAX) {
+            seen[id] = static_cast<uint32_t>(candidates_.size());
+            std::string_view command = pool.text(id);
+            candidates_.push_back({command, 1, FuzzyPattern::charMask(command), 0.0});
+        } else {
+            ++candidates_[seen[id]].count;
+        }
+    }
+
+    // 候选按从新到旧排列，下标即距今远近
+    for (size_t age = 0; age < candidates_.size(); ++age) {
+        Candidate& candidate = candidates_[age];
+        candidate.prior = kFrequencyWeight * std::log2(1.0 + candidate.count) -
+                          kRecencyWeight * std::log2(1.0 + age);
+    }
+}
+
+void HistoryFinder::setQuery(const std::string& query, size_t limit) {
+    FuzzyPattern pattern(query);
+
+    // 追加字符时新的匹配一定是旧匹配的子集
+    bool narrowing = filtered_ && !query_.empty() && query.size() > query_.size() &&
+                     query.compare(0, query_.size(), query_) == 0;
+    std::vector<uint32_t> matches;
+    if (narrowing) {
+        for (uint32_t index : matches_) {
+            const Candidate& candidate = candidates_[index];
+            if ((candidate.mask & pattern.mask()) == pattern.mask() && pattern.prefilter(candidate.command)) {
+                matches.push_back(index);
+            }
+        }
+    } else {
+        matches.reserve(candidates_.size());
+        for (uint32_t index = 0; index < candidates_.size(); ++index) {
+            const Candidate& candidate = candidates_[index];
+            if ((candidate.mask & pattern.mask()) == pattern.mask() && pattern.prefilter(candidate.command)) {
+                matches.push_back(index);
+            }
+        }
+    }
+    matches_.swap(matches);
+    query_ = query;
+    filtered_ = true;
+
+    // 分数相同时较新的命令在前；用大小为limit的堆保留最好的结果
+    auto better = [](const Result& a, const Result& b) {
+        return a.rank != b.rank ? a.rank > b.rank : a.candidate < b.candidate;
+    };
+    results_.clear();
+    if (limit == 0) {
+        return;
+    }
+    results_.reserve(limit + 1);
+    for (uint32_t index : matches_) {
+        const Candidate& candidate = candidates_[index];
+        Result result = {candidate.command, pattern.score(candidate.command) + candidate.prior, index};
+        if (results_.size() < limit) {
+            results_.push_back(result);
+            std::push_heap(results_.begin(), results_.end(), better);
+        } else if (better(result, results_.front())) {
+            std::pop_heap(results_.begin(), results_.end(), better);
+            results_.back() = result;
+            std::push_heap(results_.begin(), results_.end(), better);
+        }
+    }
+    std::sort_heap(results_.begin(), results_.end(), better);
+}
+
+std::vector<size_t> HistoryFinder::highlight(std::string_view command) const {
+    std::vector<size_t> positions;
+    FuzzyPattern(query_).score(command, &positions);
+    return positions;
+}
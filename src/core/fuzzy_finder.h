@@ -0,0 +1,83 @@
+#ifndef FUZZY_FINDER_H
+#define FUZZY_FINDER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class History;
+
+// 模糊匹配模式：查询中含大写字母时区分大小写（smart case）
+class FuzzyPattern {
+public:
+    explicit FuzzyPattern(std::string_view query);
+
+    bool empty() const { return chars_.empty(); }
+
+    // 查询中出现的字符集合；候选的字符集合必须包含它
+    uint64_t mask() const { return mask_; }
+
+    // 字符集合的64位摘要（忽略大小写，其他字节按取模归入剩余的位）
+    static uint64_t charMask(std::string_view text);
+
+    // 快速判断text是否按顺序包含所有字符（SSE2/AVX2向量化扫描）
+    bool prefilter(std::string_view text) const;
+
+    // fzf风格打分：子序列匹配，单词边界、连续匹配加分，间隔扣分；不匹配返回-1。
+    // positions非空时填入匹配字符的位置
+    int score(std::string_view text, std::vector<size_t>* positions = nullptr) const;
+
+private:
+    std::string chars_;
+    std::string folds_;     // 每个字符比较前对文本字节或上的值（0或0x20）
+    uint64_t mask_;
+
+    bool equals(char c, size_t i) const {
+        return static_cast<char>(c | folds_[i]) == chars_[i];
+    }
+};
+
+// 交互式历史查找（Ctrl-R）的候选集合
+//
+// 相同的命令合并为一个候选，记录出现次数和最近一次出现的先后。
+// 查询只是在上一次查询后追加字符时，只需在上一次的匹配结果中继续筛选。
+// 排序依据：匹配得分 + 出现频率 - 距今远近。
+class HistoryFinder {
+public:
+    struct Result {
+        std::string_view command;
+        double rank;
+        uint32_t candidate;
+    };
+
+    // 候选的文本指向History的驻留池，查找期间不能添加历史
+    explicit HistoryFinder(const History& history);
+
+    // 更新查询并重新排序，只保留前limit个结果
+    void setQuery(const std::string& query, size_t limit);
+
+    const std::vector<Result>& results() const { return results_; }
+    size_t matchCount() const { return matches_.size(); }
+    size_t candidateCount() const { return candidates_.size(); }
+
+    // 用当前查询计算匹配字符位置（用于高亮）
+    std::vector<size_t> highlight(std::string_view command) const;
+
+private:
+    struct Candidate {
+        std::string_view command;
+        uint32_t count;     // 出现次数
+        uint64_t mask;      // 字符集合摘要，不需要读命令文本就能排除大部分候选
+        double prior;       // 频率和远近的排序分，与查询无关
+    };
+
+    std::vector<Candidate> candidates_;
+    std::vector<uint32_t> matches_;
+    std::vector<Result> results_;
+    std::string query_;
+    bool filtered_;
+};
+
+#endif // FUZZY_FINDER_H
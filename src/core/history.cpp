@@ -2,110 +2,575 @@
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <atomic>
+#include <random>
 #include <cstdlib>
+#include <cstdio>
+#include <ctime>
 
 #ifdef PLATFORM_WINDOWS
 #include "posix_compat.h"
 #else
 #include <unistd.h>
 #include <pwd.h>
-#include <sys/types.h>
+#include <limits.h>
 #endif
 
-History::History() : maxHistorySize(1000) {
-    historyFile = getHistoryFilePath();
-    loadFromFile();
+namespace {
+
+// 压缩阈值：日志记录数超过上限的两倍（至少多1000条）才重写
+size_t compactionThreshold(size_t maxSize) {
+    if (maxSize > SIZE_MAX / 2 - 1000) {
+        return SIZE_MAX; // 不限制大小时从不压缩
+    }
+    return maxSize + std::max<size_t>(maxSize, 1000);
+}
+
+// 导出时转义制表符、换行和反斜杠，保证一条记录一行
+std::string escapeField(std::string_view field) {
+    std::string escaped;
+    escaped.reserve(field.size());
+    for (char c : field) {
+        switch (c) {
+            case '\\': escaped += "\\\\"; break;
+            case '\t': escaped += "\\t"; break;
+            case '\n': escaped += "\\n"; break;
+            default: escaped += c; break;
+        }
+    }
+    return escaped;
+}
+
+// 把日志中commandIds之后的记录加入驻留池，并记录每条命令最后一次出现的位置
+void internRecords(const HistoryLog& log, HistoryPool& pool, std::vector<uint32_t>& commandIds,
+                   std::vector<uint32_t>& lastUse) {
+    commandIds.reserve(log.size());
+    for (size_t id = commandIds.size(); id < log.size(); ++id) {
+        uint32_t command = pool.intern(log.command(id));
+        commandIds.push_back(command);
+        if (command == lastUse.size()) {
+            lastUse.push_back(static_cast<uint32_t>(id));
+        } else {
+            lastUse[command] = static_cast<uint32_t>(id);
+        }
+    }
+}
+
+// 把日志中尚未索引的记录加入三元组索引；空索引按现有记录数选择桶数
+void indexRecords(const HistoryLog& log, HistoryIndex& index) {
+    if (index.indexed() == 0) {
+        index.clear(log.size());
+    }
+    for (size_t id = index.indexed(); id < log.size(); ++id) {
+        index.add(static_cast<uint32_t>(id), log.command(id));
+    }
+}
+
+// 把尚未插入的记录按时间顺序加入前缀树（commandIds必须已经更新）
+void insertRecords(const std::vector<uint32_t>& commandIds, HistoryTrie& trie) {
+    for (size_t id = trie.inserted(); id < commandIds.size(); ++id) {
+        trie.insert(commandIds[id]);
+    }
+}
+
+} // namespace
+
+// 后台线程建立的缓存，属于logId标识的日志的前commandIds.size()条记录
+struct History::CacheBuild {
+    HistoryPool pool;
+    std::vector<uint32_t> commandIds;
+    std::vector<uint32_t> lastUse;
+    HistoryIndex index;
+    HistoryTrie trie{pool};
+    uint64_t logId = 0;
+    std::atomic<bool> done{false};
+};
+
+History::History() : History(getHistoryFilePath()) {}
+
+History::History(const std::string& file)
+    : maxHistorySize(1000), historyFile(file), sessionId(0), pendingIndex(SIZE_MAX),
+      ignoreSpace(false), ignoreDups(true), eraseDups(false), uniqueEnd(0), trie(pool),
+      logGeneration(0), clearedBefore(0), clearedAt(0), cachesReady(false) {
+    std::random_device device;
+    sessionId = (static_cast<uint64_t>(device()) << 32) | device();
+
+    char host[HOST_NAME_MAX + 1] = {};
+    if (gethostname(host, sizeof(host) - 1) == 0) {
+        hostname = host;
+    }
+
+    // 旧版本的文本历史（同名文件）在首次创建日志时导入
+    if (!log.open(historyFile, historyFile)) {
+        std::cerr << "history: cannot open " << historyFile << ".db, history will not be saved" << std::endl;
+    }
+    logGeneration = log.generation();
+
+    // 大的历史建立索引需要几百毫秒，不能放在第一次搜索时
+    startCacheBuild();
 }
 
 History::~History() {
-    saveToFile();
+    // 命令在执行时已经追加到文件，这里只需等待后台压缩完成；
+    // 建立缓存的线程只使用自己打开的日志和共享的结果，不必等待
+    if (compactThread.joinable()) {
+        compactThread.join();
+    }
+    if (cacheThread.joinable()) {
+        cacheThread.detach();
+    }
 }
 
 void History::addCommand(const std::string& command) {
-    // 忽略空命令和重复的连续命令
+    pendingIndex = SIZE_MAX;
+
+    // 忽略空命令；ignorespace时忽略以空白开头的命令
     if (command.empty() || command.find_first_not_of(" \t\n\r") == std::string::npos) {
         return;
     }
+    if (ignoreSpace && (command[0] == ' ' || command[0] == '\t')) {
+        return;
+    }
     
-    if (!commands.empty() && commands.back() == command) {
+    // 先合并其他会话的新命令，再判断是否与最后一条重复
+    sync();
+    if (ignoreDups && log.size() > 0 && log.command(log.size() - 1) == command) {
         return;
     }
     
-    commands.push_back(command);
-    trimHistory();
+    // 压缩会使序号失效，需在追加之前完成
+    maybeCompact();
+
+    char cwd[PATH_MAX];
+    const char* dir = getcwd(cwd, sizeof(cwd)) ? cwd : "";
+    pendingIndex = log.append(command, dir, hostname, static_cast<int64_t>(time(nullptr)), sessionId);
+    pendingStart = std::chrono::steady_clock::now();
+
+    // 后台压缩可能抢在追加之前拿到锁，append()重新打开了替换后的文件
+    dropStaleCaches();
+
+    // 缓存可用时随新命令增量更新
+    adoptCaches(false);
 }
 
-std::vector<std::string> History::getHistory() const {
-    return commands;
+void History::finishCommand(int exitStatus) {
+    if (pendingIndex == SIZE_MAX) {
+        return;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - pendingStart).count();
+    log.finish(pendingIndex, static_cast<uint32_t>(std::min<int64_t>(elapsed, UINT32_MAX)), exitStatus);
+    pendingIndex = SIZE_MAX;
 }
 
-std::string History::getCommand(size_t index) const {
-    if (index < commands.size()) {
-        return commands[index];
+std::string_view History::getCommand(size_t index) const {
+    if (index < size()) {
+        return log.command(idAt(index));
     }
-    return "";
+    return {};
+}
+
+uint32_t History::getCommandId(size_t index) const {
+    adoptCaches(true);
+    return commandIds[idAt(index)];
+}
+
+const HistoryPool& History::getCommandPool() const {
+    adoptCaches(true);
+    return pool;
+}
+
+HistoryRecord History::getRecord(size_t index) const {
+    return log.record(idAt(index));
 }
 
 size_t History::size() const {
-    return commands.size();
+    if (eraseDups) {
+        updateUnique();
+        auto first = std::lower_bound(uniqueIds.begin(), uniqueIds.end(), static_cast<uint32_t>(clearedBefore));
+        return std::min(static_cast<size_t>(uniqueIds.end() - first), maxHistorySize);
+    }
+    return std::min(log.size() - std::min(clearedBefore, log.size()), maxHistorySize);
 }
 
 void History::clear() {
-    commands.clear();
-    saveToFile();
+    // 只隐藏：日志被其他会话共享，不能替换为空日志
+    sync();
+    clearedBefore = log.size();
+    clearedAt = static_cast<int64_t>(time(nullptr));
 }
 
 void History::show() const {
-    for (size_t i = 0; i < commands.size(); ++i) {
-        std::cout << std::setw(4) << (i + 1) << "  " << commands[i] << std::endl;
+    for (auto it = begin(); it != end(); ++it) {
+        std::cout << std::setw(4) << (it.index() + 1) << "  " << *it << std::endl;
     }
 }
 
 std::vector<size_t> History::search(const std::string& pattern) const {
+    return searchAll({pattern});
+}
+
+std::vector<size_t> History::searchAll(const std::vector<std::string>& terms) const {
     std::vector<size_t> results;
+    std::vector<std::string_view> views(terms.begin(), terms.end());
+    auto matches = [&](size_t id) {
+        std::string_view command = log.command(id);
+        return std::all_of(views.begin(), views.end(), [&](std::string_view term) {
+            return command.find(term) != std::string_view::npos;
+        });
+    };
     
-    for (size_t i = 0; i < commands.size(); ++i) {
-        if (commands[i].find(pattern) != std::string::npos) {
-            results.push_back(i);
+    // 三元组索引给出候选，逐条确认；关键字都短于3个字符或索引还在后台建立时只能线性查找
+    const size_t count = size();
+    if (count == 0) {
+        return results;
+    }
+    std::vector<uint32_t> candidates;
+    if (adoptCaches(false) && index.candidates(views, static_cast<uint32_t>(idAt(0)), candidates)) {
+        for (uint32_t id : candidates) {
+            size_t position = indexOf(id);
+            if (position != SIZE_MAX && matches(id)) {
+                results.push_back(position);
+            }
+        }
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            if (matches(idAt(i))) {
+                results.push_back(i);
+            }
         }
     }
     
     return results;
 }
 
+std::string History::suggest(const std::string& prefix) const {
+    // 按键时调用，前缀树还在后台建立时不等待
+    if (!adoptCaches(false)) {
+        return "";
+    }
+    // 前缀树给出的是最近一次使用的命令，它在clear()之前就说明所有候选都已被清除
+    std::string_view best = trie.suggest(prefix);
+    if (best.empty() || lastUse[pool.find(best)] < clearedBefore) {
+        return "";
+    }
+    return std::string(best);
+}
+
+std::vector<size_t> History::filter(const HistoryFilter& filter) const {
+    std::vector<size_t> results;
+
+    for (size_t i = 0; i < size(); ++i) {
+        HistoryRecord record = log.record(idAt(i));
+        if (filter.failedOnly && record.exitStatus <= 0) {
+            continue; // -1（未知/仍在运行）不算失败
+        }
+        if (filter.currentSession && record.sessionId != sessionId) {
+            continue;
+        }
+        if (!filter.cwd.empty() && record.cwd != filter.cwd) {
+            continue;
+        }
+        if (filter.since > 0 && record.startTime < filter.since) {
+            continue;
+        }
+        results.push_back(i);
+    }
+
+    return results;
+}
+
+void History::exportText(std::ostream& out) const {
+    // 开始时间  耗时(ms)  退出码  会话ID  主机  目录  命令
+    char timeBuffer[32];
+    for (size_t i = 0; i < size(); ++i) {
+        HistoryRecord record = log.record(idAt(i));
+        time_t startTime = static_cast<time_t>(record.startTime);
+        struct tm tm;
+        if (record.startTime > 0 && localtime_r(&startTime, &tm)) {
+            strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%dT%H:%M:%S", &tm);
+        } else {
+            snprintf(timeBuffer, sizeof(timeBuffer), "-");
+        }
+
+        char session[17];
+        snprintf(session, sizeof(session), "%016llx", static_cast<unsigned long long>(record.sessionId));
+
+        out << timeBuffer << '\t' << record.durationMs << '\t' << record.exitStatus << '\t'
+            << session << '\t' << escapeField(record.hostname) << '\t' << escapeField(record.cwd) << '\t'
+            << escapeField(record.command) << '\n';
+    }
+    out.flush();
+}
+
 void History::setMaxSize(size_t maxSize) {
     maxHistorySize = maxSize;
-    trimHistory();
+    maybeCompact();
 }
 
-void History::loadFromFile() {
-    std::ifstream file(historyFile);
-    if (!file.is_open()) {
-        return; // 文件不存在是正常的
+bool History::setControl(const std::string& spec) {
+    bool space = false;
+    bool dups = false;
+    bool erase = false;
+
+    size_t start = 0;
+    while (start <= spec.size()) {
+        size_t end = spec.find(':', start);
+        if (end == std::string::npos) {
+            end = spec.size();
+        }
+        std::string option = spec.substr(start, end - start);
+        if (option == "ignorespace") {
+            space = true;
+        } else if (option == "ignoredups") {
+            dups = true;
+        } else if (option == "ignoreboth") {
+            space = dups = true;
+        } else if (option == "erasedups") {
+            erase = true;
+        } else if (!option.empty()) {
+            return false;
+        }
+        start = end + 1;
     }
-    
-    std::string line;
-    while (std::getline(file, line)) {
-        if (!line.empty()) {
-            commands.push_back(line);
+
+    ignoreSpace = space;
+    ignoreDups = dups;
+    if (erase != eraseDups) {
+        // 切换后可见的记录完全不同，视图重新建立
+        eraseDups = erase;
+        uniqueIds.clear();
+        uniqueIds.shrink_to_fit();
+        uniqueEnd = 0;
+    }
+    return true;
+}
+
+std::string History::getControl() const {
+    std::string spec;
+    auto add = [&spec](const char* option) {
+        if (!spec.empty()) {
+            spec += ':';
         }
+        spec += option;
+    };
+    if (ignoreSpace && ignoreDups) {
+        add("ignoreboth");
+    } else if (ignoreSpace) {
+        add("ignorespace");
+    } else if (ignoreDups) {
+        add("ignoredups");
     }
-    
-    file.close();
-    trimHistory();
+    if (eraseDups) {
+        add("erasedups");
+    }
+    return spec;
+}
+
+HistoryStats History::getStats() const {
+    adoptCaches(true);
+    HistoryStats stats;
+    stats.entries = size();
+    stats.records = log.size();
+    stats.uniqueCommands = pool.size();
+    stats.logBytes = log.bytes();
+    stats.poolBytes = pool.memoryUsage() + commandIds.capacity() * sizeof(uint32_t) +
+                      lastUse.capacity() * sizeof(uint32_t) + uniqueIds.capacity() * sizeof(uint32_t);
+    stats.indexBytes = index.memoryUsage();
+    stats.trieBytes = trie.memoryUsage();
+    return stats;
 }
 
-void History::saveToFile() {
-    std::ofstream file(historyFile);
-    if (!file.is_open()) {
-        return; // 无法写入文件，静默失败
+bool History::parseSize(const std::string& text, size_t& size) {
+    if (text == "unlimited") {
+        size = kUnlimited;
+        return true;
     }
-    
-    for (const auto& command : commands) {
-        file << command << std::endl;
+
+    size_t end = 0;
+    long long value;
+    try {
+        value = std::stoll(text, &end);
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (end != text.size()) {
+        return false;
+    }
+    size = value < 0 ? kUnlimited : static_cast<size_t>(value);
+    return true;
+}
+
+void History::sync() {
+    log.sync();
+    if (dropStaleCaches()) {
+        pendingIndex = SIZE_MAX; // 日志被压缩替换，序号已失效
+    }
+    adoptCaches(false);
+}
+
+bool History::dropStaleCaches() {
+    if (log.generation() == logGeneration) {
+        return false;
+    }
+
+    logGeneration = log.generation();
+    if (clearedBefore > 0) {
+        // 压缩后序号改变：clear()之后开始的命令仍然可见
+        clearedBefore = log.size();
+        while (clearedBefore > 0 && log.record(clearedBefore - 1).startTime > clearedAt) {
+            --clearedBefore;
+        }
+    }
+    index.clear();
+    trie.clear();
+    pool.clear();
+    commandIds.clear();
+    lastUse.clear();
+    uniqueIds.clear();
+    uniqueEnd = 0;
+    cachesReady = false;
+    startCacheBuild();
+    return true;
+}
+
+void History::startCacheBuild() const {
+    if (cacheThread.joinable()) {
+        return; // 已经在建立；完成后adoptCaches检查它是否属于当前的日志
+    }
+
+    // 线程打开自己的HistoryLog：主线程追加记录时会重新映射，不能共用
+    cacheBuild = std::make_shared<CacheBuild>();
+    cacheThread = std::thread([build = cacheBuild, file = historyFile]() {
+        HistoryLog source;
+        if (source.open(file)) {
+            build->logId = source.id();
+            internRecords(source, build->pool, build->commandIds, build->lastUse);
+            indexRecords(source, build->index);
+            insertRecords(build->commandIds, build->trie);
+        }
+        build->done.store(true, std::memory_order_release);
+    });
+}
+
+bool History::adoptCaches(bool wait) const {
+    if (cacheThread.joinable() && (wait || cacheBuild->done.load(std::memory_order_acquire))) {
+        cacheThread.join();
+        std::shared_ptr<CacheBuild> build = std::move(cacheBuild);
+        if (build->logId == log.id() && build->commandIds.size() <= log.size()) {
+            pool = std::move(build->pool);
+            commandIds = std::move(build->commandIds);
+            lastUse = std::move(build->lastUse);
+            index = std::move(build->index);
+            trie.swap(build->trie);
+            cachesReady = true;
+        } else if (!cachesReady) {
+            // 建立期间日志被压缩替换，结果属于旧文件：重新建立，必须等待时直接在下面建立
+            if (!wait) {
+                startCacheBuild();
+                return false;
+            }
+        }
+    }
+    if (wait) {
+        cachesReady = true;
+    }
+
+    if (cachesReady) {
+        updateCaches();
+    }
+    return cachesReady;
+}
+
+void History::updateCaches() const {
+    internRecords(log, pool, commandIds, lastUse);
+    indexRecords(log, index);
+    insertRecords(commandIds, trie);
+
+    // 记录数远超建立时的预计：在后台按新的记录数重建，完成前继续使用现在的索引
+    if (index.undersized(log.size())) {
+        startCacheBuild();
+    }
+}
+
+void History::updateUnique() const {
+    if (uniqueEnd == log.size()) {
+        return;
+    }
+    adoptCaches(true);
+
+    // 新记录先加到末尾，再一次性去掉被新记录取代的旧记录
+    for (size_t id = uniqueEnd; id < log.size(); ++id) {
+        uniqueIds.push_back(static_cast<uint32_t>(id));
+    }
+    uniqueIds.erase(std::remove_if(uniqueIds.begin(), uniqueIds.end(), [this](uint32_t id) {
+        return lastUse[commandIds[id]] != id;
+    }), uniqueIds.end());
+    uniqueEnd = log.size();
+}
+
+size_t History::idAt(size_t index) const {
+    size_t count = size();
+    if (eraseDups) {
+        return uniqueIds[uniqueIds.size() - count + index];
+    }
+    return log.size() - count + index;
+}
+
+size_t History::indexOf(size_t id) const {
+    size_t count = size();
+    if (count == 0) {
+        return SIZE_MAX;
+    }
+    size_t first = idAt(0);
+    if (id < first || id >= log.size()) {
+        return SIZE_MAX;
+    }
+    if (!eraseDups) {
+        return id - first;
+    }
+    auto it = std::lower_bound(uniqueIds.end() - count, uniqueIds.end(), static_cast<uint32_t>(id));
+    if (it == uniqueIds.end() || *it != id) {
+        return SIZE_MAX; // 被同一命令后来的记录取代
+    }
+    return static_cast<size_t>(it - (uniqueIds.end() - count));
+}
+
+size_t History::retainedRecords() const {
+    if (maxHistorySize == kUnlimited) {
+        return kUnlimited;
+    }
+    if (!eraseDups) {
+        return maxHistorySize;
+    }
+    // erasedups时可见的记录分散在更长的一段日志中，从第一条可见的记录开始保留。
+    // 不考虑clear()：本会话隐藏的记录其他会话仍然可见
+    updateUnique();
+    size_t count = std::min(uniqueIds.size(), maxHistorySize);
+    return count == 0 ? 0 : log.size() - uniqueIds[uniqueIds.size() - count];
+}
+
+void History::maybeCompact() {
+    if (log.size() <= compactionThreshold(retainedRecords())) {
+        return;
     }
     
-    file.close();
+    // 上一次压缩已完成但还没重新打开：先同步再判断
+    if (compactThread.joinable()) {
+        compactThread.join();
+        sync();
+        if (log.size() <= compactionThreshold(retainedRecords())) {
+            return;
+        }
+    }
+    scheduleCompaction(retainedRecords());
+}
+
+void History::scheduleCompaction(size_t keep) {
+    compactThread = std::thread([file = historyFile, keep]() {
+        HistoryLog::compact(file, keep);
+    });
 }
 
 std::string History::getHistoryFilePath() {
@@ -123,10 +588,3 @@ std::string History::getHistoryFilePath() {
     // 最后的备选方案
     return ".mysh_history";
 }
-
-void History::trimHistory() {
-    if (commands.size() > maxHistorySize) {
-        size_t toRemove = commands.size() - maxHistorySize;
-        commands.erase(commands.begin(), commands.begin() + toRemove);
-    }
-}
\ No newline at end of file
@@ -2,27 +2,105 @@
 #define HISTORY_H
 
 #include <string>
+#include <string_view>
 #include <vector>
-#include <fstream>
+#include <memory>
+#include <iterator>
+#include <thread>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+#include "history_log.h"
+#include "history_index.h"
+#include "history_pool.h"
+#include "history_trie.h"
 
+// 历史过滤条件（history --failed/--cwd/--since）
+struct HistoryFilter {
+    bool failedOnly = false;
+    bool currentSession = false;
+    std::string cwd;            // 非空时只保留在该目录执行的命令
+    int64_t since = 0;          // 只保留此时间（Unix秒）之后开始的命令
+};
+
+// 历史统计（history --stats）
+struct HistoryStats {
+    size_t entries = 0;         // 可见的条数
+    size_t records = 0;         // 日志中的记录数
+    size_t uniqueCommands = 0;  // 不同的命令数
+    size_t logBytes = 0;        // 日志文件大小
+    size_t poolBytes = 0;       // 驻留的命令文本和编号表
+    size_t indexBytes = 0;      // 三元组索引
+    size_t trieBytes = 0;       // 自动建议的前缀树
+};
+
+// 命令历史
+//
+// 每条命令保存为一条二进制记录（开始时间、耗时、退出码、工作目录、会话ID、主机名），
+// 存储在HistoryLog中：启动时只映射文件，不逐条解析；命令开始执行时追加记录，
+// 结束后原地写入耗时和退出码，shell被杀死也不会丢失已开始的命令。
+// 多个会话共享同一个日志，其他会话的追加在sync()后可见。
+// 对外的序号从0开始，只覆盖最近maxHistorySize条；日志远超上限时在后台压缩。
+// 相同的命令在内存中只保存一份（HistoryPool），搜索使用三元组索引，自动建议使用前缀树，
+// 都在启动时由后台线程从日志建立，之后随新记录增量更新。
+// 与bash的HISTCONTROL一样支持ignorespace、ignoredups和erasedups；erasedups只影响显示，
+// 日志中仍保留每一次执行的记录。clear()（history -c）与bash一样只清空当前会话看到的历史，
+// 日志文件和其他会话不受影响。
 class History {
 public:
+    static constexpr size_t kUnlimited = SIZE_MAX;
+
     History();
+    explicit History(const std::string& file);
     ~History();
     
-    // 添加命令到历史记录
+    // 按顺序遍历可见的命令，不复制（string_view在下一次add/sync后失效）
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::string_view*;
+        using reference = std::string_view;
+
+        const_iterator(const History* history, size_t index) : history_(history), index_(index) {}
+
+        std::string_view operator*() const { return history_->getCommand(index_); }
+        const_iterator& operator++() { ++index_; return *this; }
+        bool operator==(const const_iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const const_iterator& other) const { return index_ != other.index_; }
+
+        // 当前命令的序号
+        size_t index() const { return index_; }
+
+    private:
+        const History* history_;
+        size_t index_;
+    };
+
+    // 添加命令到历史记录（同时追加到历史文件），按历史控制选项忽略部分命令
     void addCommand(const std::string& command);
     
-    // 获取历史记录
-    std::vector<std::string> getHistory() const;
+    // 记录最近一次addCommand添加的命令的退出码和耗时
+    void finishCommand(int exitStatus);
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
     
-    // 获取指定索引的命令
-    std::string getCommand(size_t index) const;
+    // 获取指定索引的命令（在下一次add/sync后失效）
+    std::string_view getCommand(size_t index) const;
+
+    // 指定索引的命令在驻留池中的编号；相同的命令编号相同
+    uint32_t getCommandId(size_t index) const;
+    const HistoryPool& getCommandPool() const;
+
+    // 获取指定索引的完整记录（字符串在下一次add/sync后失效）
+    HistoryRecord getRecord(size_t index) const;
     
     // 获取历史记录大小
     size_t size() const;
     
-    // 清空历史记录
+    // 清空历史记录：当前会话不再看到（也不再建议）已有的记录，日志文件和其他会话不变
     void clear();
     
     // 显示历史记录
@@ -31,25 +109,107 @@ public:
     // 搜索历史记录
     std::vector<size_t> search(const std::string& pattern) const;
     
-    // 设置最大历史记录数
+    // 搜索同时包含所有关键字的记录
+    std::vector<size_t> searchAll(const std::vector<std::string>& terms) const;
+
+    // 以prefix开头的最近使用的命令（行内自动建议）；没有时返回空字符串
+    std::string suggest(const std::string& prefix) const;
+
+    // 按条件过滤，返回匹配记录的索引
+    std::vector<size_t> filter(const HistoryFilter& filter) const;
+
+    // 以制表符分隔的文本导出完整记录
+    void exportText(std::ostream& out) const;
+
+    // 设置最大历史记录数（kUnlimited表示不限制）
     void setMaxSize(size_t maxSize);
+    size_t getMaxSize() const { return maxHistorySize; }
+
+    // 解析历史大小：非负整数，负数或"unlimited"表示不限制
+    static bool parseSize(const std::string& text, size_t& size);
     
+    // 历史控制选项，冒号分隔：ignorespace、ignoredups、ignoreboth、erasedups；
+    // 空字符串表示全部关闭。有无法识别的选项时返回false，不做修改
+    bool setControl(const std::string& spec);
+    std::string getControl() const;
+
+    HistoryStats getStats() const;
+
+    // 读取其他会话追加的新命令
+    void sync();
+
+    uint64_t getSessionId() const { return sessionId; }
+
 private:
-    std::vector<std::string> commands;
+    HistoryLog log;
     size_t maxHistorySize;
-    std::string historyFile;
-    
-    // 加载历史记录文件
-    void loadFromFile();
+    std::string historyFile;    // 日志文件的基础路径（同时也是旧文本历史的路径）
     
-    // 保存到历史记录文件
-    void saveToFile();
+    uint64_t sessionId;
+    std::string hostname;
+
+    // 正在执行的命令在日志中的序号
+    size_t pendingIndex;
+    std::chrono::steady_clock::time_point pendingStart;
+
+    std::thread compactThread;
+
+    // 历史控制选项
+    bool ignoreSpace;
+    bool ignoreDups;
+    bool eraseDups;
+
+    // 日志中每条记录的命令在池中的编号，以及每条命令最后一次出现的记录
+    mutable HistoryPool pool;
+    mutable std::vector<uint32_t> commandIds;
+    mutable std::vector<uint32_t> lastUse;
+
+    // erasedups时可见的记录（每条命令最后一次出现的记录，按时间排列），以及已处理到的日志位置
+    mutable std::vector<uint32_t> uniqueIds;
+    mutable size_t uniqueEnd;
+
+    // 序号是日志中的绝对序号
+    mutable HistoryIndex index;
+
+    // 自动建议用的前缀树
+    mutable HistoryTrie trie;
+
+    // 上面的缓存对应的日志generation；日志被重新打开后全部丢弃
+    uint64_t logGeneration;
+
+    // clear()之后序号小于clearedBefore的记录不可见；日志被压缩重新编号后按clear()的时间重新确定
+    size_t clearedBefore;
+    int64_t clearedAt;
+
+    // 驻留池、索引和前缀树在后台线程中从日志建立（见startCacheBuild），完成后由adoptCaches接管；
+    // 在此之前cachesReady为false，搜索退回线性查找，自动建议为空
+    struct CacheBuild;
+    mutable std::shared_ptr<CacheBuild> cacheBuild;
+    mutable std::thread cacheThread;
+    mutable bool cachesReady;
+
+    // 后台建立驻留池、索引和前缀树；接管建好的结果（wait时等待它完成），返回缓存是否可用
+    void startCacheBuild() const;
+    bool adoptCaches(bool wait) const;
+
+    // 把日志中尚未处理的记录加入驻留池、索引、erasedups视图和前缀树
+    void updateCaches() const;
+    void updateUnique() const;
+    bool dropStaleCaches();
+
+    // 可见的第index条在日志中的序号，以及反过来（不可见时返回SIZE_MAX）
+    size_t idAt(size_t index) const;
+    size_t indexOf(size_t id) const;
+
+    // 压缩时需要保留的最近记录数
+    size_t retainedRecords() const;
+
+    // 在后台压缩历史文件
+    void maybeCompact();
+    void scheduleCompaction(size_t keep);
     
     // 获取历史文件路径
     std::string getHistoryFilePath();
-    
-    // 修剪历史记录（保持在最大大小内）
-    void trimHistory();
 };
 
-#endif // HISTORY_H
\ No newline at end of file
+#endif // HISTORY_H
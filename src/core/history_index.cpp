@@ -0,0 +1,97 @@
+#include "history_index.h"
+#include <algorithm>
+
+void HistoryIndex::add(uint32_t id, std::string_view command) {
+    next_ = static_cast<size_t>(id) + 1;
+    if (buckets_.empty()) {
+        buckets_.resize(size_t(1) << bits_);
+    }
+
+    // 序号递增，同一条命令中重复的三元组只需比较桶的最后一个元素
+    for (size_t i = 0; i + 3 <= command.size(); ++i) {
+        std::vector<uint32_t>& ids = buckets_[bucket(command.data() + i)];
+        if (ids.empty() || ids.back() != id) {
+            ids.push_back(id);
+        }
+    }
+}
+
+void HistoryIndex::clear(size_t expected) {
+    buckets_.clear();
+    buckets_.shrink_to_fit();
+    next_ = 0;
+
+    // 大约每4条记录一个桶：1000条时1024个桶，100万条时2^18个
+    bits_ = kMinBucketBits;
+    while (bits_ < kMaxBucketBits && (size_t(1) << (bits_ + 2)) < expected) {
+        ++bits_;
+    }
+}
+
+bool HistoryIndex::undersized(size_t records) const {
+    return bits_ < kMaxBucketBits && records > (size_t(1) << (bits_ + 4));
+}
+
+bool HistoryIndex::candidates(const std::vector<std::string_view>& terms, uint32_t first,
+                              std::vector<uint32_t>& result) const {
+    result.clear();
+
+    // 收集所有三元组对应的列表，跳过小于first的部分
+    struct Range {
+        const uint32_t* begin;
+        const uint32_t* end;
+    };
+    std::vector<Range> lists;
+    for (std::string_view term : terms) {
+        for (size_t i = 0; i + 3 <= term.size(); ++i) {
+            if (buckets_.empty()) {
+                return true; // 还没有任何记录
+            }
+            const std::vector<uint32_t>& ids = buckets_[bucket(term.data() + i)];
+            lists.push_back({std::lower_bound(ids.data(), ids.data() + ids.size(), first),
+                             ids.data() + ids.size()});
+        }
+    }
+    if (lists.empty()) {
+        return false;
+    }
+
+    std::sort(lists.begin(), lists.end(), [](const Range& a, const Range& b) {
+        return a.end - a.begin < b.end - b.begin;
+    });
+    result.assign(lists[0].begin, lists[0].end);
+
+    // 候选集合通常远小于后面的列表，用倍增查找跳过不可能的部分
+    for (size_t l = 1; l < lists.size() && !result.empty(); ++l) {
+        const uint32_t* cursor = lists[l].begin;
+        const uint32_t* end = lists[l].end;
+        size_t kept = 0;
+        for (uint32_t id : result) {
+            // 找到第一个不小于id的hi，答案在[lo, hi]中
+            const uint32_t* lo = cursor;
+            const uint32_t* hi = cursor;
+            for (size_t step = 1; hi < end && *hi < id; step *= 2) {
+                lo = hi + 1;
+                hi = static_cast<size_t>(end - lo) > step ? lo + step : end;
+            }
+            cursor = std::lower_bound(lo, hi, id);
+            if (cursor == end) {
+                break;
+            }
+            if (*cursor == id) {
+                result[kept++] = id;
+            }
+        }
+        result.resize(kept);
+    }
+
+    return true;
+}
+
+size_t HistoryIndex::memoryUsage() const {
+    size_t bytes = buckets_.capacity() * sizeof(std::vector<uint32_t>);
+    for (const auto& ids : buckets_) {
+        bytes += ids.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
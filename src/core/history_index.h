@@ -0,0 +1,53 @@
+#ifndef HISTORY_INDEX_H
+#define HISTORY_INDEX_H
+
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 历史命令的三元组倒排索引
+//
+// 每个三字节子串散列到一个桶，桶里是包含它的记录序号（递增）。查询时取出所有
+// 三元组的桶，从最短的开始求交集，得到的候选再逐条确认（散列冲突只会多出候选）。
+// 桶数按记录数选定（最多2^18个），直接按下标访问，建索引时不需要哈希表查找。
+// 记录只会追加，索引随之增量更新；日志被压缩（序号变化）或记录数远超桶数时整体重建。
+class HistoryIndex {
+public:
+    // 追加一条记录，id必须大于之前所有记录
+    void add(uint32_t id, std::string_view command);
+
+    // 清空并按预计的记录数选择桶数
+    void clear(size_t expected = 0);
+
+    // 记录数已远超建立时的预计，应当用clear()重建
+    bool undersized(size_t records) const;
+
+    // 已索引的记录数（下一条要索引的序号）
+    size_t indexed() const { return next_; }
+
+    // 返回可能同时包含所有terms的记录序号（递增，仅限id >= first）；
+    // 长度不足3的term无法过滤，全部不足3时返回false，调用者需线性查找
+    bool candidates(const std::vector<std::string_view>& terms, uint32_t first,
+                    std::vector<uint32_t>& result) const;
+
+    // 索引占用的内存（字节，估计值）
+    size_t memoryUsage() const;
+
+private:
+    static constexpr int kMinBucketBits = 10;
+    static constexpr int kMaxBucketBits = 18;
+
+    std::vector<std::vector<uint32_t>> buckets_;
+    size_t next_ = 0;
+    int bits_ = kMinBucketBits;
+
+    uint32_t bucket(const char* p) const {
+        uint32_t trigram = (static_cast<uint32_t>(static_cast<unsigned char>(p[0])) << 16) |
+                           (static_cast<uint32_t>(static_cast<unsigned char>(p[1])) << 8) |
+                           static_cast<unsigned char>(p[2]);
+        return (trigram * 0x9E3779B1u) >> (32 - bits_);
+    }
+};
+
+#endif // HISTORY_INDEX_H
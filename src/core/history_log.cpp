@@ -0,0 +1,543 @@
+#include "history_log.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+
+namespace {
+
+const char kLogMagic[8] = {'M', 'Y', 'S', 'H', 'L', 'O', 'G', '1'};
+const char kIdxMagic[8] = {'M', 'Y', 'S', 'H', 'I', 'D', 'X', '1'};
+constexpr size_t kHeaderSize = 16;
+
+// 映射时预留的最小地址空间，文件在此范围内增长无需重新映射
+constexpr size_t kMinLogMap = 64u << 20;
+constexpr size_t kMinIdxMap = 8u << 20;
+
+struct RecordHeader {
+    uint32_t recordLength;      // 整条记录长度（含头部和补齐）
+    uint32_t commandLength;
+    int64_t startTime;
+    uint64_t sessionId;
+    uint32_t durationMs;
+    int32_t exitStatus;
+    uint16_t cwdLength;
+    uint16_t hostLength;
+    uint32_t reserved;
+};
+
+size_t paddedLength(size_t length) {
+    return (length + 7) & ~static_cast<size_t>(7);
+}
+
+uint64_t newLogId() {
+    std::random_device device;
+    return (static_cast<uint64_t>(device()) << 32) | device();
+}
+
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool readHeader(int fd, const char* magic, uint64_t& id) {
+    char header[kHeaderSize];
+    if (pread(fd, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        std::memcmp(header, magic, 8) != 0) {
+        return false;
+    }
+    std::memcpy(&id, header + 8, sizeof(id));
+    return true;
+}
+
+std::string makeHeader(const char* magic, uint64_t id) {
+    std::string header(magic, 8);
+    header.append(reinterpret_cast<const char*>(&id), sizeof(id));
+    return header;
+}
+
+// 校验offset处是否是一条完整的记录
+bool validRecord(const char* data, size_t size, size_t offset) {
+    if (offset + sizeof(RecordHeader) > size || offset % 8 != 0) {
+        return false;
+    }
+    RecordHeader header;
+    std::memcpy(&header, data + offset, sizeof(header));
+    size_t payload = sizeof(header) + header.commandLength + header.cwdLength + header.hostLength;
+    return header.recordLength >= payload && header.recordLength == paddedLength(payload) &&
+           offset + header.recordLength <= size;
+}
+
+// 写入临时文件后rename替换target，失败时target不变
+bool replaceFile(const std::string& target, const std::string& content) {
+    std::string temp = target + ".tmp." + std::to_string(getpid());
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        return false;
+    }
+    bool written = writeAll(fd, content.data(), content.size()) && fsync(fd) == 0;
+    ::close(fd);
+    if (!written || rename(temp.c_str(), target.c_str()) == -1) {
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string encodeRecord(std::string_view command, std::string_view cwd, std::string_view hostname,
+                         int64_t startTime, uint64_t sessionId, uint32_t durationMs, int32_t exitStatus) {
+    cwd = cwd.substr(0, UINT16_MAX);
+    hostname = hostname.substr(0, UINT16_MAX);
+
+    RecordHeader header = {};
+    header.commandLength = static_cast<uint32_t>(command.size());
+    header.startTime = startTime;
+    header.sessionId = sessionId;
+    header.durationMs = durationMs;
+    header.exitStatus = exitStatus;
+    header.cwdLength = static_cast<uint16_t>(cwd.size());
+    header.hostLength = static_cast<uint16_t>(hostname.size());
+    header.recordLength = static_cast<uint32_t>(
+        paddedLength(sizeof(header) + command.size() + cwd.size() + hostname.size()));
+
+    std::string record(header.recordLength, '\0');
+    char* p = &record[0];
+    std::memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    std::memcpy(p, command.data(), command.size());
+    p += command.size();
+    std::memcpy(p, cwd.data(), cwd.size());
+    p += cwd.size();
+    std::memcpy(p, hostname.data(), hostname.size());
+    return record;
+}
+
+} // namespace
+
+HistoryLog::HistoryLog()
+    : lockFd_(-1), logFd_(-1), idxFd_(-1), logId_(0),
+      logMap_(nullptr), logMapSize_(0), logSize_(0),
+      idxMap_(nullptr), idxMapSize_(0), count_(0), generation_(0), inconsistent_(false) {}
+
+HistoryLog::~HistoryLog() {
+    close();
+}
+
+bool HistoryLog::open(const std::string& basePath, const std::string& legacyTextFile) {
+    close();
+    basePath_ = basePath;
+
+    lockFd_ = ::open((basePath_ + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lockFd_ == -1 || flock(lockFd_, LOCK_EX) == -1) {
+        close();
+        return false;
+    }
+
+    bool ok = openLocked(legacyTextFile);
+    flock(lockFd_, LOCK_UN);
+    if (!ok) {
+        close();
+    }
+    return ok;
+}
+
+void HistoryLog::close() {
+    if (logMap_) {
+        munmap(logMap_, logMapSize_);
+    }
+    if (idxMap_) {
+        munmap(const_cast<uint64_t*>(idxMap_), idxMapSize_);
+    }
+    for (int* fd : {&logFd_, &idxFd_, &lockFd_}) {
+        if (*fd != -1) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+    logMap_ = nullptr;
+    idxMap_ = nullptr;
+    logMapSize_ = idxMapSize_ = logSize_ = count_ = 0;
+    logId_ = 0;
+    inconsistent_ = false;
+}
+
+bool HistoryLog::openLocked(const std::string& legacyTextFile) {
+    ++generation_;
+    logFd_ = ::open((basePath_ + ".db").c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    idxFd_ = ::open((basePath_ + ".idx").c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (logFd_ == -1 || idxFd_ == -1) {
+        return false;
+    }
+
+    if (!readHeader(logFd_, kLogMagic, logId_)) {
+        // 新日志（或无法识别的文件）：重新创建，并导入旧的文本历史
+        logId_ = newLogId();
+        std::string header = makeHeader(kLogMagic, logId_);
+        if (ftruncate(logFd_, 0) == -1 || !writeAll(logFd_, header.data(), header.size())) {
+            return false;
+        }
+        if (!legacyTextFile.empty()) {
+            importText(legacyTextFile);
+        }
+    }
+
+    uint64_t idxId = 0;
+    if (!readHeader(idxFd_, kIdxMagic, idxId) || idxId != logId_) {
+        // 索引缺失或属于另一个日志（压缩中途崩溃）：扫描日志重建
+        if (!rebuildIndex()) {
+            return false;
+        }
+    }
+
+    if (!refresh()) {
+        return false;
+    }
+    if (!indexLooksValid() && (!rebuildIndex() || !refresh())) {
+        return false;
+    }
+    return recoverTail();
+}
+
+bool HistoryLog::indexLooksValid() const {
+    // 只检查与记录数无关的部分：索引长度是整数个偏移，第一条和最后一条指向完整的记录。
+    // 中间损坏的偏移在读取时发现（见offsetAt），之后sync()重建
+    struct stat st;
+    if (fstat(idxFd_, &st) == -1 || (static_cast<size_t>(st.st_size) - kHeaderSize) % sizeof(uint64_t) != 0) {
+        return false;
+    }
+    return count_ == 0 || (idxMap_[2] == kHeaderSize && validRecord(logMap_, logSize_, idxMap_[2 + count_ - 1]));
+}
+
+bool HistoryLog::rebuildIndex() {
+    struct stat st;
+    if (fstat(logFd_, &st) == -1) {
+        return false;
+    }
+
+    std::vector<char> data(static_cast<size_t>(st.st_size));
+    if (!data.empty() && pread(logFd_, data.data(), data.size(), 0) != static_cast<ssize_t>(data.size())) {
+        return false;
+    }
+
+    std::string index = makeHeader(kIdxMagic, logId_);
+    size_t offset = kHeaderSize;
+    while (validRecord(data.data(), data.size(), offset)) {
+        uint64_t value = offset;
+        index.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        RecordHeader header;
+        std::memcpy(&header, data.data() + offset, sizeof(header));
+        offset += header.recordLength;
+    }
+
+    // 不能原地截断：其他会话映射着旧的索引，访问截断后的页会收到SIGBUS。
+    // 写新文件后rename，其他会话通过replaced()发现并重新打开
+    std::string path = basePath_ + ".idx";
+    if (!replaceFile(path, index)) {
+        return false;
+    }
+    int fd = ::open(path.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    if (idxMap_) {
+        munmap(const_cast<uint64_t*>(idxMap_), idxMapSize_);
+        idxMap_ = nullptr;
+        idxMapSize_ = 0;
+        count_ = 0;
+    }
+    ::close(idxFd_);
+    idxFd_ = fd;
+    return true;
+}
+
+bool HistoryLog::recoverTail() {
+    // 日志写入后、索引写入前崩溃：补齐索引；半条记录：截掉
+    // （openLocked已经确认最后一条偏移指向完整的记录）
+    size_t offset = kHeaderSize;
+    if (count_ > 0) {
+        RecordHeader last;
+        std::memcpy(&last, logMap_ + idxMap_[2 + count_ - 1], sizeof(last));
+        offset = idxMap_[2 + count_ - 1] + last.recordLength;
+    }
+    if (offset >= logSize_) {
+        return true;
+    }
+
+    std::string entries;
+    while (validRecord(logMap_, logSize_, offset)) {
+        uint64_t value = offset;
+        entries.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        RecordHeader header;
+        std::memcpy(&header, logMap_ + offset, sizeof(header));
+        offset += header.recordLength;
+    }
+
+    if (offset < logSize_ && ftruncate(logFd_, offset) == -1) {
+        return false;
+    }
+    if (!entries.empty() && !writeAll(idxFd_, entries.data(), entries.size())) {
+        return false;
+    }
+    return refresh();
+}
+
+void HistoryLog::importText(const std::string& textFile) {
+    int fd = ::open(textFile.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return;
+    }
+
+    std::string text;
+    char chunk[65536];
+    ssize_t n;
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+        text.append(chunk, n);
+    }
+    ::close(fd);
+
+    std::string records;
+    size_t start = 0;
+    size_t newline;
+    while ((newline = text.find('\n', start)) != std::string::npos) {
+        if (newline > start) {
+            std::string_view line(text.data() + start, newline - start);
+            records += encodeRecord(line, "", "", 0, 0, 0, -1);
+        }
+        start = newline + 1;
+    }
+    writeAll(logFd_, records.data(), records.size());
+}
+
+bool HistoryLog::refresh() {
+    // 先读索引大小再读日志大小：写入方总是先写日志再写索引，索引中的记录一定已完整
+    struct stat logStat, idxStat;
+    if (fstat(idxFd_, &idxStat) == -1 || fstat(logFd_, &logStat) == -1) {
+        return false;
+    }
+
+    size_t logSize = static_cast<size_t>(logStat.st_size);
+    size_t idxSize = static_cast<size_t>(idxStat.st_size);
+    void* logMap = logMap_;
+    void* idxMap = const_cast<uint64_t*>(idxMap_);
+    if (!remap(logFd_, logMap, logMapSize_, std::max(logSize, kMinLogMap), PROT_READ | PROT_WRITE) ||
+        !remap(idxFd_, idxMap, idxMapSize_, std::max(idxSize, kMinIdxMap), PROT_READ)) {
+        return false;
+    }
+    logMap_ = static_cast<char*>(logMap);
+    idxMap_ = static_cast<const uint64_t*>(idxMap);
+
+    logSize_ = logSize;
+    count_ = idxSize > kHeaderSize ? (idxSize - kHeaderSize) / sizeof(uint64_t) : 0;
+    return true;
+}
+
+bool HistoryLog::remap(int fd, void*& map, size_t& mapSize, size_t needed, int prot) {
+    if (map && needed <= mapSize) {
+        return true;
+    }
+
+    // 预留两倍空间，文件继续增长时不必频繁重新映射；超出文件末尾的页不会被访问
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t size = ((needed * 2 + page - 1) / page) * page;
+    void* mapped = mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    if (map) {
+        munmap(map, mapSize);
+    }
+    map = mapped;
+    mapSize = size;
+    return true;
+}
+
+bool HistoryLog::replaced() const {
+    // 压缩替换两个文件，重建索引只替换索引文件
+    struct stat current, opened;
+    for (auto file : {std::make_pair(".db", logFd_), std::make_pair(".idx", idxFd_)}) {
+        if (stat((basePath_ + file.first).c_str(), &current) == -1 || fstat(file.second, &opened) == -1 ||
+            current.st_ino != opened.st_ino || current.st_dev != opened.st_dev) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t HistoryLog::offsetAt(size_t index) const {
+    // 索引中的偏移来自文件，使用前确认它指向映射范围内的完整记录，
+    // 否则越界读取或访问文件末尾之后的页（SIGBUS）
+    uint64_t offset = index < count_ ? idxMap_[2 + index] : SIZE_MAX;
+    if (offset >= logSize_ || !validRecord(logMap_, logSize_, static_cast<size_t>(offset))) {
+        inconsistent_ = true;
+        return SIZE_MAX;
+    }
+    return static_cast<size_t>(offset);
+}
+
+HistoryRecord HistoryLog::record(size_t index) const {
+    size_t offset = offsetAt(index);
+    if (offset == SIZE_MAX) {
+        return HistoryRecord{{}, {}, {}, 0, 0, 0, -1};
+    }
+    const char* p = logMap_ + offset;
+    RecordHeader header;
+    std::memcpy(&header, p, sizeof(header));
+    p += sizeof(header);
+
+    HistoryRecord record;
+    record.command = std::string_view(p, header.commandLength);
+    record.cwd = std::string_view(p + header.commandLength, header.cwdLength);
+    record.hostname = std::string_view(p + header.commandLength + header.cwdLength, header.hostLength);
+    record.startTime = header.startTime;
+    record.sessionId = header.sessionId;
+    record.durationMs = header.durationMs;
+    record.exitStatus = header.exitStatus;
+    return record;
+}
+
+std::string_view HistoryLog::command(size_t index) const {
+    size_t offset = offsetAt(index);
+    if (offset == SIZE_MAX) {
+        return {};
+    }
+    const char* p = logMap_ + offset;
+    uint32_t length;
+    std::memcpy(&length, p + offsetof(RecordHeader, commandLength), sizeof(length));
+    return std::string_view(p + sizeof(RecordHeader), length);
+}
+
+size_t HistoryLog::append(std::string_view command, std::string_view cwd, std::string_view hostname,
+                          int64_t startTime, uint64_t sessionId) {
+    if (lockFd_ == -1 || flock(lockFd_, LOCK_EX) == -1) {
+        return SIZE_MAX;
+    }
+
+    // 等锁期间文件可能已被压缩替换
+    if (replaced()) {
+        std::string basePath = basePath_;
+        int lockFd = lockFd_;
+        lockFd_ = -1; // 保留锁文件描述符，继续持有锁
+        close();
+        basePath_ = basePath;
+        lockFd_ = lockFd;
+        if (!openLocked("")) {
+            flock(lockFd_, LOCK_UN);
+            return SIZE_MAX;
+        }
+    }
+
+    size_t index = SIZE_MAX;
+    struct stat st;
+    if (fstat(logFd_, &st) == 0) {
+        uint64_t offset = static_cast<uint64_t>(st.st_size);
+        std::string record = encodeRecord(command, cwd, hostname, startTime, sessionId, 0, -1);
+        if (writeAll(logFd_, record.data(), record.size()) &&
+            writeAll(idxFd_, &offset, sizeof(offset)) && refresh()) {
+            index = count_ - 1;
+        }
+    }
+
+    flock(lockFd_, LOCK_UN);
+    return index;
+}
+
+void HistoryLog::finish(size_t index, uint32_t durationMs, int32_t exitStatus) {
+    size_t offset = offsetAt(index);
+    if (offset == SIZE_MAX) {
+        return;
+    }
+
+    // 字段是定长的，直接写入共享映射，其他会话立即可见
+    char* p = logMap_ + offset;
+    std::memcpy(p + offsetof(RecordHeader, durationMs), &durationMs, sizeof(durationMs));
+    std::memcpy(p + offsetof(RecordHeader, exitStatus), &exitStatus, sizeof(exitStatus));
+}
+
+bool HistoryLog::sync() {
+    if (logFd_ == -1) {
+        return false;
+    }
+
+    if (replaced() || inconsistent_) {
+        // 压缩期间持有写锁，open()会等到两个文件都替换完成；
+        // 读取时发现索引损坏的，重新打开时在锁内扫描日志重建索引
+        std::string basePath = basePath_;
+        bool rebuild = inconsistent_;
+        close();
+        basePath_ = basePath;
+        lockFd_ = ::open((basePath_ + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (lockFd_ == -1 || flock(lockFd_, LOCK_EX) == -1) {
+            close();
+            return true;
+        }
+        bool ok = openLocked("") && (!rebuild || (rebuildIndex() && refresh() && recoverTail()));
+        flock(lockFd_, LOCK_UN);
+        if (!ok) {
+            close();
+        }
+        return true;
+    }
+
+    refresh();
+    return false;
+}
+
+bool HistoryLog::compact(const std::string& basePath, size_t keep) {
+    int lockFd = ::open((basePath + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (lockFd == -1) {
+        return false;
+    }
+    if (flock(lockFd, LOCK_EX) == -1) {
+        ::close(lockFd);
+        return false;
+    }
+
+    bool ok = false;
+    {
+        HistoryLog source;
+        source.basePath_ = basePath;
+        source.lockFd_ = -1;
+        if (source.openLocked("")) {
+            uint64_t id = newLogId();
+            std::string log = makeHeader(kLogMagic, id);
+            std::string index = makeHeader(kIdxMagic, id);
+            size_t first = source.count_ > keep ? source.count_ - keep : 0;
+            for (size_t i = first; i < source.count_; ++i) {
+                size_t from = source.offsetAt(i);
+                if (from == SIZE_MAX) {
+                    continue; // 损坏的索引项
+                }
+                const char* p = source.logMap_ + from;
+                RecordHeader header;
+                std::memcpy(&header, p, sizeof(header));
+                uint64_t offset = log.size();
+                index.append(reinterpret_cast<const char*>(&offset), sizeof(offset));
+                log.append(p, header.recordLength);
+            }
+
+            // 先替换日志再替换索引；读者发现logId不一致时会在锁上等待并重新打开
+            ok = replaceFile(basePath + ".db", log) && replaceFile(basePath + ".idx", index);
+        }
+    }
+
+    flock(lockFd, LOCK_UN);
+    ::close(lockFd);
+    return ok;
+}
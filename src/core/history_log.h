@@ -0,0 +1,105 @@
+#ifndef HISTORY_LOG_H
+#define HISTORY_LOG_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// 一条历史记录（字符串直接指向映射的文件内容，下一次append/sync后失效）
+struct HistoryRecord {
+    std::string_view command;
+    std::string_view cwd;
+    std::string_view hostname;
+    int64_t startTime;      // Unix时间（秒），导入的旧历史为0
+    uint64_t sessionId;
+    uint32_t durationMs;
+    int32_t exitStatus;     // -1 表示仍在运行或未知
+};
+
+// 二进制历史日志
+//
+//   <base>.db    16字节文件头 { "MYSHLOG1", logId }，之后是8字节对齐的变长记录
+//   <base>.idx   16字节文件头 { "MYSHIDX1", logId }，之后每条记录一个uint64偏移
+//   <base>.lock  所有写入和压缩都持有它的flock
+//
+// 两个文件都用MAP_SHARED映射，启动时只需映射、检查文件头和末尾，与记录数无关；
+// 其他会话追加的记录通过共享映射直接可见，sync()只需fstat索引文件。
+// 压缩写入新文件后rename，logId不同，读者发现后重新打开。
+// 索引中的偏移每次使用前都检查是否指向完整的记录，损坏或截断的索引在锁内扫描日志重建
+// （同样写新文件后rename，不截断其他会话正在映射的文件）。
+class HistoryLog {
+public:
+    HistoryLog();
+    ~HistoryLog();
+
+    HistoryLog(const HistoryLog&) = delete;
+    HistoryLog& operator=(const HistoryLog&) = delete;
+
+    // 打开（必要时创建）日志；legacyTextFile存在且日志为空时导入其中的旧历史
+    bool open(const std::string& basePath, const std::string& legacyTextFile = "");
+    void close();
+
+    // 记录总数
+    size_t size() const { return count_; }
+
+    HistoryRecord record(size_t index) const;
+    std::string_view command(size_t index) const;
+
+    // 追加一条记录，返回其序号；失败返回SIZE_MAX。
+    // 等锁期间文件被压缩替换时先重新打开（generation()改变，之前的序号失效）
+    size_t append(std::string_view command, std::string_view cwd, std::string_view hostname,
+                  int64_t startTime, uint64_t sessionId);
+
+    // 命令结束后原地写入耗时和退出码
+    void finish(size_t index, uint32_t durationMs, int32_t exitStatus);
+
+    // 读取其他会话追加的记录；文件被压缩替换或索引损坏需要重建时重新打开并返回true（之前的序号失效）
+    bool sync();
+
+    // 只保留最后keep条记录，写新文件后rename替换，可以在后台线程调用
+    static bool compact(const std::string& basePath, size_t keep);
+
+    // 文件头中的日志标识，压缩替换后改变
+    uint64_t id() const { return logId_; }
+
+    // 每次（重新）打开文件时加一；调用者据此判断基于旧序号的缓存是否失效
+    uint64_t generation() const { return generation_; }
+
+    // 映射的日志字节数（用于统计）
+    size_t bytes() const { return logSize_; }
+
+private:
+    std::string basePath_;
+    int lockFd_;
+    int logFd_;
+    int idxFd_;
+    uint64_t logId_;
+
+    char* logMap_;
+    size_t logMapSize_;
+    size_t logSize_;
+    const uint64_t* idxMap_;
+    size_t idxMapSize_;
+    size_t count_;
+    uint64_t generation_;
+    mutable bool inconsistent_;     // 读取时发现索引中有无效的偏移，下一次sync()重建
+
+    // 在持有写锁时打开/创建文件、修复崩溃留下的不一致
+    bool openLocked(const std::string& legacyTextFile);
+    bool rebuildIndex();
+    bool indexLooksValid() const;
+    bool recoverTail();
+    void importText(const std::string& textFile);
+
+    // 根据当前文件大小更新映射和计数
+    bool refresh();
+    bool replaced() const;
+
+    // 第index条记录在日志中的偏移；索引损坏（偏移越界或不是完整的记录）时返回SIZE_MAX
+    size_t offsetAt(size_t index) const;
+
+    static bool remap(int fd, void*& map, size_t& mapSize, size_t needed, int prot);
+};
+
+#endif // HISTORY_LOG_H
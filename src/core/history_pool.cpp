@@ -0,0 +1,78 @@
+#include "history_pool.h"
+#include <functional>
+
+namespace {
+
+constexpr size_t kInitialCapacity = 1024;
+
+} // namespace
+
+HistoryPool::HistoryPool() : mask_(0) {
+    clear();
+}
+
+void HistoryPool::clear() {
+    arena_.clear();
+    arena_.shrink_to_fit();
+    entries_.clear();
+    entries_.shrink_to_fit();
+    table_.assign(kInitialCapacity, kNone);
+    mask_ = kInitialCapacity - 1;
+}
+
+uint32_t HistoryPool::hashOf(std::string_view text) {
+    size_t hash = std::hash<std::string_view>()(text);
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+size_t HistoryPool::probe(std::string_view text, uint32_t hash) const {
+    size_t slot = hash & mask_;
+    while (table_[slot] != kNone) {
+        const Entry& entry = entries_[table_[slot]];
+        // 先比较哈希值，大部分不同的命令不用读文本
+        if (entry.hash == hash && this->text(table_[slot]) == text) {
+            break;
+        }
+        slot = (slot + 1) & mask_;
+    }
+    return slot;
+}
+
+uint32_t HistoryPool::find(std::string_view text) const {
+    return table_[probe(text, hashOf(text))];
+}
+
+uint32_t HistoryPool::intern(std::string_view text) {
+    uint32_t hash = hashOf(text);
+    size_t slot = probe(text, hash);
+    if (table_[slot] != kNone) {
+        return table_[slot];
+    }
+
+    uint32_t id = static_cast<uint32_t>(entries_.size());
+    entries_.push_back({static_cast<uint32_t>(arena_.size()), static_cast<uint32_t>(text.size()), hash});
+    arena_.append(text.data(), text.size());
+    table_[slot] = id;
+
+    // 负载因子保持在1/2以下
+    if (entries_.size() * 2 > table_.size()) {
+        rehash(table_.size() * 2);
+    }
+    return id;
+}
+
+void HistoryPool::rehash(size_t capacity) {
+    table_.assign(capacity, kNone);
+    mask_ = capacity - 1;
+    for (uint32_t id = 0; id < entries_.size(); ++id) {
+        size_t slot = entries_[id].hash & mask_;
+        while (table_[slot] != kNone) {
+            slot = (slot + 1) & mask_;
+        }
+        table_[slot] = id;
+    }
+}
+
+size_t HistoryPool::memoryUsage() const {
+    return arena_.capacity() + entries_.capacity() * sizeof(Entry) + table_.capacity() * sizeof(uint32_t);
+}
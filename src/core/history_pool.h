@@ -0,0 +1,63 @@
+#ifndef HISTORY_POOL_H
+#define HISTORY_POOL_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 历史命令的字符串驻留池
+//
+// 相同的命令只保存一次，所有文本首尾相接存放在一块连续的内存中，按编号访问。
+// 查重用开放寻址的哈希表，表中只存编号，比较时直接读池中的文本。
+// 返回的string_view在下一次intern()之后可能失效（内存重新分配），编号始终有效。
+class HistoryPool {
+public:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    HistoryPool();
+
+    // 返回命令的编号，第一次出现时加入池中
+    uint32_t intern(std::string_view text);
+
+    // 已存在时返回编号，否则返回kNone
+    uint32_t find(std::string_view text) const;
+
+    std::string_view text(uint32_t id) const {
+        return std::string_view(arena_.data() + entries_[id].offset, entries_[id].length);
+    }
+
+    // 所有文本所在的内存，offset(id)是命令在其中的位置
+    const char* data() const { return arena_.data(); }
+    uint32_t offset(uint32_t id) const { return entries_[id].offset; }
+
+    // 不同命令的个数
+    size_t size() const { return entries_.size(); }
+
+    // 占用的内存字节数（文本、编号表和哈希表）
+    size_t memoryUsage() const;
+
+    void clear();
+
+private:
+    struct Entry {
+        uint32_t offset;
+        uint32_t length;
+        uint32_t hash;
+    };
+
+    std::string arena_;
+    std::vector<Entry> entries_;
+    std::vector<uint32_t> table_;   // 大小为2的幂，空槽为kNone
+    size_t mask_;
+
+    static uint32_t hashOf(std::string_view text);
+
+    // 从hash对应的槽开始线性探测，返回命令所在或应插入的槽
+    size_t probe(std::string_view text, uint32_t hash) const;
+
+    void rehash(size_t capacity);
+};
+
+#endif // HISTORY_POOL_H
@@ -0,0 +1,141 @@
+#include "history_trie.h"
+#include <algorithm>
+
+HistoryTrie::HistoryTrie(const HistoryPool& pool) : pool_(pool), inserted_(0) {
+    clear();
+}
+
+void HistoryTrie::clear() {
+    nodes_.clear();
+    nodes_.push_back({0, 0, kNone, kNone, kNone, kNone});
+    inserted_ = 0;
+}
+
+void HistoryTrie::swap(HistoryTrie& other) {
+    nodes_.swap(other.nodes_);
+    std::swap(inserted_, other.inserted_);
+}
+
+uint32_t HistoryTrie::findChild(uint32_t node, char c, uint32_t* prev) const {
+    uint32_t before = kNone;
+    for (uint32_t child = nodes_[node].firstChild; child != kNone; child = nodes_[child].nextSibling) {
+        if (pool_.data()[nodes_[child].labelOffset] == c) {
+            if (prev) {
+                *prev = before;
+            }
+            return child;
+        }
+        before = child;
+    }
+    return kNone;
+}
+
+void HistoryTrie::insert(uint32_t id) {
+    ++inserted_;
+    std::string_view command = pool_.text(id);
+    if (command.empty()) {
+        return;
+    }
+
+    // 只沿路径走一遍：命令已存在时不需要改动结构，否则在分叉处拆分边或加叶子。
+    // 走过的节点记在path_中，最后统一把best改为这条命令
+    path_.clear();
+    path_.push_back(0);
+    uint32_t node = 0;
+    size_t pos = 0;
+    uint32_t child = kNone;
+    uint32_t prev = kNone;
+    size_t common = 0;
+    while (pos < command.size()) {
+        child = findChild(node, command[pos], &prev);
+        if (child == kNone) {
+            break;
+        }
+        std::string_view edge = label(nodes_[child]);
+        size_t limit = std::min(edge.size(), command.size() - pos);
+        common = 0;
+        while (common < limit && edge[common] == command[pos + common]) {
+            ++common;
+        }
+        if (common < edge.size()) {
+            break;
+        }
+        if (prev != kNone) {
+            // 最近用过的子节点移到链表头部，常用的前缀查找时少走几步
+            nodes_[prev].nextSibling = nodes_[child].nextSibling;
+            nodes_[child].nextSibling = nodes_[node].firstChild;
+            nodes_[node].firstChild = child;
+        }
+        node = child;
+        pos += common;
+        path_.push_back(node);
+    }
+
+    // 命令已经在树中时走到底正好是它的结尾节点
+    if (pos < command.size() || nodes_[node].entry == kNone) {
+        const uint32_t base = pool_.offset(id);
+
+        if (pos < command.size() && child != kNone) {
+            // 在公共前缀处拆分边：新节点接管原来的位置，原节点成为它的唯一子节点
+            uint32_t mid = static_cast<uint32_t>(nodes_.size());
+            Node split = {nodes_[child].labelOffset, static_cast<uint32_t>(common), child,
+                          nodes_[child].nextSibling, id, kNone};
+            nodes_.push_back(split);
+            nodes_[child].labelOffset += static_cast<uint32_t>(common);
+            nodes_[child].labelLength -= static_cast<uint32_t>(common);
+            nodes_[child].nextSibling = kNone;
+            if (prev == kNone) {
+                nodes_[node].firstChild = mid;
+            } else {
+                nodes_[prev].nextSibling = mid;
+            }
+            node = mid;
+            pos += common;
+            path_.push_back(node);
+        }
+
+        if (pos < command.size()) {
+            // 剩余部分作为新的叶子
+            uint32_t leaf = static_cast<uint32_t>(nodes_.size());
+            nodes_.push_back({static_cast<uint32_t>(base + pos), static_cast<uint32_t>(command.size() - pos),
+                              kNone, nodes_[node].firstChild, id, id});
+            nodes_[node].firstChild = leaf;
+        } else {
+            nodes_[node].entry = id;
+        }
+    }
+
+    for (uint32_t visited : path_) {
+        nodes_[visited].best = id;
+    }
+}
+
+std::string_view HistoryTrie::suggest(std::string_view prefix) const {
+    if (prefix.empty()) {
+        return {};
+    }
+
+    uint32_t node = 0;
+    size_t pos = 0;
+    while (pos < prefix.size()) {
+        uint32_t child = findChild(node, prefix[pos]);
+        if (child == kNone) {
+            return {};
+        }
+        std::string_view edge = label(nodes_[child]);
+        size_t remaining = prefix.size() - pos;
+        if (remaining <= edge.size()) {
+            // 前缀在这条边上结束：整棵子树都以prefix开头
+            if (edge.compare(0, remaining, prefix.substr(pos)) != 0) {
+                return {};
+            }
+            return best(nodes_[child]);
+        }
+        if (prefix.compare(pos, edge.size(), edge) != 0) {
+            return {};
+        }
+        node = child;
+        pos += edge.size();
+    }
+    return best(nodes_[node]);
+}
@@ -0,0 +1,65 @@
+#ifndef HISTORY_TRIE_H
+#define HISTORY_TRIE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "history_pool.h"
+
+// 历史命令的压缩前缀树（用于行内自动建议）
+//
+// 命令文本保存在HistoryPool中，边上的标签是某条命令文本的一段，只记录偏移和长度。
+// 每个节点记录子树中最近使用的命令，查找前缀只需沿边走到底，与历史条数无关。
+// 新命令总是最近的，插入时把路径上所有节点的best改为它即可。
+class HistoryTrie {
+public:
+    explicit HistoryTrie(const HistoryPool& pool);
+
+    // 按时间顺序插入池中的命令（已存在的命令变为最近使用）
+    void insert(uint32_t command);
+
+    // 以prefix开头的最近使用的命令；没有时返回空
+    std::string_view suggest(std::string_view prefix) const;
+
+    void clear();
+
+    // 交换两棵树的节点；各自的池中内容也必须一起交换（节点只记录池中的偏移和编号）
+    void swap(HistoryTrie& other);
+
+    // 已插入的历史记录数（包括重复的命令）
+    size_t inserted() const { return inserted_; }
+
+    // 节点占用的内存字节数（不含池中的文本）
+    size_t memoryUsage() const { return nodes_.capacity() * sizeof(Node); }
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Node {
+        uint32_t labelOffset;   // 边标签在池中的位置
+        uint32_t labelLength;
+        uint32_t firstChild;
+        uint32_t nextSibling;
+        uint32_t best;          // 子树中最近使用的命令
+        uint32_t entry;         // 恰好在此结束的命令
+    };
+
+    const HistoryPool& pool_;
+    std::vector<Node> nodes_;
+    size_t inserted_;
+    std::vector<uint32_t> path_;    // insert走过的节点，复用以避免分配
+
+    std::string_view label(const Node& node) const {
+        return std::string_view(pool_.data() + node.labelOffset, node.labelLength);
+    }
+    std::string_view best(const Node& node) const {
+        return node.best == kNone ? std::string_view() : pool_.text(node.best);
+    }
+
+    // 查找第一个字符为c的子节点，prev返回它在兄弟链表中的前一个节点
+    uint32_t findChild(uint32_t node, char c, uint32_t* prev = nullptr) const;
+};
+
+#endif // HISTORY_TRIE_H
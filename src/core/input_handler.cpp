@@ -2,11 +2,25 @@
 #include "shell.h"
 #include "completion.h"
 #include "syntax_highlighter.h"
+#include "history.h"
+#include "fuzzy_finder.h"
+#include "line_editor.h"
+#include "platform.h"
 #include <iostream>
 #include <algorithm>
+#include <cstring>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
 
 // 检查readline是否可用
 #ifdef HAVE_READLINE
+// 让readline.h声明带参数的rl_message
+#define USE_VARARGS
+#define PREFER_STDARG
 #include <readline/readline.h>
 #include <readline/history.h>
 #define USE_READLINE 1
@@ -14,22 +28,81 @@
 #define USE_READLINE 0
 #endif
 
+namespace {
+
+// Tab补全等待后台结果的期限：到期后要求补全器返回已有的部分结果，
+// 再等这么久还没有返回（卡在文件系统调用里）就放弃
+constexpr int kCompletionDeadlineMs = 150;
+constexpr int kCompletionGraceMs = 50;
+
+// 一次后台补全：补全线程写结果，readline线程等待；放弃等待后补全线程仍可安全地写完
+struct CompletionRequest {
+    std::string line;
+    std::vector<Token> tokens;
+    int start = 0;
+    int end = 0;
+    std::shared_ptr<const CompletionEnvironment> environment; // 主线程取得的当前目录、PATH和环境
+    std::vector<std::string> completions;
+    std::string common;
+    std::atomic<bool> stop{false};
+    std::atomic<bool> done{false};
+    int wake[2] = {-1, -1};     // 补全完成时写入一个字节
+
+    ~CompletionRequest() {
+        for (int fd : wake) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+    }
+};
+
+// 补全时分词的字符（和readline的设置相同）
+const char* const kWordBreakCharacters = " \t\n\"\\'`@$><=;|&{(";
+
+int remainingMs(std::chrono::steady_clock::time_point deadline) {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now()).count();
+    return remaining > 0 ? static_cast<int>(remaining) : 0;
+}
+
+} // namespace
+
 // 静态实例指针
 InputHandler* InputHandler::instance_ = nullptr;
+size_t InputHandler::history_offset_ = 0;
+std::string InputHandler::saved_line_;
+bool InputHandler::readline_history_loaded_ = false;
+std::pair<int (*)(int, int), int (*)(int, int)> InputHandler::last_wrapped_command_;
+std::string InputHandler::next_entry_;
+size_t InputHandler::next_offset_ = 0;
+std::string InputHandler::suggestion_;
+size_t InputHandler::suggestion_shown_ = 0;
+bool InputHandler::terminal_ = false;
+bool InputHandler::live_ = false;
+bool InputHandler::drawing_ = false;
+bool InputHandler::discard_ = false;
+bool InputHandler::foreign_ = false;
+LineRenderer InputHandler::renderer_;
+std::string InputHandler::lexed_line_;
+std::vector<Token> InputHandler::tokens_;
+std::vector<HighlightSpan> InputHandler::spans_;
+std::vector<SyntaxType> InputHandler::types_;
+int InputHandler::refresh_[2] = {-1, -1};
 
 InputHandler::InputHandler(Shell* shell) 
-    : shell_(shell), initialized_(false), completion_enabled_(true), use_readline_(false) {
+    : shell_(shell), color_depth_(ColorDepth::BASIC), initialized_(false), completion_enabled_(true),
+      use_readline_(false), autosuggest_enabled_(true) {
     
     // 重新启用CompletionEngine
-    completion_engine_ = std::make_unique<CompletionEngine>(shell);
+    completion_engine_ = std::make_shared<CompletionEngine>(shell);
     syntax_highlighter_ = std::make_unique<SyntaxHighlighter>();
     
-    // 设置内置命令给语法高亮器
-    std::set<std::string> builtin_commands = {
-        "help", "exit", "pwd", "cd", "echo", "export", 
-        "env", "unset", "history", "clear", "which", "set"
-    };
-    syntax_highlighter_->setBuiltinCommands(builtin_commands);
+    // 设置内置命令给语法高亮器（与补全一样取自BuiltinCommands，不另外维护列表）
+    std::vector<std::string> builtin_commands = shell->getBuiltinCommandNames();
+    syntax_highlighter_->setBuiltinCommands(std::set<std::string>(builtin_commands.begin(), builtin_commands.end()));
+    syntax_highlighter_->setCommandLookup([this](std::string_view name) { return findCommand(name); });
+    syntax_highlighter_->setPathLookup([this](std::string_view word) { return findPath(word); });
     
     instance_ = this;
 }
@@ -46,7 +119,33 @@ bool InputHandler::initialize() {
     
     use_readline_ = checkReadlineAvailability();
     
-    if (use_readline_) {
+    // 没有readline时终端上使用内置的行编辑器；有readline时MYSH_LINE_EDITOR=native选用它
+    const char* editor = getenv("MYSH_LINE_EDITOR");
+    bool native = LineEditor::available() && (!use_readline_ || (editor && strcmp(editor, "native") == 0));
+    
+    // 终端的颜色能力只在启动时检测一次；设置了NO_COLOR或终端不支持颜色时不高亮。
+    // 主题文件为MYSH_THEME，默认~/.mysh_theme（不存在时使用内置配色）
+    color_depth_ = detectColorDepth();
+    if (color_depth_ == ColorDepth::NONE) {
+        syntax_highlighter_->setEnabled(false);
+        Theme().apply(*syntax_highlighter_, color_depth_);
+    } else {
+        const char* theme = getenv("MYSH_THEME");
+        const char* home = getenv("HOME");
+        std::string path = theme ? theme : "";
+        if (path.empty() && home && access((std::string(home) + "/.mysh_theme").c_str(), F_OK) == 0) {
+            path = std::string(home) + "/.mysh_theme";
+        }
+        std::string error;
+        if (!path.empty() && !loadTheme(path, error)) {
+            std::cerr << "mysh: theme: " << error << std::endl;
+        }
+    }
+    
+    if (native) {
+        initialize_native();
+        std::cout << "Using built-in line editor" << std::endl;
+    } else if (use_readline_) {
 #if USE_READLINE
         initialize_readline();
         std::cout << "Using GNU Readline for enhanced input features" << std::endl;
@@ -60,9 +159,36 @@ bool InputHandler::initialize() {
 }
 
 std::string InputHandler::readLine(const std::string& prompt) {
+    // 上一条命令可能创建或删除了文件：已有的结果在用到时重新检查
+    paths_.setDirectory(shell_->getCurrentDirectory());
+    paths_.expire();
+    
+    if (editor_) {
+        if (completion_engine_) {
+            completion_engine_->refresh();
+        }
+        lexed_line_.clear();
+        tokens_.clear();
+        spans_.clear();
+        return editor_->readLine(prompt);
+    }
+    
     if (use_readline_) {
 #if USE_READLINE
+        // 第一次显示提示符时开始在后台建立PATH命令索引，之后PATH变化时重新扫描
+        if (completion_engine_) {
+            completion_engine_->refresh();
+        }
+        history_offset_ = 0;
+        suggestion_.clear();
+        suggestion_shown_ = 0;
+        renderer_.invalidate();
+        lexed_line_.clear();
+        tokens_.clear();
+        spans_.clear();
+        rl_startup_hook = next_entry_.empty() ? nullptr : show_next_entry;
         char* line = readline(prompt.c_str());
+        release_readline_history();
         if (line == nullptr) {
             return ""; // EOF
         }
@@ -70,9 +196,6 @@ std::string InputHandler::readLine(const std::string& prompt) {
         std::string result(line);
         free(line);
         
-        // 如果启用语法高亮，在这里可以处理实时高亮
-        // 注意：readline本身不支持实时语法高亮，这需要更复杂的实现
-        
         return result;
 #endif
     }
@@ -90,16 +213,15 @@ bool InputHandler::isSyntaxHighlightEnabled() const {
     return syntax_highlighter_ && syntax_highlighter_->isEnabled();
 }
 
-void InputHandler::addHistory(const std::string& line) {
-    if (line.empty()) {
-        return;
-    }
-    
-    if (use_readline_) {
-#if USE_READLINE
-        add_history(line.c_str());
-#endif
+bool InputHandler::loadTheme(const std::string& path, std::string& error) {
+    Theme theme;
+    if (!path.empty() && !theme.load(path, error)) {
+        return false;
     }
+    // 控制序列在这里一次生成，之后高亮时只是查表
+    theme.apply(*syntax_highlighter_, color_depth_);
+    theme_path_ = path;
+    return true;
 }
 
 void InputHandler::cleanup() {
@@ -123,6 +245,192 @@ std::string InputHandler::readLineSimple(const std::string& prompt) {
     return input;
 }
 
+Existence InputHandler::findCommand(std::string_view name) {
+    std::string command = Lexer::unquote(name);
+    if (command.find('/') != std::string::npos) {
+        switch (paths_.lookup(name)) {
+            case PathCache::State::UNKNOWN: return Existence::UNKNOWN;
+            case PathCache::State::EXECUTABLE: return Existence::EXISTS;
+            default: return Existence::MISSING;
+        }
+    }
+    if (shell_->isBuiltinCommand(command)) {
+        return Existence::EXISTS;
+    }
+    
+    // PATH还没扫描完时不知道
+    CommandIndex& index = completion_engine_->getSystemCommands();
+    if (!index.ready()) {
+        return Existence::UNKNOWN;
+    }
+    CommandIndex::Snapshot commands = index.snapshot();
+    return std::binary_search(commands->begin(), commands->end(), command) ? Existence::EXISTS : Existence::MISSING;
+}
+
+Existence InputHandler::findPath(std::string_view word) {
+    switch (paths_.lookup(word)) {
+        case PathCache::State::UNKNOWN: return Existence::UNKNOWN;
+        case PathCache::State::MISSING: return Existence::MISSING;
+        default: return Existence::EXISTS;
+    }
+}
+
+// 在后台线程执行补全并等待结果：到期限时要求补全器返回部分结果，
+// 等待期间用户按了键就取消（按键放进typed，由调用者放回输入）；连按的Tab（repeat）不取消，
+// 否则第二次Tab列出候选的行为会被打断。取消或放弃时返回false
+bool InputHandler::complete_in_background(const std::string& line, int start, int end, int input, int repeat,
+                                          std::string& typed, std::vector<std::string>& completions,
+                                          std::string& common) {
+    auto request = std::make_shared<CompletionRequest>();
+    request->line = line;
+    request->tokens = request->line == lexed_line_ ? tokens_ : Lexer::tokenize(request->line);
+    request->start = start;
+    request->end = end;
+    request->environment = instance_->completion_engine_->snapshotEnvironment();
+    
+    if (pipe(request->wake) == -1) {
+        // 无法等待后台结果，直接在当前线程补全
+        completions = instance_->completion_engine_->getCompletions(request->line, request->tokens, start, end,
+                                                                    &common);
+        return true;
+    }
+    fcntl(request->wake[1], F_SETFL, fcntl(request->wake[1], F_GETFL) | O_NONBLOCK);
+    
+    // 任务按顺序执行：排在卡住的补全后面、开始前已被放弃的请求直接跳过。
+    // 任务持有补全引擎的引用，卡过InputHandler析构的任务返回时引擎仍然有效
+    std::shared_ptr<CompletionEngine> engine = instance_->completion_engine_;
+    instance_->background_.post([request, engine]() {
+        if (!request->stop.load()) {
+            request->completions = engine->getCompletions(request->line, request->tokens, request->start,
+                                                          request->end, &request->common, &request->stop,
+                                                          request->environment);
+        }
+        request->done.store(true, std::memory_order_release);
+        char byte = 0;
+        ssize_t written = write(request->wake[1], &byte, 1);
+        (void)written;
+    });
+    
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kCompletionDeadlineMs);
+    bool stopping = false;
+    bool watch_input = true;
+    while (!request->done.load(std::memory_order_acquire)) {
+        int timeout = remainingMs(deadline);
+        if (timeout == 0) {
+            if (stopping) {
+                return false;
+            }
+            // 到期：要求返回已有的结果
+            request->stop.store(true);
+            stopping = true;
+            deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kCompletionGraceMs);
+            continue;
+        }
+        
+        struct pollfd fds[2] = {{request->wake[0], POLLIN, 0}, {input, POLLIN, 0}};
+        if (poll(fds, watch_input ? 2 : 1, timeout) < 0 && errno != EINTR) {
+            return false;
+        }
+        if (watch_input && (fds[1].revents & POLLIN) && !request->done.load(std::memory_order_acquire)) {
+            unsigned char key;
+            if (read(fds[1].fd, &key, 1) == 1) {
+                typed += static_cast<char>(key);
+                if (key == repeat) {
+                    watch_input = false;
+                    continue;
+                }
+            }
+            request->stop.store(true);
+            return false;
+        }
+    }
+    
+    completions = std::move(request->completions);
+    common = std::move(request->common);
+    return true;
+}
+
+void InputHandler::analyze(const std::string& line, SyntaxHighlighter& highlighter) {
+    // 只重新分析被编辑的词，只更新它之后的字节的类型；分词结果也供Tab补全使用
+    LexChange change = Lexer::update(lexed_line_, line, tokens_);
+    lexed_line_ = line;
+    size_t from = std::min(highlighter.update(line, tokens_, change, spans_), line.size());
+    types_.resize(line.size());
+    std::fill(types_.begin() + from, types_.end(), SyntaxType::NORMAL);
+    auto span = std::lower_bound(spans_.begin(), spans_.end(), from,
+                                 [](const HighlightSpan& span, size_t pos) { return span.end <= pos; });
+    for (; span != spans_.end(); ++span) {
+        std::fill(types_.begin() + std::max(span->start, from), types_.begin() + span->end, span->type);
+    }
+}
+
+void InputHandler::request_refresh() {
+    char byte = 0;
+    ssize_t written = write(refresh_[1], &byte, 1);
+    (void)written; // 管道满时已经有未处理的通知
+}
+
+bool InputHandler::watch_caches() {
+    if (!instance_ || pipe(refresh_) != 0) {
+        return false;
+    }
+    for (int fd : refresh_) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    instance_->completion_engine_->getSystemCommands().setListener(request_refresh);
+    instance_->paths_.setListener(request_refresh);
+    return true;
+}
+
+void InputHandler::initialize_native() {
+    LineEditor::Callbacks callbacks;
+    callbacks.highlight = [this](const std::string& line, std::vector<SyntaxType>& types) {
+        if (syntax_highlighter_->isEnabled()) {
+            analyze(line, *syntax_highlighter_);
+            types.assign(types_.begin(), types_.end());
+        }
+    };
+    callbacks.suggest = [this](const std::string& line) {
+        History* history = shell_->getHistory();
+        if (!history || !autosuggest_enabled_) {
+            return std::string();
+        }
+        std::string command = history->suggest(line);
+        return command.size() > line.size() ? command.substr(line.size()) : std::string();
+    };
+    callbacks.history = [this](size_t offset, std::string& command) {
+        History* history = shell_->getHistory();
+        if (!history || offset > history->size()) {
+            return false;
+        }
+        command = std::string(history->getCommand(history->size() - offset));
+        return true;
+    };
+    callbacks.complete = [this](const std::string& line, size_t point, size_t& start, std::string& common,
+                                std::vector<std::string>& candidates, std::string& typed) {
+        if (!completion_enabled_) {
+            return false;
+        }
+        start = point;
+        while (start > 0 && !strchr(kWordBreakCharacters, line[start - 1])) {
+            --start;
+        }
+        return complete_in_background(line, static_cast<int>(start), static_cast<int>(point), STDIN_FILENO, '\t',
+                                      typed, candidates, common);
+    };
+    // 命令索引和路径缓存在后台得到新结果后，整行重新分析再重画
+    if (watch_caches()) {
+        callbacks.refresh = refresh_[0];
+        callbacks.refreshed = []() {
+            lexed_line_.clear();
+            tokens_.clear();
+            spans_.clear();
+        };
+    }
+    editor_ = std::make_unique<LineEditor>(*syntax_highlighter_, std::move(callbacks));
+}
+
 bool InputHandler::checkReadlineAvailability() {
 #if USE_READLINE
     return true;
@@ -132,74 +440,745 @@ bool InputHandler::checkReadlineAvailability() {
 }
 
 #if USE_READLINE
+namespace {
+
+// 显示宽度（按UTF-8字符计），跳过提示符中\001...\002包围的不可见部分
+size_t displayWidth(const char* text, size_t length) {
+    size_t width = 0;
+    bool invisible = false;
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == RL_PROMPT_START_IGNORE) {
+            invisible = true;
+        } else if (c == RL_PROMPT_END_IGNORE) {
+            invisible = false;
+        } else if (!invisible && (c & 0xC0) != 0x80) {
+            ++width;
+        }
+    }
+    return width;
+}
+
+// 等待后续字节，用于区分单独的ESC和方向键序列
+bool inputPending(int timeoutMs) {
+    struct pollfd pfd = {fileno(rl_instream), POLLIN, 0};
+    return poll(&pfd, 1, timeoutMs) > 0;
+}
+
+// 一行查找结果：截断到终端宽度，匹配的字符加粗显示
+std::string formatResult(std::string_view command, const std::vector<size_t>& positions,
+                         bool selected, size_t width) {
+    std::string line = selected ? "\033[7m> " : "  ";
+    size_t column = 2;
+    size_t next = 0;
+    bool highlighted = false;
+    for (size_t i = 0; i < command.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(command[i]);
+        bool lead = (c & 0xC0) != 0x80;
+        if (lead && ++column > width) {
+            break;
+        }
+        // 相邻的匹配字符合并为一段
+        bool matched = next < positions.size() && positions[next] == i;
+        if (matched) {
+            ++next;
+        }
+        if (matched != highlighted && lead) {
+            line += matched ? "\033[1;33m" : "\033[22;39m";
+            highlighted = matched;
+        }
+        line += (c == '\t' || c == '\n') ? ' ' : static_cast<char>(c);
+    }
+    if (highlighted) {
+        line += "\033[22;39m";
+    }
+    if (selected) {
+        line += "\033[27m";
+    }
+    return line;
+}
+
+} // namespace
+
+int InputHandler::fuzzy_history_search(int count, int key) {
+    History* history = instance_ ? instance_->shell_->getHistory() : nullptr;
+    int screenRows = 0;
+    int screenCols = 0;
+    rl_get_screen_size(&screenRows, &screenCols);
+    if (!history || history->size() == 0 || screenRows < 4 || screenCols < 20 || !terminal_) {
+        return incremental_history_search(count, key);
+    }
+
+    // 查询行加结果行，位于输入行下方
+    const size_t visible = std::min(10, screenRows - 3);
+    const size_t lines = visible + 1;
+    const size_t width = static_cast<size_t>(screenCols) - 1;
+    const std::string label = "history> ";
+
+    HistoryFinder finder(*history);
+    std::string query(rl_line_buffer, rl_end);
+    std::string chosen = query;
+    size_t selected = 0;
+    bool queryChanged = true;
+
+    // 光标移到输入末尾，向下预留界面所需的行（底部时终端会滚动）
+    rl_point = rl_end;
+    rl_redisplay();
+    size_t promptWidth = displayWidth(rl_prompt ? rl_prompt : "", rl_prompt ? strlen(rl_prompt) : 0);
+    size_t inputRows = (promptWidth + displayWidth(rl_line_buffer, rl_end)) / screenCols + 1;
+
+    std::string out;
+    for (size_t i = 0; i < lines; ++i) {
+        out += "\r\n";
+    }
+    out += "\033[" + std::to_string(lines - 1) + "A";
+    size_t cursorLine = 0;
+    std::vector<std::string> shown(lines);
+
+    auto moveTo = [&](size_t line) {
+        if (line > cursorLine) {
+            out += "\033[" + std::to_string(line - cursorLine) + "B";
+        } else if (line < cursorLine) {
+            out += "\033[" + std::to_string(cursorLine - line) + "A";
+        }
+        cursorLine = line;
+    };
+
+    while (true) {
+        if (queryChanged) {
+            finder.setQuery(query, visible);
+            selected = 0;
+            queryChanged = false;
+        }
+        const auto& results = finder.results();
+        selected = std::min(selected, results.empty() ? 0 : results.size() - 1);
+
+        // 只重绘内容变化的行，最后一次写出
+        std::vector<std::string> frame(lines);
+        frame[0] = "\033[1m" + label + "\033[0m" + query + "  \033[2m" +
+                   std::to_string(finder.matchCount()) + "/" + std::to_string(finder.candidateCount()) +
+                   "\033[0m";
+        for (size_t i = 0; i < results.size(); ++i) {
+            frame[i + 1] = formatResult(results[i].command, finder.highlight(results[i].command),
+                                        i == selected, width);
+        }
+        for (size_t i = 0; i < lines; ++i) {
+            if (frame[i] != shown[i]) {
+                moveTo(i);
+                out += "\r" + frame[i] + "\033[K";
+            }
+        }
+        shown.swap(frame);
+        moveTo(0);
+        out += "\033[" + std::to_string(label.size() + displayWidth(query.data(), query.size()) + 1) + "G";
+        fwrite(out.data(), 1, out.size(), rl_outstream);
+        fflush(rl_outstream);
+        out.clear();
+
+        int c = rl_read_key();
+        if (c == '\r' || c == '\n') {
+            if (!results.empty()) {
+                chosen = std::string(results[selected].command);
+            }
+            break;
+        } else if (c == 27 && inputPending(25)) {
+            // 方向键：ESC [ A / ESC O A
+            int c2 = rl_read_key();
+            int c3 = (c2 == '[' || c2 == 'O') ? rl_read_key() : 0;
+            if (c3 == 'A' && selected > 0) {
+                --selected;
+            } else if (c3 == 'B') {
+                ++selected;
+            }
+        } else if (c <= 0 || c == 27 || c == CTRL('G') || c == CTRL('C') ||
+                   (c == CTRL('D') && query.empty())) {
+            break; // 取消，保留原来的输入
+        } else if (c == CTRL('R') || c == CTRL('N')) {
+            ++selected;
+        } else if (c == CTRL('P') || c == CTRL('S')) {
+            selected = selected > 0 ? selected - 1 : 0;
+        } else if (c == 127 || c == CTRL('H')) {
+            // 删除最后一个UTF-8字符
+            while (!query.empty() && (static_cast<unsigned char>(query.back()) & 0xC0) == 0x80) {
+                query.pop_back();
+            }
+            if (!query.empty()) {
+                query.pop_back();
+            }
+            queryChanged = true;
+        } else if (c == CTRL('U')) {
+            query.clear();
+            queryChanged = true;
+        } else if (c == CTRL('W')) {
+            size_t end = query.find_last_not_of(' ');
+            size_t start = end == std::string::npos ? 0 : query.find_last_of(' ', end);
+            query.erase(start == std::string::npos ? 0 : start + 1);
+            queryChanged = true;
+        } else if (c >= 32 || c == '\t') {
+            query += static_cast<char>(c);
+            queryChanged = true;
+        }
+    }
+
+    // 清除界面和原来的输入行，由readline重新显示提示符和选中的命令
+    moveTo(0);
+    out += "\r\033[J\033[" + std::to_string(inputRows) + "A\r\033[J";
+    fwrite(out.data(), 1, out.size(), rl_outstream);
+    fflush(rl_outstream);
+
+    rl_replace_line(chosen.c_str(), 0);
+    rl_point = rl_end;
+    rl_on_new_line();
+    rl_redisplay();
+    return 0;
+}
+
+int InputHandler::incremental_history_search(int, int) {
+    // 与readline的reverse-i-search相同的按键，在History::search的结果中移动
+    History* history = instance_ ? instance_->shell_->getHistory() : nullptr;
+    const std::string original(rl_line_buffer, rl_end);
+    const int originalPoint = rl_point;
+    std::string query;
+    std::vector<size_t> matches; // 从旧到新的位置
+    size_t position = history ? history->size() : 0; // 当前显示的记录，size()表示原来的输入
+    bool failed = false;
+
+    // 从position起向older方向（或newer方向）找下一条匹配
+    auto find = [&](bool older, bool includeCurrent) {
+        if (older) {
+            auto it = includeCurrent ? std::upper_bound(matches.begin(), matches.end(), position)
+                                     : std::lower_bound(matches.begin(), matches.end(), position);
+            failed = it == matches.begin();
+            if (!failed) {
+                position = *(it - 1);
+            }
+        } else {
+            auto it = std::upper_bound(matches.begin(), matches.end(), position);
+            failed = it == matches.end();
+            if (!failed) {
+                position = *it;
+            }
+        }
+    };
+
+    int c = 0;
+    while (true) {
+        std::string line = original;
+        size_t found = static_cast<size_t>(originalPoint);
+        if (history && position < history->size()) {
+            line = std::string(history->getCommand(position));
+            found = query.empty() ? line.size() : line.find(query);
+        }
+        rl_replace_line(line.c_str(), 0);
+        rl_point = static_cast<int>(std::min(found, line.size()));
+        std::string message = std::string(failed ? "(failed reverse-i-search)`" : "(reverse-i-search)`") +
+                              query + "': ";
+        rl_message("%s", message.c_str());
+
+        c = rl_read_key();
+        if (c == CTRL('R')) {
+            find(true, false);
+        } else if (c == CTRL('S')) {
+            find(false, false);
+        } else if (c == 127 || c == CTRL('H')) {
+            while (!query.empty() && (static_cast<unsigned char>(query.back()) & 0xC0) == 0x80) {
+                query.pop_back();
+            }
+            if (!query.empty()) {
+                query.pop_back();
+            }
+            matches = history && !query.empty() ? history->search(query) : std::vector<size_t>();
+            position = history ? history->size() : 0;
+            find(true, false);
+        } else if (c >= 32 && c != 127) {
+            // 查询变长时当前记录仍匹配就留在原处
+            query += static_cast<char>(c);
+            matches = history ? history->search(query) : std::vector<size_t>();
+            find(true, true);
+        } else {
+            break;
+        }
+    }
+    rl_clear_message();
+
+    // Ctrl-G/Ctrl-C恢复原来的输入；其他键结束查找，保留找到的记录，并照常执行该键
+    // （单独的ESC只结束查找，方向键等ESC开头的序列照常执行）
+    if (c <= 0 || c == CTRL('G') || c == CTRL('C') || !history || position >= history->size()) {
+        rl_replace_line(original.c_str(), 0);
+        rl_point = originalPoint;
+        if (c == CTRL('G') || c == CTRL('C') || c <= 0) {
+            return 0;
+        }
+    } else {
+        int point = rl_point;
+        rl_replace_line(original.c_str(), 0);
+        show_history_entry(history->size() - position);
+        rl_point = point;
+    }
+    if (c == '\r' || c == '\n') {
+        return accept_line(1, c);
+    }
+    if (c != 27 || inputPending(25)) {
+        rl_execute_next(c);
+    }
+    return 0;
+}
+
+void InputHandler::erase_suggestion() {
+    if (suggestion_shown_ == 0) {
+        return;
+    }
+    // 光标不在行尾时先移到输入末尾再清除，然后回到原位
+    size_t after = displayWidth(rl_line_buffer + rl_point, rl_end - rl_point);
+    std::string out;
+    if (after > 0) {
+        out += "\033[" + std::to_string(after) + "C";
+    }
+    out += "\033[K";
+    if (after > 0) {
+        out += "\033[" + std::to_string(after) + "D";
+    }
+    fwrite(out.data(), 1, out.size(), rl_outstream);
+    suggestion_shown_ = 0;
+}
+
+int InputHandler::read_key(FILE* stream) {
+    // 只在等待下一个编辑命令时重新高亮，不在补全的确认提示、多键序列的中间重绘
+    while (RL_ISSTATE(RL_STATE_READCMD)) {
+        struct pollfd fds[2] = {{fileno(stream), POLLIN, 0}, {refresh_[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0 || fds[0].revents != 0 || !(fds[1].revents & POLLIN)) {
+            break;  // 有输入，或被信号打断（由readline处理）
+        }
+        char buffer[64];
+        while (read(refresh_[0], buffer, sizeof(buffer)) > 0) {
+        }
+        refresh_highlighting();
+    }
+    return rl_getc(stream);
+}
+
+void InputHandler::refresh_highlighting() {
+    // 已分析的类型可能过时：整行重新分析，重绘时只写类型变化的部分
+    lexed_line_.clear();
+    tokens_.clear();
+    spans_.clear();
+    redisplay_with_suggestion();
+}
+
+void InputHandler::redisplay_with_suggestion() {
+    // 这次重绘的所有输出攒在一起，最后一次写出
+    drawing_ = true;
+    if (!redisplay_highlighted()) {
+        rl_redisplay();
+        renderer_.invalidate();
+    }
+    show_suggestion();
+    fflush(rl_outstream);
+    drawing_ = false;
+}
+
+bool InputHandler::redisplay_highlighted() {
+    SyntaxHighlighter* highlighter = instance_ ? instance_->syntax_highlighter_.get() : nullptr;
+    if (!live_ || !highlighter || !highlighter->isEnabled() || rl_display_prompt != rl_prompt ||
+        RL_ISSTATE(RL_STATE_ISEARCH | RL_STATE_NSEARCH)) {
+        return false;
+    }
+    int screenRows = 0;
+    int screenCols = 0;
+    rl_get_screen_size(&screenRows, &screenCols);
+    if (screenCols <= 0) {
+        return false;
+    }
+    const char* prompt = rl_display_prompt ? rl_display_prompt : "";
+    const char* lastLine = strrchr(prompt, '\n');
+    lastLine = lastLine ? lastLine + 1 : prompt;
+    std::string line(rl_line_buffer, rl_end);
+    if (!renderer_.layout(line, displayWidth(lastLine, strlen(lastLine)), screenCols)) {
+        return false;
+    }
+    
+    fflush(rl_outstream);
+    if (foreign_ || !renderer_.synced()) {
+        // 有过其他输出，屏幕上是什么不确定：由readline按它记录的状态画出文本，再整行上色
+        foreign_ = false;
+        rl_redisplay();
+        renderer_.adopt(rl_point);
+    } else {
+        // readline只更新它记录的屏幕内容（完成行之类的后续操作要用），输出丢弃
+        discard_ = true;
+        rl_redisplay();
+        fflush(rl_outstream);
+        discard_ = false;
+    }
+    
+    analyze(line, *highlighter);
+    
+    std::string out;
+    renderer_.draw(types_, rl_point, *highlighter, out);
+    fwrite(out.data(), 1, out.size(), rl_outstream);
+    return true;
+}
+
+void InputHandler::show_suggestion() {
+    if (!instance_ || !terminal_) {
+        return;
+    }
+
+    // 只在光标位于输入末尾时建议，和fish一样
+    suggestion_.clear();
+    History* history = instance_->shell_->getHistory();
+    if (history && instance_->autosuggest_enabled_ && rl_end > 0 && rl_point == rl_end &&
+        !RL_ISSTATE(RL_STATE_ISEARCH | RL_STATE_NSEARCH | RL_STATE_COMPLETING)) {
+        std::string line(rl_line_buffer, rl_end);
+        std::string command = history->suggest(line);
+        if (command.size() > line.size()) {
+            suggestion_ = command.substr(line.size());
+        }
+    }
+
+    // 只显示到当前行的行尾（多行命令只显示第一行），不让终端换行
+    int screenRows = 0;
+    int screenCols = 0;
+    rl_get_screen_size(&screenRows, &screenCols);
+    size_t promptWidth = displayWidth(rl_prompt ? rl_prompt : "", rl_prompt ? strlen(rl_prompt) : 0);
+    size_t column = screenCols > 0 ? (promptWidth + displayWidth(rl_line_buffer, rl_end)) % screenCols : 0;
+    size_t room = screenCols > 0 ? static_cast<size_t>(screenCols) - 1 - column : 0;
+
+    size_t length = 0;
+    size_t columns = 0;
+    while (length < suggestion_.size() && suggestion_[length] != '\n') {
+        unsigned char c = static_cast<unsigned char>(suggestion_[length]);
+        if ((c & 0xC0) != 0x80) {
+            if (columns == room) {
+                break;
+            }
+            ++columns;
+        }
+        ++length;
+    }
+
+    if (columns == 0) {
+        erase_suggestion();
+        return;
+    }
+    std::string visible = suggestion_.substr(0, length);
+    std::replace(visible.begin(), visible.end(), '\t', ' ');
+    std::string out = instance_->syntax_highlighter_->sequence(SyntaxType::SUGGESTION);
+    out += visible + Colors::RESET + "\033[K\033[" + std::to_string(columns) + "D";
+    fwrite(out.data(), 1, out.size(), rl_outstream);
+    suggestion_shown_ = columns;
+}
+
+bool InputHandler::accept_suggestion() {
+    if (suggestion_.empty() || rl_point != rl_end) {
+        return false;
+    }
+    std::string text;
+    text.swap(suggestion_);
+    rl_insert_text(text.c_str());
+    rl_point = rl_end;
+    return true;
+}
+
+int InputHandler::forward_char_or_accept(int count, int key) {
+    return accept_suggestion() ? 0 : rl_forward_char(count, key);
+}
+
+int InputHandler::end_of_line_or_accept(int count, int key) {
+    return accept_suggestion() ? 0 : rl_end_of_line(count, key);
+}
+
+int InputHandler::accept_line(int count, int key) {
+    // 回车时不接受建议，并从屏幕上擦掉，免得留在滚动历史中
+    suggestion_.clear();
+    erase_suggestion();
+    fflush(rl_outstream);
+    return rl_newline(count, key);
+}
+
+void InputHandler::show_history_entry(size_t offset) {
+    History* history = instance_ ? instance_->shell_->getHistory() : nullptr;
+    if (!history) {
+        return;
+    }
+    
+    // 离开正在编辑的行时保存它，回到底部时恢复
+    if (history_offset_ == 0 && offset > 0) {
+        saved_line_.assign(rl_line_buffer, rl_end);
+    }
+    offset = std::min(offset, history->size());
+    history_offset_ = offset;
+    
+    std::string line = offset == 0 ? saved_line_ : std::string(history->getCommand(history->size() - offset));
+    rl_replace_line(line.c_str(), 0);
+    rl_point = rl_end;
+}
+
+int InputHandler::history_previous(int count, int key) {
+    if (count < 0) {
+        return history_next(-count, key);
+    }
+    History* history = instance_ ? instance_->shell_->getHistory() : nullptr;
+    if (!history || history_offset_ >= history->size()) {
+        rl_ding();
+        return 0;
+    }
+    show_history_entry(history_offset_ + count);
+    return 0;
+}
+
+int InputHandler::history_next(int count, int key) {
+    if (count < 0) {
+        return history_previous(-count, key);
+    }
+    if (history_offset_ == 0) {
+        rl_ding();
+        return 0;
+    }
+    show_history_entry(history_offset_ > static_cast<size_t>(count) ? history_offset_ - count : 0);
+    return 0;
+}
+
+int InputHandler::history_first(int, int) {
+    History* history = instance_ ? instance_->shell_->getHistory() : nullptr;
+    if (history) {
+        show_history_entry(history->size());
+    }
+    return 0;
+}
+
+int InputHandler::history_last(int, int) {
+    show_history_entry(0);
+    return 0;
+}
+
+template <int (*Command)(int, int)>
+int InputHandler::with_readline_history(int count, int key) {
+    // readline根据上一个命令判断是否连续执行（重复M-.取更早的参数、继续history-search），
+    // 上一个命令是包装过的就换回readline自己的函数
+    bool repeated = rl_last_func && rl_last_func == last_wrapped_command_.first;
+    if (repeated) {
+        rl_last_func = last_wrapped_command_.second;
+    }
+    load_readline_history(!repeated);
+    int result = Command(count, key);
+    last_wrapped_command_ = {with_readline_history<Command>, Command};
+    
+    // 搜索等命令移动了readline的位置：之后的上下方向键从那里继续
+    int position = where_history();
+    history_offset_ = position >= 0 && position < history_length ? history_length - position : 0;
+    return result;
+}
+
+void InputHandler::load_readline_history(bool save_line) {
+    History* history = instance_ ? instance_->shell_->getHistory() : nullptr;
+    if (!readline_history_loaded_) {
+        clear_history();
+        if (history) {
+            for (std::string_view command : *history) {
+                add_history(std::string(command).c_str());
+            }
+        }
+        readline_history_loaded_ = true;
+    }
+    
+    // 列表与History的可见记录一一对应；离开正在编辑的行时和上下方向键一样保存它
+    if (history_offset_ == 0 && save_line) {
+        saved_line_.assign(rl_line_buffer, rl_end);
+    }
+    history_set_pos(history_length - static_cast<int>(std::min<size_t>(history_offset_, history_length)));
+}
+
+void InputHandler::release_readline_history() {
+    if (readline_history_loaded_) {
+        clear_history();
+        readline_history_loaded_ = false;
+    }
+    last_wrapped_command_ = {};
+}
+
+int InputHandler::operate_and_get_next(int count, int key) {
+    // readline自己的实现在下一行开始时读取它的历史列表，那时列表已经释放
+    next_entry_.clear();
+    History* history = instance_ ? instance_->shell_->getHistory() : nullptr;
+    if (history && history_offset_ > 1 && history_offset_ <= history->size()) {
+        next_offset_ = history_offset_ - 1;
+        next_entry_ = std::string(history->getCommand(history->size() - next_offset_));
+    }
+    return accept_line(count, key);
+}
+
+int InputHandler::show_next_entry() {
+    // 刚执行的行加入历史后，后面那条的位置不变；没有加入（如ignoredups）时近了一条
+    rl_startup_hook = nullptr;
+    History* history = instance_ ? instance_->shell_->getHistory() : nullptr;
+    std::string entry = std::move(next_entry_);
+    next_entry_.clear();
+    if (!history) {
+        return 0;
+    }
+    for (size_t offset : {next_offset_ + 1, next_offset_}) {
+        if (offset > 0 && offset <= history->size() && history->getCommand(history->size() - offset) == entry) {
+            show_history_entry(offset);
+            return 0;
+        }
+    }
+    rl_replace_line(entry.c_str(), 0);
+    rl_point = rl_end;
+    return 0;
+}
+
+void InputHandler::rebind_history_commands() {
+    // 把所有键位表中绑定到readline历史命令的按键（包括inputrc中的设置）改为读取History，
+    // 右移/行尾/回车换成能处理自动建议的版本
+    const std::pair<rl_command_func_t*, rl_command_func_t*> replacements[] = {
+        {rl_get_previous_history, history_previous},
+        {rl_get_next_history, history_next},
+        {rl_beginning_of_history, history_first},
+        {rl_end_of_history, history_last},
+        {rl_reverse_search_history, fuzzy_history_search},
+        {rl_forward_char, forward_char_or_accept},
+        {rl_end_of_line, end_of_line_or_accept},
+        {rl_newline, accept_line},
+        // 其余读取历史的命令仍由readline执行，临时使用从History复制的列表
+        {rl_forward_search_history, with_readline_history<rl_forward_search_history>},
+        {rl_noninc_forward_search, with_readline_history<rl_noninc_forward_search>},
+        {rl_noninc_reverse_search, with_readline_history<rl_noninc_reverse_search>},
+        {rl_noninc_forward_search_again, with_readline_history<rl_noninc_forward_search_again>},
+        {rl_noninc_reverse_search_again, with_readline_history<rl_noninc_reverse_search_again>},
+        {rl_history_search_forward, with_readline_history<rl_history_search_forward>},
+        {rl_history_search_backward, with_readline_history<rl_history_search_backward>},
+        {rl_history_substr_search_forward, with_readline_history<rl_history_substr_search_forward>},
+        {rl_history_substr_search_backward, with_readline_history<rl_history_substr_search_backward>},
+        {rl_yank_nth_arg, with_readline_history<rl_yank_nth_arg>},
+        {rl_yank_last_arg, with_readline_history<rl_yank_last_arg>},
+        {rl_vi_fetch_history, with_readline_history<rl_vi_fetch_history>},
+        {rl_vi_search, with_readline_history<rl_vi_search>},
+        {rl_vi_search_again, with_readline_history<rl_vi_search_again>},
+        {rl_vi_yank_arg, with_readline_history<rl_vi_yank_arg>},
+#if RL_VERSION_MAJOR > 8 || (RL_VERSION_MAJOR == 8 && RL_VERSION_MINOR >= 1)
+        {rl_fetch_history, with_readline_history<rl_fetch_history>},
+        {rl_operate_and_get_next, operate_and_get_next},
+#endif
+    };
+    for (const char* name : {"emacs", "vi-insert", "vi-command"}) {
+        Keymap map = rl_get_keymap_by_name(name);
+        if (!map) {
+            continue;
+        }
+        for (const auto& replacement : replacements) {
+            char** keyseqs = rl_invoking_keyseqs_in_map(replacement.first, map);
+            if (!keyseqs) {
+                continue;
+            }
+            for (char** keyseq = keyseqs; *keyseq; ++keyseq) {
+                rl_bind_keyseq_in_map(*keyseq, replacement.second, map);
+                free(*keyseq);
+            }
+            free(keyseqs);
+        }
+    }
+}
+
 // readline回调函数
 char** InputHandler::completion_function(const char* text, int start, int end) {
+    // 任何情况下都不让readline接着做默认的文件名补全：它在readline线程中同步读目录，
+    // 正是慢速文件系统上卡住输入的原因（包括到期限时返回空的部分结果）
+    rl_attempted_completion_over = 1;
     if (!instance_ || !instance_->completion_enabled_) {
         return nullptr;
     }
     
     // 获取补全候选项
-    std::string current_line = rl_line_buffer;
-    auto completions = instance_->completion_engine_->getCompletions(current_line, start, end);
-    
-    if (completions.empty()) {
+    std::vector<std::string> completions;
+    std::string common;
+    std::string typed;
+    bool done = complete_in_background(rl_line_buffer, start, end, fileno(rl_instream), rl_completion_invoking_key,
+                                       typed, completions, common);
+    for (char key : typed) {
+        rl_stuff_char(static_cast<unsigned char>(key));
+    }
+    if (!done || completions.empty()) {
         return nullptr;
     }
     
-    // 转换为readline格式
-    char** matches = (char**)malloc(sizeof(char*) * (completions.size() + 2));
+    // 转换为readline格式：matches[0]是替换当前词的文本，即所有匹配的最长公共前缀；
+    // 只有一个候选时直接是它本身，后面不再列出
+    size_t count = completions.size() == 1 ? 0 : completions.size();
+    
+    char** matches = (char**)malloc(sizeof(char*) * (count + 2));
     if (!matches) {
         return nullptr;
     }
     
-    matches[0] = strdup(text); // 默认匹配
+    matches[0] = common.size() >= strlen(text) ? strdup(common.c_str()) : strdup(text);
     
-    for (size_t i = 0; i < completions.size(); ++i) {
+    for (size_t i = 0; i < count; ++i) {
         matches[i + 1] = strdup(completions[i].c_str());
     }
-    matches[completions.size() + 1] = nullptr;
+    matches[count + 1] = nullptr;
     
     return matches;
 }
 
-char* InputHandler::command_generator(const char* text, int state) {
-    // 这个函数会被readline反复调用来生成补全候选项
-    static std::vector<std::string> matches;
-    static size_t match_index;
-    
-    if (state == 0) {
-        // 第一次调用，生成匹配列表
-        matches.clear();
-        match_index = 0;
-        
-        if (instance_ && instance_->completion_enabled_) {
-            std::string current_line = rl_line_buffer;
-            int start = rl_point - strlen(text);
-            int end = rl_point;
-            matches = instance_->completion_engine_->getCompletions(current_line, start, end);
-        }
+ssize_t InputHandler::terminal_write(void*, const char* data, size_t size) {
+    if (discard_) {
+        return size;
     }
-    
-    // 返回下一个匹配项
-    if (match_index < matches.size()) {
-        return strdup(matches[match_index++].c_str());
+    if (!drawing_) {
+        foreign_ = true;
     }
-    
-    return nullptr;
+    size_t written = 0;
+    while (written < size) {
+        ssize_t n = write(STDOUT_FILENO, data + written, size - written);
+        if (n < 0 && errno != EINTR) {
+            return written > 0 ? static_cast<ssize_t>(written) : -1;
+        }
+        written += n > 0 ? n : 0;
+    }
+    return size;
 }
 
 void InputHandler::initialize_readline() {
+    // 输出到终端时经过terminal_write，以便知道readline什么时候在重绘之外输出了内容
+    terminal_ = isatty(STDOUT_FILENO);
+    FILE* stream = nullptr;
+#if defined(PLATFORM_LINUX)
+    if (terminal_) {
+        cookie_io_functions_t functions = {nullptr, terminal_write, nullptr, nullptr};
+        stream = fopencookie(nullptr, "w", functions);
+    }
+#elif defined(PLATFORM_MACOS)
+    if (terminal_) {
+        stream = funopen(nullptr, nullptr, [](void* cookie, const char* data, int size) {
+            return static_cast<int>(terminal_write(cookie, data, static_cast<size_t>(size)));
+        }, nullptr, nullptr);
+    }
+#endif
+    if (stream) {
+        setvbuf(stream, nullptr, _IOLBF, BUFSIZ);
+        rl_outstream = stream;
+        live_ = true;
+    }
+    
     // 设置补全函数
     rl_attempted_completion_function = completion_function;
     
     // 设置其他readline选项
-    rl_basic_word_break_characters = " \t\n\"\\'`@$><=;|&{(";
+    rl_basic_word_break_characters = kWordBreakCharacters;
+    
+    // Ctrl-R 换成模糊查找（可在inputrc中按名字重新绑定）
+    rl_add_defun("mysh-fuzzy-history", fuzzy_history_search, CTRL('R'));
     
-    // 启用历史记录
-    using_history();
+    // 先读入inputrc，再替换其中绑定到历史命令的按键
+    rl_initialize();
+    rebind_history_commands();
+    rl_redisplay_function = redisplay_with_suggestion;
     
-    // 设置历史文件（可选）
-    // read_history(".mysh_history");
+    // 实时高亮时，命令索引和路径缓存在后台得到新结果后通知readline重新高亮
+    if (live_ && watch_caches()) {
+        rl_getc_function = read_key;
+    }
     
     // 其他readline配置
     rl_completion_append_character = ' ';
@@ -5,6 +5,14 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include <cstdio>
+#include <string_view>
+#include <sys/types.h>
+#include "task_queue.h"
+#include "line_renderer.h"
+#include "path_cache.h"
+#include "theme.h"
+#include "line_editor.h"
 
 class Shell;
 class CompletionEngine;
@@ -16,7 +24,7 @@ public:
     explicit InputHandler(Shell* shell);
     ~InputHandler();
     
-    // 初始化readline
+    // 初始化readline（或内置的行编辑器）
     bool initialize();
     
     // 读取一行输入（支持补全和高亮）
@@ -26,36 +34,140 @@ public:
     void setCompletionEnabled(bool enabled) { completion_enabled_ = enabled; }
     bool isCompletionEnabled() const { return completion_enabled_; }
     
+    // 启用/禁用历史命令自动建议（灰色显示在光标后，右方向键接受）
+    void setAutosuggestEnabled(bool enabled) { autosuggest_enabled_ = enabled; }
+    bool isAutosuggestEnabled() const { return autosuggest_enabled_; }
+    
     // 启用/禁用语法高亮
     void setSyntaxHighlightEnabled(bool enabled);
     bool isSyntaxHighlightEnabled() const;
     
+    // 读入主题文件并按终端的颜色数应用（path为空时恢复默认配色）；出错时保持原来的配色
+    bool loadTheme(const std::string& path, std::string& error);
+    const std::string& getThemePath() const { return theme_path_; }
+    
+    // 是否在输入时实时高亮（内置的行编辑器，或readline并且输出是终端）；否则回车后再显示高亮的命令
+    bool highlightsWhileTyping() const { return editor_ || (use_readline_ && live_); }
+    
+    // 获取补全引擎（complete内置命令注册补全规格）
+    CompletionEngine* getCompletionEngine() { return completion_engine_.get(); }
+    
     // 获取语法高亮器（用于外部访问）
     SyntaxHighlighter* getSyntaxHighlighter() { return syntax_highlighter_.get(); }
     
-    // 添加历史记录
-    void addHistory(const std::string& line);
-    
     // 清理资源
     void cleanup();
     
 private:
     Shell* shell_;
-    std::unique_ptr<CompletionEngine> completion_engine_;
+    std::shared_ptr<CompletionEngine> completion_engine_;   // 与后台的补全任务共享
     std::unique_ptr<SyntaxHighlighter> syntax_highlighter_;
     
+    // Tab补全在这里执行，不在readline回调里等待文件系统；只有一个工作线程，任务依次执行。
+    // 不与PathCache、OptionIndex的队列共用：卡住的stat或慢的man解析不能排在补全前面
+    TaskQueue background_;
+    
+    // 启动时检测的终端颜色能力，和当前主题文件（空为默认配色）
+    ColorDepth color_depth_;
+    std::string theme_path_;
+    
+    // 语法高亮查询路径是否存在时用的缓存（在它自己的后台线程中stat）
+    PathCache paths_;
+    
+    // 内置的行编辑器（没有readline或MYSH_LINE_EDITOR=native时使用）
+    std::unique_ptr<LineEditor> editor_;
+    void initialize_native();
+    
     bool initialized_;
     bool completion_enabled_;
     bool use_readline_;
+    bool autosuggest_enabled_;
     
     // readline相关的静态函数
     static char** completion_function(const char* text, int start, int end);
-    static char* command_generator(const char* text, int state);
+    static bool complete_in_background(const std::string& line, int start, int end, int input, int repeat,
+                                       std::string& typed, std::vector<std::string>& completions,
+                                       std::string& common);
     static void initialize_readline();
     
+    // Ctrl-R：模糊查找历史；终端太小或不是终端时退回到消息区的逐字增量查找
+    static int fuzzy_history_search(int count, int key);
+    static int incremental_history_search(int count, int key);
+    
+    // 上下方向键等历史浏览命令直接读取History，readline自己的历史列表平时保持为空
+    static int history_previous(int count, int key);
+    static int history_next(int count, int key);
+    static int history_first(int count, int key);
+    static int history_last(int count, int key);
+    static void show_history_entry(size_t offset);
+    static void rebind_history_commands();
+    
+    // 其他读取历史的readline命令（history-search-backward、M-p、M-.等）：执行前把History复制到
+    // readline的列表并对齐当前浏览的位置，执行后同步回来；这一行编辑结束后释放（readLine）
+    template <int (*Command)(int, int)>
+    static int with_readline_history(int count, int key);
+    static void load_readline_history(bool save_line);
+    static void release_readline_history();
+    static bool readline_history_loaded_;
+    static std::pair<int (*)(int, int), int (*)(int, int)> last_wrapped_command_;
+    
+    // operate-and-get-next（Ctrl-O）：执行当前行，下一行开始时显示History中它后面的一条
+    static int operate_and_get_next(int count, int key);
+    static int show_next_entry();
+    static std::string next_entry_;
+    static size_t next_offset_;
+    
+    // 每次重绘：实时高亮输入行，然后在光标后补上自动建议的剩余部分
+    static void redisplay_with_suggestion();
+    static bool redisplay_highlighted();
+    static void show_suggestion();
+    static void erase_suggestion();
+    static bool accept_suggestion();
+    static int forward_char_or_accept(int count, int key);
+    static int end_of_line_or_accept(int count, int key);
+    static int accept_line(int count, int key);
+    
+    // 当前建议的剩余部分，以及屏幕上显示了多少列
+    static std::string suggestion_;
+    static size_t suggestion_shown_;
+    
+    // readline的输出流：包装标准输出，记下重绘之外的输出（补全列表、清屏等），
+    // 之后屏幕上的输入行由readline重新画出
+    static ssize_t terminal_write(void* cookie, const char* data, size_t size);
+    static bool terminal_;          // 标准输出是终端
+    static bool live_;              // readline的输出经过terminal_write，可以实时高亮
+    static bool drawing_;           // 正在重绘输入行
+    static bool discard_;           // 丢弃readline的输出（只让它更新记录的屏幕内容）
+    static bool foreign_;           // 上次重绘之后有其他输出
+    
+    // 实时高亮：屏幕上的输入行、上次分析的行、分词和高亮的结果（一一对应）、每个字节的类型。
+    // 每次编辑只分词一次，Tab补全的行与之相同时直接使用分词结果
+    static LineRenderer renderer_;
+    static std::string lexed_line_;
+    static std::vector<Token> tokens_;
+    static std::vector<HighlightSpan> spans_;
+    static std::vector<SyntaxType> types_;
+    static void analyze(const std::string& line, SyntaxHighlighter& highlighter);
+    
+    // 当前浏览的位置（距最新一条的距离，0表示正在编辑的行）和被替换前的输入
+    static size_t history_offset_;
+    static std::string saved_line_;
+    
     // 静态实例指针（readline需要）
     static InputHandler* instance_;
     
+    // 语法高亮的查询：命令是内置命令、PATH中的命令或可执行文件，路径是否存在；只查缓存
+    Existence findCommand(std::string_view name);
+    Existence findPath(std::string_view word);
+    
+    // 命令索引或路径缓存的结果变化时（后台线程）写入refresh_，readline或内置的编辑器等待按键时
+    // 收到后重新高亮
+    static int refresh_[2];
+    static bool watch_caches();
+    static void request_refresh();
+    static int read_key(FILE* stream);
+    static void refresh_highlighting();
+    
     // 非readline输入处理
     std::string readLineSimple(const std::string& prompt);
     
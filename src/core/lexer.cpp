@@ -0,0 +1,229 @@
+#include "lexer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define LEXER_X86_SIMD 1
+#else
+#define LEXER_X86_SIMD 0
+#endif
+
+namespace {
+
+// 字符分类，查表代替逐个比较（'\0'单独一类：std::string末尾的'\0'用作扫描的边界）
+enum CharClass : unsigned char { kWord, kSpace, kOperator, kQuote, kEscape, kNul };
+
+struct CharClasses {
+    unsigned char table[256] = {};
+
+    constexpr CharClasses() {
+        for (unsigned char c : {' ', '\t', '\n', '\v', '\f', '\r'}) table[c] = kSpace;
+        for (unsigned char c : {'|', '&', ';', '>', '<'}) table[c] = kOperator;
+        table[static_cast<unsigned char>('"')] = kQuote;
+        table[static_cast<unsigned char>('\'')] = kQuote;
+        table[static_cast<unsigned char>('\\')] = kEscape;
+        table[0] = kNul;
+    }
+};
+
+constexpr CharClasses kCharClasses;
+
+inline unsigned char charClass(char c) {
+    return kCharClasses.table[static_cast<unsigned char>(c)];
+}
+
+// 从pos开始跳过普通字符，返回第一个可能不是kWord的位置（由调用者查表确认）
+inline size_t skipWord(const char* text, size_t pos, size_t size) {
+#if LEXER_X86_SIMD
+    // 每次检查16字节：空白和控制字符（不大于0x20），以及操作符、引号和反斜杠。
+    // 只在[pos, size)还剩整16字节时读取，不读size之后的内存；剩下的不足16字节交给调用者逐字节扫描
+    const __m128i space = _mm_set1_epi8(0x20);
+    while (size - pos >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos));
+        auto is = [block](char c) { return _mm_cmpeq_epi8(block, _mm_set1_epi8(c)); };
+        __m128i stop = _mm_cmpeq_epi8(_mm_min_epu8(block, space), block);
+        stop = _mm_or_si128(stop, _mm_or_si128(is('|'), is('&')));
+        stop = _mm_or_si128(stop, _mm_or_si128(is(';'), is('>')));
+        stop = _mm_or_si128(stop, _mm_or_si128(is('<'), is('"')));
+        stop = _mm_or_si128(stop, _mm_or_si128(is('\''), is('\\')));
+        unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(stop));
+        if (bits) {
+            return pos + __builtin_ctz(bits);
+        }
+        pos += 16;
+    }
+#else
+    (void)text;
+    (void)size;
+#endif
+    return pos;
+}
+
+} // namespace
+
+bool Lexer::next(const std::string& line, size_t pos, Token& token) {
+    const char* text = line.data();
+    size_t size = line.size();
+    while (pos < size && charClass(text[pos]) == kSpace) {
+        ++pos;
+    }
+    if (pos >= size) {
+        return false;
+    }
+    token.start = pos;
+
+    // 注释：词首的#到行尾
+    if (text[pos] == '#') {
+        token.end = size;
+        token.kind = TokenKind::COMMENT;
+        return true;
+    }
+
+    // 操作符：| || & && &> ; > >> < << 以及2> 2>>
+    if (text[pos] == '2' && pos + 1 < size && text[pos + 1] == '>') {
+        token.end = pos + (pos + 2 < size && text[pos + 2] == '>' ? 3 : 2);
+        token.kind = TokenKind::REDIRECT;
+        return true;
+    }
+    if (charClass(text[pos]) == kOperator) {
+        char c = text[pos];
+        size_t end = pos + 1;
+        bool doubled = end < size && c != ';' && text[end] == c;
+        bool all = c == '&' && end < size && text[end] == '>';
+        token.end = end + (doubled || all ? 1 : 0);
+        switch (c) {
+            case '|': token.kind = doubled ? TokenKind::OR : TokenKind::PIPE; break;
+            case '&': token.kind = doubled ? TokenKind::AND : all ? TokenKind::REDIRECT : TokenKind::BACKGROUND; break;
+            case ';': token.kind = TokenKind::SEMICOLON; break;
+            default: token.kind = TokenKind::REDIRECT; break;
+        }
+        return true;
+    }
+
+    // 普通的词：引号内的空白和操作符属于词的一部分，未闭合的引号延续到行尾。
+    // 逐字节扫描不检查边界，依赖的是std::string保证data()[size()]为'\0'（kNul，不是kWord），
+    // 循环最远停在size。因此line必须是std::string，不能换成string_view或不以'\0'结尾的缓冲区
+    size_t end = pos;
+    for (;;) {
+        end = skipWord(text, end, size);
+        while (charClass(text[end]) == kWord) {
+            ++end;
+        }
+        if (end >= size) {
+            break;
+        }
+        unsigned char type = charClass(text[end]);
+        if (type == kSpace || type == kOperator) {
+            break;
+        }
+        if (type == kNul || type == kEscape) {
+            // 行中间的'\0'属于词；反斜杠连同后面的一个字符
+            end += type == kEscape && end + 1 < size ? 2 : 1;
+            continue;
+        }
+        char quote = text[end];
+        for (++end; end < size && text[end] != quote; ++end) {
+            if (quote == '"' && text[end] == '\\' && end + 1 < size) {
+                ++end;
+            }
+        }
+        if (end == size) {
+            break;
+        }
+        ++end;
+    }
+    token.end = end;
+    token.kind = TokenKind::WORD;
+    return true;
+}
+
+std::vector<Token> Lexer::tokenize(const std::string& line) {
+    std::vector<Token> tokens;
+    Token token;
+    for (size_t pos = 0; next(line, pos, token); pos = token.end) {
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+LexChange Lexer::update(const std::string& previous, const std::string& line, std::vector<Token>& tokens) {
+    // 公共前缀和（不与前缀重叠的）公共后缀之间是被编辑的部分
+    size_t common = std::min(previous.size(), line.size());
+    size_t prefix = std::mismatch(previous.begin(), previous.begin() + common, line.begin()).first -
+                    previous.begin();
+    size_t suffix = 0;
+    while (suffix < common - prefix &&
+           previous[previous.size() - 1 - suffix] == line[line.size() - 1 - suffix]) {
+        ++suffix;
+    }
+
+    // 从结束位置不在编辑处之前的第一个元素开始（紧挨着编辑处的元素也会变，如"ls"后输入"x"）
+    auto first = std::lower_bound(tokens.begin(), tokens.end(), prefix,
+                                  [](const Token& token, size_t pos) { return token.end < pos; });
+    LexChange change;
+    change.first = first - tokens.begin();
+    change.offset = first != tokens.end() ? std::min(first->start, prefix) : prefix;
+
+    std::vector<Token> tail(first, tokens.end());
+    tokens.erase(first, tokens.end());
+
+    // 重新分词，直到新元素从未修改的后缀中开始、且与原来的某个元素对齐：之后的文本相同，元素也相同
+    size_t unchanged = line.size() - suffix;
+    ptrdiff_t delta = static_cast<ptrdiff_t>(line.size()) - static_cast<ptrdiff_t>(previous.size());
+    auto old = tail.begin();
+    Token token;
+    for (size_t pos = change.offset; next(line, pos, token); pos = token.end) {
+        if (token.start >= unchanged) {
+            while (old != tail.end() && static_cast<ptrdiff_t>(old->start) + delta < static_cast<ptrdiff_t>(token.start)) {
+                ++old;
+            }
+            if (old != tail.end() && static_cast<ptrdiff_t>(old->start) + delta == static_cast<ptrdiff_t>(token.start)) {
+                change.resume = tokens.size();
+                for (; old != tail.end(); ++old) {
+                    tokens.push_back({old->start + delta, old->end + delta, old->kind});
+                }
+                return change;
+            }
+        }
+        tokens.push_back(token);
+    }
+    change.resume = tokens.size();
+    return change;
+}
+
+std::string Lexer::unquote(std::string_view word, const std::function<std::string(const std::string&)>& expand) {
+    std::string value;
+    value.reserve(word.size());
+    char quote = 0;
+    for (size_t i = 0; i < word.size(); ++i) {
+        char c = word[i];
+        if (quote == '\'') {
+            if (c == '\'') {
+                quote = 0;
+            } else {
+                value += c;
+            }
+        } else if (c == '\\' && i + 1 < word.size() && (!quote || strchr("\"\\$`", word[i + 1]))) {
+            // 引号外转义任何字符，双引号内只转义" \ $ `
+            value += word[++i];
+        } else if (c == '"' || (c == '\'' && !quote)) {
+            quote = quote ? 0 : c;
+        } else if (c == '$' && expand) {
+            size_t end = i + 1;
+            while (end < word.size() && (std::isalnum(static_cast<unsigned char>(word[end])) || word[end] == '_')) {
+                ++end;
+            }
+            if (end > i + 1) {
+                value += expand(std::string(word.substr(i + 1, end - i - 1)));
+                i = end - 1;
+            } else {
+                value += c;
+            }
+        } else {
+            value += c;
+        }
+    }
+    return value;
+}
@@ -0,0 +1,62 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+// 词法元素的种类
+enum class TokenKind {
+    WORD,           // 普通的词（可以含引号和反斜杠，引号内的空白和操作符属于词的一部分）
+    PIPE,           // |
+    OR,             // ||
+    BACKGROUND,     // &
+    AND,            // &&
+    SEMICOLON,      // ;
+    REDIRECT,       // > >> < << 2> 2>> &>
+    COMMENT         // 词首的#到行尾
+};
+
+// 词法元素在行中的字节区间[start, end)
+struct Token {
+    size_t start;
+    size_t end;
+    TokenKind kind;
+};
+
+// 增量分词的结果：[first, resume)是重新分词得到的元素，resume之后是原来的元素平移过来的
+struct LexChange {
+    size_t first;       // 第一个重新分词的元素
+    size_t resume;      // 第一个平移过来的元素（没有时为元素个数）
+    size_t offset;      // 第一个可能变化的字节位置
+};
+
+// 命令行的词法分析（解析器、语法高亮和补全共用）
+//
+// 只记录每个元素的位置和种类，不复制文本；未闭合的引号延续到行尾（正在输入的行）。
+// 编辑后用update只重新分析被编辑的元素，之后的元素与原来的对齐时直接平移。
+class Lexer {
+public:
+    // 从pos开始找下一个元素（跳过空白），没有时返回false
+    static bool next(const std::string& line, size_t pos, Token& token);
+
+    // 整行分词
+    static std::vector<Token> tokenize(const std::string& line);
+
+    // 增量分词：tokens是previous的结果，更新为line的结果
+    static LexChange update(const std::string& previous, const std::string& line, std::vector<Token>& tokens);
+
+    // 词去掉引号和反斜杠之后的值；expand非空时展开引号外和双引号内的$NAME
+    static std::string unquote(std::string_view word,
+                               const std::function<std::string(const std::string&)>& expand = nullptr);
+
+    // 操作符之后开始新的命令（| || & && ;）
+    static bool separatesCommands(TokenKind kind) {
+        return kind == TokenKind::PIPE || kind == TokenKind::OR || kind == TokenKind::BACKGROUND ||
+               kind == TokenKind::AND || kind == TokenKind::SEMICOLON;
+    }
+};
+
+#endif // LEXER_H
@@ -0,0 +1,658 @@
+#include "line_editor.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <clocale>
+#include <csignal>
+#include <cwchar>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+namespace {
+
+// 单独的ESC：这么久没有后续字节就不是按键序列的开头
+constexpr int kEscapeTimeoutMs = 50;
+
+// 候选超过这么多时先询问再列出（和readline的completion-query-items相同）
+constexpr size_t kQueryItems = 100;
+
+const std::string kPasteStart = "\033[200~";
+const std::string kPasteEnd = "\033[201~";
+
+// 终端尺寸变化，下一帧按新的宽度重画
+volatile sig_atomic_t resized = 0;
+
+void onResize(int) {
+    resized = 1;
+}
+
+bool continuation(unsigned char c) {
+    return (c & 0xC0) == 0x80;
+}
+
+// UTF-8字符的字节数（按首字节）
+size_t sequenceLength(unsigned char c) {
+    return c < 0xC0 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+}
+
+bool control(unsigned char c) {
+    return c < 0x20 || c == 0x7F;
+}
+
+bool wordCharacter(unsigned char c) {
+    return c >= 0x80 || std::isalnum(c) || c == '_';
+}
+
+// 显示宽度：控制字符显示为^X占两列，无法确定宽度的字符显示为?占一列
+size_t textWidth(std::string_view text) {
+    size_t width = 0;
+    std::mbstate_t state{};
+    for (size_t i = 0; i < text.size();) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        size_t length = 1;
+        if (control(c)) {
+            width += 2;
+        } else if (c < 0x80) {
+            width += 1;
+        } else {
+            wchar_t wc;
+            state = std::mbstate_t{};
+            size_t n = std::mbrtowc(&wc, text.data() + i, text.size() - i, &state);
+            int w = n == 0 || n > text.size() - i ? 1 : wcwidth(wc);
+            length = n == 0 || n > text.size() - i ? 1 : n;
+            width += w > 0 ? w : 1;
+        }
+        i += length;
+    }
+    return width;
+}
+
+size_t terminalColumns() {
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0) {
+        return size.ws_col;
+    }
+    return 80;
+}
+
+} // namespace
+
+LineEditor::LineEditor(const SyntaxHighlighter& highlighter, Callbacks callbacks)
+    : highlighter_(highlighter), callbacks_(std::move(callbacks)) {
+    // 和readline一样按环境变量设置字符类型，UTF-8字符才能算出宽度
+    setlocale(LC_CTYPE, "");
+}
+
+bool LineEditor::available() {
+    return isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+}
+
+std::string LineEditor::readLine(const std::string& prompt) {
+    struct termios saved;
+    if (tcgetattr(STDIN_FILENO, &saved) != 0) {
+        return "";
+    }
+    // 原始模式：逐字节读入，不回显；Ctrl-C等由编辑器自己处理。输出处理（\n换成\r\n）保留
+    struct termios raw = saved;
+    raw.c_iflag &= ~(BRKINT | ICRNL | INLCR | ISTRIP | IXON);
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &raw);
+
+    // 不自动重启被打断的poll，尺寸变化后马上重画
+    struct sigaction action = {};
+    struct sigaction previous;
+    action.sa_handler = onResize;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGWINCH, &action, &previous);
+
+    line_.clear();
+    point_ = 0;
+    historyOffset_ = 0;
+    savedLine_.clear();
+    tabbed_ = false;
+    closed_ = false;
+    prompt_ = prompt;
+    size_t newline = prompt.rfind('\n');
+    promptLine_ = newline == std::string::npos ? prompt : prompt.substr(newline + 1);
+    promptWidth_ = textWidth(promptLine_);
+    columns_ = terminalColumns();
+    resized = 0;
+    fresh_ = true;
+    out_ += "\033[?2004h";      // 开启括号粘贴
+
+    Result result = Result::CONTINUE;
+    while (true) {
+        size_t pos = 0;
+        while (result == Result::CONTINUE && pos < input_.size()) {
+            size_t used = dispatch(pos, result);
+            if (used == 0) {
+                break;
+            }
+            pos += used;
+        }
+        input_.erase(0, pos);
+        if (result == Result::CONTINUE && closed_) {
+            result = Result::END;
+        }
+        if (result != Result::CONTINUE) {
+            break;
+        }
+
+        // 到达的按键都处理完才画；剩下不完整的序列时等后续字节（粘贴的内容一直等到结束标记）
+        bool partial = !input_.empty();
+        if (!partial) {
+            render(false);
+        }
+        int timeout = !partial || input_.compare(0, kPasteStart.size(), kPasteStart) == 0 ? -1 : kEscapeTimeoutMs;
+        if (!readInput(timeout) && partial) {
+            input_.erase(0, 1);     // 单独的ESC或截断的字符
+        }
+    }
+
+    render(true);
+    if (result == Result::CANCEL) {
+        out_ += "^C\r\n";
+    } else if (renderer_.cursorColumn() == 0 || renderer_.cursorColumn() % columns_ != 0) {
+        out_ += "\r\n";             // 正好写满一行时已经换到下一行
+    }
+    out_ += "\033[?2004l";
+    flush();
+
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &saved);
+    sigaction(SIGWINCH, &previous, nullptr);
+    renderer_.invalidate();
+    return result == Result::ACCEPT ? line_ : "";
+}
+
+size_t LineEditor::dispatch(size_t pos, Result& result) {
+    unsigned char c = static_cast<unsigned char>(input_[pos]);
+    bool tab = c == '\t';
+    size_t used = 1;
+    switch (c) {
+        case '\r':
+        case '\n':
+            result = Result::ACCEPT;
+            break;
+        case 0x03:  // Ctrl-C
+            result = Result::CANCEL;
+            break;
+        case 0x04:  // Ctrl-D
+            if (line_.empty()) {
+                result = Result::END;
+            } else {
+                erase(point_, nextCharacter(point_));
+            }
+            break;
+        case 0x01:  // Ctrl-A
+            point_ = 0;
+            break;
+        case 0x05:  // Ctrl-E
+            if (!acceptSuggestion()) {
+                point_ = line_.size();
+            }
+            break;
+        case 0x02:  // Ctrl-B
+            point_ = previousCharacter(point_);
+            break;
+        case 0x06:  // Ctrl-F
+            if (!acceptSuggestion()) {
+                point_ = nextCharacter(point_);
+            }
+            break;
+        case 0x08:
+        case 0x7F:  // Backspace
+            erase(previousCharacter(point_), point_);
+            break;
+        case 0x0B:  // Ctrl-K
+            erase(point_, line_.size());
+            break;
+        case 0x15:  // Ctrl-U
+            erase(0, point_);
+            break;
+        case 0x17: {  // Ctrl-W：删除光标前以空白分隔的词
+            size_t start = point_;
+            while (start > 0 && std::isspace(static_cast<unsigned char>(line_[start - 1]))) {
+                --start;
+            }
+            while (start > 0 && !std::isspace(static_cast<unsigned char>(line_[start - 1]))) {
+                --start;
+            }
+            erase(start, point_);
+            break;
+        }
+        case 0x0C:  // Ctrl-L
+            out_ += "\033[H\033[2J";
+            fresh_ = true;
+            break;
+        case 0x10:  // Ctrl-P
+            showHistory(historyOffset_ + 1);
+            break;
+        case 0x0E:  // Ctrl-N
+            showHistory(historyOffset_ - 1);
+            break;
+        case '\t':
+            complete();
+            break;
+        case 0x1B:
+            used = dispatchEscape(pos);
+            break;
+        default: {
+            if (control(c)) {
+                break;
+            }
+            // 一段连续的普通字符一次插入；末尾不完整的UTF-8字符等后续字节
+            size_t end = pos;
+            while (end < input_.size() && !control(static_cast<unsigned char>(input_[end]))) {
+                ++end;
+            }
+            size_t lead = end;
+            while (lead > pos && continuation(static_cast<unsigned char>(input_[lead - 1]))) {
+                --lead;
+            }
+            if (lead > pos && sequenceLength(static_cast<unsigned char>(input_[lead - 1])) > end - lead + 1) {
+                end = lead - 1;
+            }
+            if (end == pos) {
+                return 0;
+            }
+            insert(std::string_view(input_).substr(pos, end - pos));
+            used = end - pos;
+            break;
+        }
+    }
+    tabbed_ = tab;
+    return used;
+}
+
+size_t LineEditor::dispatchEscape(size_t pos) {
+    if (pos + 1 >= input_.size()) {
+        return 0;
+    }
+    char kind = input_[pos + 1];
+    if (kind != '[' && kind != 'O') {
+        // Alt+键
+        switch (kind) {
+            case 'b':
+                point_ = previousWord(point_);
+                break;
+            case 'f':
+                point_ = nextWord(point_);
+                break;
+            case 'd':
+                erase(point_, nextWord(point_));
+                break;
+            case 0x08:
+            case 0x7F:
+                erase(previousWord(point_), point_);
+                break;
+        }
+        return 2;
+    }
+
+    // CSI/SS3：参数和中间字节之后是结束字节
+    size_t end = pos + 2;
+    while (end < input_.size() && static_cast<unsigned char>(input_[end]) >= 0x20 &&
+           static_cast<unsigned char>(input_[end]) < 0x40) {
+        ++end;
+    }
+    if (end >= input_.size()) {
+        return 0;
+    }
+    std::string_view parameters(input_.data() + pos + 2, end - pos - 2);
+    char final = input_[end];
+    size_t used = end + 1 - pos;
+
+    if (input_.compare(pos, kPasteStart.size(), kPasteStart) == 0) {
+        size_t stop = input_.find(kPasteEnd, pos + kPasteStart.size());
+        if (stop == std::string::npos) {
+            return 0;
+        }
+        paste(std::string_view(input_).substr(pos + kPasteStart.size(), stop - pos - kPasteStart.size()));
+        return stop + kPasteEnd.size() - pos;
+    }
+
+    // 带修饰键（Ctrl/Alt）的左右方向键按词移动
+    bool word = parameters.find(';') != std::string_view::npos;
+    switch (final) {
+        case 'A':
+            showHistory(historyOffset_ + 1);
+            break;
+        case 'B':
+            showHistory(historyOffset_ - 1);
+            break;
+        case 'C':
+            if (word) {
+                point_ = nextWord(point_);
+            } else if (!acceptSuggestion()) {
+                point_ = nextCharacter(point_);
+            }
+            break;
+        case 'D':
+            point_ = word ? previousWord(point_) : previousCharacter(point_);
+            break;
+        case 'H':
+            point_ = 0;
+            break;
+        case 'F':
+            if (!acceptSuggestion()) {
+                point_ = line_.size();
+            }
+            break;
+        case '~':
+            if (parameters == "1" || parameters == "7") {
+                point_ = 0;
+            } else if (parameters == "4" || parameters == "8") {
+                if (!acceptSuggestion()) {
+                    point_ = line_.size();
+                }
+            } else if (parameters == "3") {
+                erase(point_, nextCharacter(point_));
+            }
+            break;
+    }
+    return used;
+}
+
+void LineEditor::paste(std::string_view text) {
+    // 换行统一为\n，其他控制字符（粘贴内容中的转义序列等）丢掉
+    std::string clean;
+    clean.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == '\r') {
+            clean += '\n';
+            if (i + 1 < text.size() && text[i + 1] == '\n') {
+                ++i;
+            }
+        } else if (!control(c) || c == '\n' || c == '\t') {
+            clean += static_cast<char>(c);
+        }
+    }
+    insert(clean);
+}
+
+void LineEditor::insert(std::string_view text) {
+    line_.insert(point_, text.data(), text.size());
+    point_ += text.size();
+}
+
+void LineEditor::erase(size_t from, size_t to) {
+    if (from < to) {
+        line_.erase(from, to - from);
+    }
+    point_ = from;
+}
+
+bool LineEditor::acceptSuggestion() {
+    if (point_ != line_.size() || line_.empty() || !callbacks_.suggest) {
+        return false;
+    }
+    std::string rest = callbacks_.suggest(line_);
+    if (rest.empty()) {
+        return false;
+    }
+    insert(rest);
+    return true;
+}
+
+void LineEditor::showHistory(size_t offset) {
+    std::string command;
+    if (offset == static_cast<size_t>(-1) ||
+        (offset > 0 && !(callbacks_.history && callbacks_.history(offset, command)))) {
+        out_ += '\a';
+        return;
+    }
+    // 离开正在编辑的行时保存它，回到底部时恢复
+    if (historyOffset_ == 0) {
+        savedLine_ = line_;
+    }
+    historyOffset_ = offset;
+    line_ = offset == 0 ? savedLine_ : command;
+    point_ = line_.size();
+}
+
+void LineEditor::complete() {
+    size_t start = point_;
+    std::string common;
+    std::string typed;
+    std::vector<std::string> candidates;
+    bool done = callbacks_.complete && callbacks_.complete(line_, point_, start, common, candidates, typed);
+    input_ += typed;
+    if (!done) {
+        return;
+    }
+    if (candidates.empty()) {
+        out_ += '\a';
+        return;
+    }
+
+    // 和readline相同：唯一的候选直接替换（目录之外加空格），否则先补全公共前缀，再按一次Tab列出
+    if (candidates.size() == 1) {
+        std::string text = candidates[0];
+        if (text.empty() || text.back() != '/') {
+            text += ' ';
+        }
+        erase(start, point_);
+        insert(text);
+    } else if (common.size() > point_ - start) {
+        erase(start, point_);
+        insert(common);
+    } else if (tabbed_) {
+        listCandidates(candidates);
+    } else {
+        out_ += '\a';
+    }
+}
+
+void LineEditor::listCandidates(const std::vector<std::string>& candidates) {
+    // 光标移到输入末尾后在下面列出，再重新画出提示符和输入
+    size_t point = point_;
+    render(true);
+    point_ = point;
+    if (renderer_.cursorColumn() == 0 || renderer_.cursorColumn() % columns_ != 0) {
+        out_ += "\r\n";
+    }
+    fresh_ = true;
+
+    if (candidates.size() > kQueryItems) {
+        out_ += "Display all " + std::to_string(candidates.size()) + " possibilities? (y or n)";
+        flush();
+        while (input_.empty() && !closed_) {
+            readInput(-1);
+        }
+        bool show = !input_.empty() && (input_[0] == 'y' || input_[0] == 'Y' || input_[0] == ' ');
+        input_.erase(0, input_.empty() ? 0 : 1);
+        out_ += "\r\n";
+        if (!show) {
+            return;
+        }
+    }
+
+    // 按列排列，和ls一样先竖后横
+    size_t width = 0;
+    for (const auto& candidate : candidates) {
+        width = std::max(width, textWidth(candidate));
+    }
+    width += 2;
+    size_t perRow = std::max<size_t>(1, columns_ / width);
+    size_t rows = (candidates.size() + perRow - 1) / perRow;
+    for (size_t row = 0; row < rows; ++row) {
+        for (size_t i = row; i < candidates.size(); i += rows) {
+            out_ += candidates[i];
+            if (i + rows < candidates.size()) {
+                out_.append(width - textWidth(candidates[i]), ' ');
+            }
+        }
+        out_ += "\r\n";
+    }
+}
+
+size_t LineEditor::previousCharacter(size_t pos) const {
+    if (pos == 0) {
+        return 0;
+    }
+    --pos;
+    while (pos > 0 && continuation(static_cast<unsigned char>(line_[pos]))) {
+        --pos;
+    }
+    return pos;
+}
+
+size_t LineEditor::nextCharacter(size_t pos) const {
+    if (pos >= line_.size()) {
+        return line_.size();
+    }
+    ++pos;
+    while (pos < line_.size() && continuation(static_cast<unsigned char>(line_[pos]))) {
+        ++pos;
+    }
+    return pos;
+}
+
+size_t LineEditor::previousWord(size_t pos) const {
+    while (pos > 0 && !wordCharacter(static_cast<unsigned char>(line_[pos - 1]))) {
+        --pos;
+    }
+    while (pos > 0 && wordCharacter(static_cast<unsigned char>(line_[pos - 1]))) {
+        --pos;
+    }
+    return pos;
+}
+
+size_t LineEditor::nextWord(size_t pos) const {
+    while (pos < line_.size() && !wordCharacter(static_cast<unsigned char>(line_[pos]))) {
+        ++pos;
+    }
+    while (pos < line_.size() && wordCharacter(static_cast<unsigned char>(line_[pos]))) {
+        ++pos;
+    }
+    return pos;
+}
+
+void LineEditor::render(bool final) {
+    if (final) {
+        point_ = line_.size();
+    }
+    // 只在光标位于输入末尾时建议；多行的命令只显示第一行
+    suggestion_.clear();
+    if (!final && point_ == line_.size() && !line_.empty() && callbacks_.suggest) {
+        suggestion_ = callbacks_.suggest(line_);
+        suggestion_.erase(std::min(suggestion_.find('\n'), suggestion_.size()));
+    }
+    if (resized) {
+        resized = 0;
+        columns_ = terminalColumns();
+    }
+
+    types_.clear();
+    if (callbacks_.highlight) {
+        callbacks_.highlight(line_, types_);
+    }
+    types_.resize(line_.size(), SyntaxType::NORMAL);
+    types_.resize(line_.size() + suggestion_.size(), SyntaxType::SUGGESTION);
+    size_t cursor = prepare(line_ + suggestion_, point_);
+
+    // 宽度变化后layout不再沿用屏幕上的内容，所以先记下光标在第几行
+    size_t row = renderer_.cursorRow();
+    if (!renderer_.layout(display_, promptWidth_, columns_)) {
+        return;     // 文本都已换成可打印的形式，不会发生
+    }
+    if (fresh_ || !renderer_.synced()) {
+        if (fresh_) {
+            out_ += prompt_;
+        } else {
+            // 回到提示符所在的行，清掉原来的输入后重画（终端改变宽度时已有的行可能重排，尽量而为）
+            if (row > 0) {
+                out_ += "\033[" + std::to_string(row) + "A";
+            }
+            out_ += "\r\033[J" + promptLine_;
+        }
+        renderer_.reset();
+        fresh_ = false;
+    }
+    renderer_.draw(displayTypes_, cursor, highlighter_, out_);
+    flush();
+}
+
+size_t LineEditor::prepare(const std::string& text, size_t point) {
+    display_.clear();
+    displayTypes_.clear();
+    size_t cursor = std::string::npos;
+    std::mbstate_t state{};
+    for (size_t i = 0; i < text.size();) {
+        if (i >= point && cursor == std::string::npos) {
+            cursor = display_.size();
+        }
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        size_t before = display_.size();
+        size_t length = 1;
+        if (control(c)) {
+            display_ += '^';
+            display_ += static_cast<char>(c ^ 0x40);
+        } else if (c < 0x80) {
+            display_ += static_cast<char>(c);
+        } else {
+            wchar_t wc;
+            state = std::mbstate_t{};
+            size_t n = std::mbrtowc(&wc, text.data() + i, text.size() - i, &state);
+            if (n == 0 || n > text.size() - i) {
+                display_ += '?';
+            } else {
+                length = n;
+                if (wcwidth(wc) > 0) {
+                    display_.append(text, i, n);
+                } else {
+                    display_ += '?';
+                }
+            }
+        }
+        displayTypes_.insert(displayTypes_.end(), display_.size() - before, types_[i]);
+        i += length;
+    }
+    return cursor == std::string::npos ? display_.size() : cursor;
+}
+
+void LineEditor::flush() {
+    size_t written = 0;
+    while (written < out_.size()) {
+        ssize_t n = write(STDOUT_FILENO, out_.data() + written, out_.size() - written);
+        if (n < 0 && errno != EINTR) {
+            break;
+        }
+        written += n > 0 ? n : 0;
+    }
+    out_.clear();
+}
+
+bool LineEditor::readInput(int timeoutMs) {
+    struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {callbacks_.refresh, POLLIN, 0}};
+    int ready = poll(fds, callbacks_.refresh >= 0 ? 2 : 1, timeoutMs);
+    if (ready == 0) {
+        return false;
+    }
+    if (ready < 0) {
+        return true;    // 被信号打断（尺寸变化）
+    }
+    if (callbacks_.refresh >= 0 && (fds[1].revents & POLLIN)) {
+        char buffer[64];
+        while (read(callbacks_.refresh, buffer, sizeof(buffer)) > 0) {
+        }
+        if (callbacks_.refreshed) {
+            callbacks_.refreshed();
+        }
+    }
+    if (fds[0].revents != 0) {
+        char buffer[4096];
+        ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (n > 0) {
+            input_.append(buffer, n);
+        } else if (n == 0 || (errno != EINTR && errno != EAGAIN)) {
+            closed_ = true;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,106 @@
+#ifndef LINE_EDITOR_H
+#define LINE_EDITOR_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include "line_renderer.h"
+
+// 不依赖readline的行编辑器（终端原始模式）
+//
+// 输入行和光标只在内存中修改；已经到达的按键全部处理完才画一帧，由LineRenderer和屏幕上的内容比较，
+// 只输出光标移动和变化的字符，整帧一次write()写出，慢速的SSH连接上每个按键只有一个小包。
+// 自动建议作为输入行后面的一段文本一起绘制；控制字符显示为^X，当前locale无法确定宽度的字符显示为?。
+// 支持括号粘贴：粘贴的内容原样插入，其中的换行不会执行命令。
+class LineEditor {
+public:
+    struct Callbacks {
+        // 每个字节的语法类型（与line等长）
+        std::function<void(const std::string& line, std::vector<SyntaxType>& types)> highlight;
+        // 光标在行尾时显示在后面的建议（以line开头的历史命令的剩余部分）
+        std::function<std::string(const std::string& line)> suggest;
+        // 距最新一条offset的历史命令（1为最新一条）；没有时返回false
+        std::function<bool(size_t offset, std::string& command)> history;
+        // 补全光标处的词：返回词的开头、替换它的文本（所有候选的公共前缀）和候选列表；
+        // 等待期间读到的按键放进typed，之后照常处理。被按键取消或超时时返回false
+        std::function<bool(const std::string& line, size_t point, size_t& start, std::string& common,
+                           std::vector<std::string>& candidates, std::string& typed)> complete;
+        // refresh可读时（后台的缓存有了新结果）调用refreshed，然后重画
+        int refresh = -1;
+        std::function<void()> refreshed;
+    };
+
+    LineEditor(const SyntaxHighlighter& highlighter, Callbacks callbacks);
+
+    LineEditor(const LineEditor&) = delete;
+    LineEditor& operator=(const LineEditor&) = delete;
+
+    // 标准输入和输出都是终端
+    static bool available();
+
+    // 显示提示符并读取一行；空行上的Ctrl-D和输入关闭时返回空串，Ctrl-C放弃当前输入
+    std::string readLine(const std::string& prompt);
+
+private:
+    enum class Result { CONTINUE, ACCEPT, CANCEL, END };
+
+    const SyntaxHighlighter& highlighter_;
+    Callbacks callbacks_;
+
+    // 正在编辑的行和光标（字节位置，总在字符开头）、当前显示的建议
+    std::string line_;
+    size_t point_ = 0;
+    std::string suggestion_;
+
+    // 浏览历史的位置（0为正在编辑的行）和离开时保存的输入
+    size_t historyOffset_ = 0;
+    std::string savedLine_;
+
+    // 已读入还没处理的字节；上一个按键是Tab（再按一次列出候选）
+    std::string input_;
+    bool tabbed_ = false;
+    bool closed_ = false;
+
+    // 提示符（fresh_时整个画出，重画时只画最后一行）和终端宽度
+    std::string prompt_;
+    std::string promptLine_;
+    size_t promptWidth_ = 0;
+    size_t columns_ = 80;
+    bool fresh_ = true;
+
+    // 屏幕上的输入行，以及这一帧要显示的文本（控制字符已换成可打印的形式）和每个字节的类型
+    LineRenderer renderer_;
+    std::vector<SyntaxType> types_;
+    std::string display_;
+    std::vector<SyntaxType> displayTypes_;
+    std::string out_;
+
+    // 处理input_中pos处的一个按键（或一段连续的普通字符），返回用掉的字节数；序列不完整时返回0
+    size_t dispatch(size_t pos, Result& result);
+    size_t dispatchEscape(size_t pos);
+    void paste(std::string_view text);
+
+    void insert(std::string_view text);
+    void erase(size_t from, size_t to);
+    bool acceptSuggestion();
+    void showHistory(size_t offset);
+    void complete();
+    void listCandidates(const std::vector<std::string>& candidates);
+
+    size_t previousCharacter(size_t pos) const;
+    size_t nextCharacter(size_t pos) const;
+    size_t previousWord(size_t pos) const;
+    size_t nextWord(size_t pos) const;
+
+    // 画出当前的行（final时不显示建议，光标放到末尾），写出攒下的输出
+    void render(bool final);
+    size_t prepare(const std::string& text, size_t point);
+    void flush();
+
+    // 等待输入（timeoutMs为-1时一直等）；超时返回false
+    bool readInput(int timeoutMs);
+};
+
+#endif // LINE_EDITOR_H
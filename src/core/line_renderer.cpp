@@ -0,0 +1,193 @@
+#include "line_renderer.h"
+#include <algorithm>
+#include <cwchar>
+
+namespace {
+
+bool continuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// 公共前缀的长度，退回到两边都是字符开头的位置
+size_t commonPrefix(const std::string& a, const std::string& b) {
+    size_t length = std::min(a.size(), b.size());
+    size_t i = std::mismatch(a.begin(), a.begin() + length, b.begin()).first - a.begin();
+    while (i > 0 && ((i < a.size() && continuation(a[i])) || (i < b.size() && continuation(b[i])))) {
+        --i;
+    }
+    return i;
+}
+
+} // namespace
+
+bool LineRenderer::layout(const std::string& text, size_t promptWidth, size_t columns) {
+    if (promptWidth != promptWidth_ || columns != width_) {
+        promptWidth_ = promptWidth;
+        width_ = columns;
+        synced_ = false;
+    }
+
+    size_t same = synced_ ? commonPrefix(text_, text) : 0;
+    nextColumns_.assign(columns_.begin(), columns_.begin() + (synced_ ? same : 0));
+    nextColumns_.resize(text.size() + 1);
+
+    size_t column = same > 0 ? columns_[same] : promptWidth;
+    std::mbstate_t state{};
+    for (size_t i = same; i < text.size();) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        size_t length = 1;
+        int width = 1;
+        if (c < 0x20 || c == 0x7F) {
+            return false;
+        }
+        if (c >= 0x80) {
+            wchar_t wc;
+            length = std::mbrtowc(&wc, text.data() + i, text.size() - i, &state);
+            if (length == 0 || length > text.size() - i) {
+                return false;
+            }
+            width = wcwidth(wc);
+            if (width <= 0) {
+                return false;
+            }
+        }
+        // 行末只剩一列时，双宽字符换到下一行
+        if (width == 2 && column % width_ == width_ - 1) {
+            ++column;
+        }
+        std::fill(nextColumns_.begin() + i, nextColumns_.begin() + i + length, column);
+        column += width;
+        i += length;
+    }
+    nextColumns_[text.size()] = column;
+    next_ = text;
+    return true;
+}
+
+void LineRenderer::adopt(size_t cursor) {
+    text_ = next_;
+    columns_ = nextColumns_;
+    cursor_ = columns_[std::min(cursor, text_.size())];
+    colored_ = false;
+    synced_ = true;
+}
+
+void LineRenderer::reset() {
+    text_.clear();
+    types_.clear();
+    columns_.assign(1, promptWidth_);
+    cursor_ = promptWidth_;
+    colored_ = true;
+    synced_ = true;
+}
+
+void LineRenderer::draw(const std::vector<SyntaxType>& types, size_t cursor, const SyntaxHighlighter& highlighter,
+                        std::string& out) {
+    size_t length = next_.size();
+    size_t old = text_.size();
+
+    // 第一个文本或类型不同的字节；颜色未知时从头画
+    size_t first = 0;
+    if (colored_) {
+        first = commonPrefix(text_, next_);
+        size_t typed = std::mismatch(types_.begin(), types_.begin() + first, types.begin()).first - types_.begin();
+        while (typed < first && typed > 0 && continuation(next_[typed])) {
+            --typed;
+        }
+        first = std::min(first, typed);
+    }
+
+    if (first < length || first < old) {
+        // 文本和类型都相同的后缀（不与前缀重叠）
+        size_t suffix = 0;
+        if (colored_) {
+            size_t limit = std::min(length, old) - first;
+            while (suffix < limit && next_[length - 1 - suffix] == text_[old - 1 - suffix] &&
+                   types[length - 1 - suffix] == types_[old - 1 - suffix]) {
+                ++suffix;
+            }
+            while (suffix > 0 && continuation(next_[length - suffix])) {
+                --suffix;
+            }
+        }
+
+        if (suffix > 0 && columns_[old] < width_ && nextColumns_[length] < width_) {
+            // 都在一行之内：插入或删除空位平移后缀，只写中间变化的部分
+            size_t oldWidth = columns_[old - suffix] - columns_[first];
+            size_t newWidth = nextColumns_[length - suffix] - nextColumns_[first];
+            moveTo(nextColumns_[first], out);
+            if (newWidth > oldWidth) {
+                out += "\033[" + std::to_string(newWidth - oldWidth) + "@";
+            }
+            write(first, length - suffix, types, highlighter, out);
+            if (newWidth < oldWidth) {
+                out += "\033[" + std::to_string(oldWidth - newWidth) + "P";
+            }
+            cursor_ = nextColumns_[length - suffix];
+        } else {
+            moveTo(nextColumns_[first], out);
+            write(first, length, types, highlighter, out);
+            cursor_ = nextColumns_[length];
+            // 正好写满一行时终端的光标停在行末等待换行，主动换到下一行，后面的相对移动才准确
+            if (length > first && cursor_ % width_ == 0) {
+                out += "\r\n";
+            }
+            if (columns_[old] > cursor_) {
+                out += columns_[old] / width_ == cursor_ / width_ ? "\033[K" : "\033[J";
+            }
+        }
+    }
+    moveTo(nextColumns_[std::min(cursor, length)], out);
+
+    text_.swap(next_);
+    columns_.swap(nextColumns_);
+    types_ = types;
+    colored_ = true;
+}
+
+void LineRenderer::moveTo(size_t column, std::string& out) {
+    if (column == cursor_) {
+        return;
+    }
+    size_t from = cursor_ / width_;
+    size_t to = column / width_;
+    if (to == from) {
+        out += column < cursor_ ? "\033[" + std::to_string(cursor_ - column) + "D"
+                                : "\033[" + std::to_string(column - cursor_) + "C";
+        cursor_ = column;
+        return;
+    }
+    if (to < from) {
+        out += "\033[" + std::to_string(from - to) + "A";
+    } else if (to > from) {
+        out += "\033[" + std::to_string(to - from) + "B";
+    }
+    out += "\r";
+    if (column % width_ > 0) {
+        out += "\033[" + std::to_string(column % width_) + "C";
+    }
+    cursor_ = column;
+}
+
+void LineRenderer::write(size_t from, size_t to, const std::vector<SyntaxType>& types,
+                         const SyntaxHighlighter& highlighter, std::string& out) {
+    // 开始时终端的属性未知；之后只在有属性时才RESET，普通文本不加控制序列
+    bool plain = false;
+    for (size_t i = from; i < to;) {
+        size_t run = i + 1;
+        while (run < to && types[run] == types[i]) {
+            ++run;
+        }
+        const std::string& sequence = highlighter.sequence(types[i]);
+        if (!plain) {
+            out += Colors::RESET;
+        }
+        out += sequence;
+        out.append(next_, i, run - i);
+        plain = sequence.empty();
+        i = run;
+    }
+    if (to > from && !plain) {
+        out += Colors::RESET;
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef LINE_RENDERER_H
+#define LINE_RENDERER_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "syntax_highlighter.h"
+
+// 输入行在终端上的增量绘制（实时语法高亮用）
+//
+// 记住屏幕上显示的文本、每个字节的语法类型和光标位置，每次只重画第一个不同的字节之后的部分；
+// 整行在终端的一行之内时，后面没有变化的部分用插入/删除字符平移，不重写。
+// 输出追加到调用者的缓冲区，由调用者一次写出。只处理可打印的文本（控制字符、制表符
+// 以及当前locale无法确定宽度的字符由调用者交给readline显示，或换成可打印的形式）。
+class LineRenderer {
+public:
+    // 计算text的位置（提示符最后一行占promptWidth列，终端宽columns列）；
+    // 和屏幕上相同的前缀不重新计算。有无法确定宽度的字符时返回false
+    bool layout(const std::string& text, size_t promptWidth, size_t columns);
+
+    // 是否知道屏幕上显示的内容；不知道时调用者先让readline画出文本，再调用adopt
+    bool synced() const { return synced_; }
+
+    // 屏幕上显示的是最近一次layout的文本（颜色未知），光标在cursor处
+    void adopt(size_t cursor);
+    
+    // 屏幕上刚画出提示符，输入行还是空的（在layout之后、draw之前调用）
+    void reset();
+
+    // 按types（每个字节一个）画出最近一次layout的文本并把光标放到cursor处，输出追加到out
+    void draw(const std::vector<SyntaxType>& types, size_t cursor, const SyntaxHighlighter& highlighter,
+              std::string& out);
+
+    // 其他输出改变了屏幕
+    void invalidate() { synced_ = false; }
+    
+    // 光标所在的列（从提示符最后一行的行首算起，跨行累计）和行
+    size_t cursorColumn() const { return cursor_; }
+    size_t cursorRow() const { return width_ > 0 ? cursor_ / width_ : 0; }
+
+private:
+    // 屏幕上的内容：文本、每个字节的类型（colored_为false时未知）、每个字节所在的列
+    // （从提示符最后一行的行首算起，跨行累计；最后多一项为文本末尾）和光标所在的列
+    std::string text_;
+    std::vector<SyntaxType> types_;
+    std::vector<size_t> columns_;
+    size_t cursor_ = 0;
+    bool colored_ = false;
+    bool synced_ = false;
+
+    size_t promptWidth_ = 0;
+    size_t width_ = 0;
+
+    // 最近一次layout的结果
+    std::string next_;
+    std::vector<size_t> nextColumns_;
+
+    void moveTo(size_t column, std::string& out);
+    void write(size_t from, size_t to, const std::vector<SyntaxType>& types,
+               const SyntaxHighlighter& highlighter, std::string& out);
+};
+
+#endif // LINE_RENDERER_H
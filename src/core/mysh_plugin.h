@@ -0,0 +1,69 @@
+#ifndef MYSH_PLUGIN_H
+#define MYSH_PLUGIN_H
+
+/*
+ * MyShell 可加载内置命令的C ABI
+ *
+ * 插件是一个共享库，为每个命令导出一个名为 <name>_builtin 的
+ * struct mysh_builtin 变量，然后在shell中执行：
+ *
+ *     enable -f ./libfoo.so foo
+ *
+ * 命令在shell进程内执行，不再fork/exec。本头文件只使用C类型，
+ * 插件可以用任意能生成C ABI的语言编写。
+ *
+ * 版本规则：主版本号不同即不兼容；同一主版本内只会在结构体末尾追加字段，
+ * 插件应先检查 host->abi_version 再使用新增字段。
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MYSH_PLUGIN_ABI_MAJOR 1
+#define MYSH_PLUGIN_ABI_MINOR 0
+#define MYSH_PLUGIN_ABI_VERSION ((MYSH_PLUGIN_ABI_MAJOR << 16) | MYSH_PLUGIN_ABI_MINOR)
+
+/* shell提供给插件的接口 */
+struct mysh_host {
+    uint32_t abi_version;
+    void* context;
+
+    /* 读取shell变量，返回的指针在下一次调用前有效；
+       未设置时返回NULL，设置为空值时返回""，可以据此区分两者 */
+    const char* (*get_env)(void* context, const char* name);
+    /* 设置/删除shell变量，成功返回0 */
+    int (*set_env)(void* context, const char* name, const char* value);
+    int (*unset_env)(void* context, const char* name);
+    /* 当前工作目录，返回的指针在下一次调用前有效 */
+    const char* (*get_cwd)(void* context);
+};
+
+/* 单次调用的参数和输入输出，fd已按命令行重定向设置好 */
+struct mysh_call {
+    int argc;
+    char** argv;        /* argv[0] 为命令名，以NULL结尾 */
+    int in_fd;
+    int out_fd;
+    int err_fd;
+};
+
+typedef int (*mysh_builtin_fn)(const struct mysh_host* host, const struct mysh_call* call);
+
+/* 插件导出的命令描述，符号名为 <name>_builtin */
+struct mysh_builtin {
+    uint32_t abi_version;       /* 填 MYSH_PLUGIN_ABI_VERSION */
+    const char* name;
+    const char* short_doc;      /* 用于help/enable列表，可为NULL */
+    mysh_builtin_fn run;        /* 返回值即命令退出码 */
+    int (*load)(const struct mysh_host* host);     /* 可选，加载时调用，非0表示失败 */
+    void (*unload)(const struct mysh_host* host);  /* 可选，卸载前调用 */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MYSH_PLUGIN_H */
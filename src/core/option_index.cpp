@@ -0,0 +1,397 @@
+#include "option_index.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+namespace {
+
+// 解析一个命令最多等待的时间和读取的输出
+constexpr int kCaptureTimeoutMs = 2000;
+constexpr size_t kMaxOutput = 1 << 20;
+constexpr size_t kMaxDescription = 80;
+
+const char* const kCacheMagic = "mysh-options 1";
+
+// 子进程使用固定的环境：英文输出便于解析，man直接输出到管道
+const char* const kChildEnvironment[] = {
+    "PATH=/usr/local/bin:/usr/bin:/bin",
+    "LANG=C",
+    "LC_ALL=C",
+    "MANPAGER=cat",
+    "PAGER=cat",
+    "MANWIDTH=120",
+    "COLUMNS=120",
+    nullptr,
+};
+
+// 执行命令，读取标准输出和标准错误；超时或输出过多时杀死整个进程组
+std::string capture(const std::vector<std::string>& argv) {
+    std::string output;
+
+    // 在fork之前准备好参数，子进程中只调用async-signal-safe的函数
+    std::vector<char*> args;
+    for (const std::string& arg : argv) {
+        args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    int fds[2];
+    if (pipe(fds) == -1) {
+        return output;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(fds[0]);
+        close(fds[1]);
+        return output;
+    }
+    if (pid == 0) {
+        setpgid(0, 0);
+        int null = open("/dev/null", O_RDONLY);
+        if (null != -1) {
+            dup2(null, STDIN_FILENO);
+        }
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(fds[1], STDERR_FILENO);
+        if (chdir("/") == -1) {
+            _exit(127);
+        }
+        execve(args[0], args.data(), const_cast<char* const*>(kChildEnvironment));
+        _exit(127);
+    }
+    close(fds[1]);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kCaptureTimeoutMs);
+    bool finished = false;
+    char buffer[65536];
+    while (output.size() < kMaxOutput) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+            break;
+        }
+        struct pollfd pfd = {fds[0], POLLIN, 0};
+        int ready = poll(&pfd, 1, static_cast<int>(remaining));
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            break;
+        }
+        ssize_t bytes = read(fds[0], buffer, sizeof(buffer));
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            finished = true;
+            break;
+        }
+        output.append(buffer, bytes);
+    }
+    close(fds[0]);
+
+    if (!finished) {
+        kill(-pid, SIGKILL);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+    }
+    return output;
+}
+
+// 去掉man输出中的退格加粗/下划线和终端颜色序列
+std::string stripFormatting(const std::string& text) {
+    std::string plain;
+    plain.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '\b') {
+            if (!plain.empty()) {
+                plain.pop_back();
+            }
+        } else if (c == '\033' && i + 1 < text.size() && text[i + 1] == '[') {
+            i += 2;
+            while (i < text.size() && !std::isalpha(static_cast<unsigned char>(text[i]))) {
+                ++i;
+            }
+        } else {
+            plain += c;
+        }
+    }
+    return plain;
+}
+
+bool isOptionChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_';
+}
+
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+bool fileKey(const std::string& path, int64_t& mtime, int64_t& size) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    size = static_cast<int64_t>(st.st_size);
+    return true;
+}
+
+} // namespace
+
+OptionIndex::OptionIndex() = default;
+
+OptionIndex::~OptionIndex() = default;
+
+void OptionIndex::setCacheDirectory(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cacheDirectory_ = directory;
+}
+
+OptionIndex::Options OptionIndex::lookup(const std::string& path, const std::atomic<bool>* stop) {
+    int64_t mtime = 0;
+    int64_t size = 0;
+    if (!fileKey(path, mtime, size)) {
+        return nullptr;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    Entry& entry = entries_[path];
+    if (entry.mtime != mtime || entry.size != size) {
+        // 第一次查找或可执行文件已经更新：先看磁盘缓存，没有再到后台解析
+        entry = Entry();
+        entry.mtime = mtime;
+        entry.size = size;
+        entry.pending = true;
+        lock.unlock();
+
+        Options cached = readCache(path, mtime, size);
+        if (!cached) {
+            queue_.post([this, path, mtime, size]() { generate(path, mtime, size); });
+        }
+
+        lock.lock();
+        Entry& current = entries_[path];
+        if (cached && current.mtime == mtime && current.size == size) {
+            current.options = cached;
+            current.pending = false;
+        }
+    }
+
+    // 等待后台解析完成；补全到期（stop被置位）时先返回，下次Tab再取结果
+    while (stop) {
+        auto it = entries_.find(path);
+        if (it == entries_.end() || !it->second.pending || stop->load()) {
+            break;
+        }
+        ready_.wait_for(lock, std::chrono::milliseconds(10));
+    }
+
+    auto it = entries_.find(path);
+    return it != entries_.end() && it->second.mtime == mtime ? it->second.options : nullptr;
+}
+
+void OptionIndex::generate(const std::string& path, int64_t mtime, int64_t size) {
+    std::vector<Option> options;
+
+    // 先读man手册，不执行命令本身；没有手册时才执行 --help
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    for (const char* man : {"/usr/bin/man", "/usr/local/bin/man", "/bin/man"}) {
+        if (access(man, X_OK) == 0) {
+            options = parse(capture({man, name}));
+            break;
+        }
+    }
+    if (options.empty()) {
+        options = parse(capture({path, "--help"}));
+    }
+
+    writeCache(path, mtime, size, options);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry& entry = entries_[path];
+        if (entry.mtime == mtime && entry.size == size) {
+            entry.options = std::make_shared<const std::vector<Option>>(std::move(options));
+            entry.pending = false;
+        }
+    }
+    ready_.notify_all();
+}
+
+std::vector<OptionIndex::Option> OptionIndex::parse(const std::string& text) {
+    std::vector<Option> options;
+
+    std::vector<std::string> lines;
+    std::istringstream iss(stripFormatting(text));
+    std::string line;
+    while (std::getline(iss, line)) {
+        lines.push_back(line);
+    }
+
+    // 选项行：缩进后以-开头，"-a, --all  说明" 或 "--color[=WHEN]  说明"；
+    // 说明可以在同一行（与选项隔两个以上空格），也可以在下一行（man手册的格式）
+    for (size_t i = 0; i < lines.size(); ++i) {
+        const std::string& current = lines[i];
+        size_t pos = current.find_first_not_of(" \t");
+        if (pos == std::string::npos || current[pos] != '-' || pos + 1 >= current.size() ||
+            !(isOptionChar(current[pos + 1]) || current[pos + 1] == '?')) {
+            continue;
+        }
+
+        std::vector<std::string> names;
+        while (pos < current.size() && current[pos] == '-') {
+            // 短选项一般只有一个字符，也有find的-name这样单个-的长选项
+            size_t start = pos;
+            pos += current[pos + 1] == '-' ? 2 : 1;
+            if (pos < current.size() && current[start + 1] != '-' && !isOptionChar(current[pos])) {
+                ++pos;
+            }
+            while (pos < current.size() && isOptionChar(current[pos])) {
+                ++pos;
+            }
+            std::string name = current.substr(start, pos - start);
+            if (name.size() >= 2 && name != "--" && name.back() != '-') {
+                names.push_back(name);
+            }
+            // 跳过参数（=ARG、[=ARG]、 ARG），直到逗号或两个空格
+            while (pos < current.size() && current[pos] != ',' &&
+                   !(current[pos] == ' ' && (pos + 1 >= current.size() || current[pos + 1] == ' ')) &&
+                   current[pos] != '\t') {
+                ++pos;
+            }
+            if (pos < current.size() && current[pos] == ',') {
+                pos = current.find_first_not_of(' ', pos + 1);
+                if (pos == std::string::npos) {
+                    break;
+                }
+            }
+        }
+        if (names.empty()) {
+            continue;
+        }
+
+        std::string description = pos < current.size() ? trim(current.substr(pos)) : "";
+        if (!description.empty() && description[0] == ':') {
+            description = trim(description.substr(1));  // python的 "-B     : 说明"
+        }
+        if (description.empty() && i + 1 < lines.size()) {
+            std::string next = trim(lines[i + 1]);
+            if (!next.empty() && next[0] != '-') {
+                description = next;
+            }
+        }
+        if (description.size() > kMaxDescription) {
+            // 截断时不切开UTF-8字符
+            size_t cut = kMaxDescription;
+            while (cut > 0 && (static_cast<unsigned char>(description[cut]) & 0xC0) == 0x80) {
+                --cut;
+            }
+            description = description.substr(0, cut) + "...";
+        }
+        for (const std::string& name : names) {
+            options.push_back({name, description});
+        }
+    }
+
+    // 同一个选项可能出现多次（例如用法和说明里），保留第一次的说明
+    std::stable_sort(options.begin(), options.end(),
+                     [](const Option& a, const Option& b) { return a.name < b.name; });
+    options.erase(std::unique(options.begin(), options.end(),
+                              [](const Option& a, const Option& b) { return a.name == b.name; }),
+                  options.end());
+    return options;
+}
+
+std::string OptionIndex::cacheFile(const std::string& path) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (cacheDirectory_.empty()) {
+        return "";
+    }
+    // 路径中的/换成%作为文件名
+    std::string name = path;
+    std::replace(name.begin(), name.end(), '/', '%');
+    return cacheDirectory_ + "/" + name;
+}
+
+OptionIndex::Options OptionIndex::readCache(const std::string& path, int64_t mtime, int64_t size) const {
+    std::string file = cacheFile(path);
+    if (file.empty()) {
+        return nullptr;
+    }
+    std::ifstream in(file);
+    std::string line;
+    if (!std::getline(in, line) || line != kCacheMagic) {
+        return nullptr;
+    }
+
+    // 第二行是路径、修改时间和大小，不一致说明可执行文件已经更新
+    std::ostringstream key;
+    key << path << '\t' << mtime << '\t' << size;
+    if (!std::getline(in, line) || line != key.str()) {
+        return nullptr;
+    }
+
+    auto options = std::make_shared<std::vector<Option>>();
+    while (std::getline(in, line)) {
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos) {
+            options->push_back({line, ""});
+        } else {
+            options->push_back({line.substr(0, tab), line.substr(tab + 1)});
+        }
+    }
+    return options;
+}
+
+void OptionIndex::writeCache(const std::string& path, int64_t mtime, int64_t size,
+                             const std::vector<Option>& options) const {
+    std::string file = cacheFile(path);
+    if (file.empty()) {
+        return;
+    }
+    std::string directory = file.substr(0, file.find_last_of('/'));
+    if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST) {
+        return;
+    }
+
+    // 先写临时文件再改名，其他shell不会读到写了一半的缓存
+    std::string temp = file + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream out(temp, std::ios::trunc);
+        if (!out) {
+            return;
+        }
+        out << kCacheMagic << '\n' << path << '\t' << mtime << '\t' << size << '\n';
+        for (const Option& option : options) {
+            out << option.name << '\t' << option.description << '\n';
+        }
+        if (!out) {
+            out.close();
+            unlink(temp.c_str());
+            return;
+        }
+    }
+    if (rename(temp.c_str(), file.c_str()) != 0) {
+        unlink(temp.c_str());
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef OPTION_INDEX_H
+#define OPTION_INDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <atomic>
+#include <cstdint>
+#include "task_queue.h"
+
+// 外部命令的选项索引（-x/--long 选项补全用）
+//
+// 每个可执行文件只在后台解析一次：先读man手册（不会执行命令本身），没有手册时再执行
+// "命令 --help"（标准输入为/dev/null，超时终止）。结果按可执行文件路径、修改时间和大小
+// 缓存在磁盘上（~/.mysh_options，每个命令一个文件），补全时从内存中查找，不会每次Tab都fork。
+class OptionIndex {
+public:
+    struct Option {
+        std::string name;           // -a、--all
+        std::string description;
+    };
+    // 按名字排序的选项
+    using Options = std::shared_ptr<const std::vector<Option>>;
+
+    OptionIndex();
+    ~OptionIndex();
+
+    OptionIndex(const OptionIndex&) = delete;
+    OptionIndex& operator=(const OptionIndex&) = delete;
+
+    // 设置磁盘缓存目录；为空时只缓存在内存中
+    void setCacheDirectory(const std::string& directory);
+
+    // 可执行文件的选项。还没有解析过时在后台解析，等待到完成或stop被置位
+    // （stop为空时不等待）；解析失败或还没完成时返回nullptr
+    Options lookup(const std::string& path, const std::atomic<bool>* stop);
+
+    // 从--help或man的输出中提取选项（按名字排序去重）
+    static std::vector<Option> parse(const std::string& text);
+
+private:
+    struct Entry {
+        int64_t mtime = 0;          // 纳秒
+        int64_t size = 0;
+        Options options;
+        bool pending = false;       // 正在后台解析
+    };
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::string cacheDirectory_;
+
+    // 最后声明，析构时先停止后台任务
+    TaskQueue queue_;
+
+    void generate(const std::string& path, int64_t mtime, int64_t size);
+    std::string cacheFile(const std::string& path) const;
+    Options readCache(const std::string& path, int64_t mtime, int64_t size) const;
+    void writeCache(const std::string& path, int64_t mtime, int64_t size, const std::vector<Option>& options) const;
+};
+
+#endif // OPTION_INDEX_H
@@ -1,8 +1,7 @@
 #include "parser.h"
-#include <sstream>
 #include <algorithm>
-#include <cctype>
 #include <cstdlib>
+#include <iostream>
 
 Parser::Parser() = default;
 Parser::~Parser() = default;
@@ -12,198 +11,119 @@ std::shared_ptr<Command> Parser::parse(const std::string& input) {
         return nullptr;
     }
     
-    // 检查是否包含管道
-    if (input.find('|') != std::string::npos) {
-        auto pipeline = parsePipeline(input);
+    // 词法分析
+    auto tokens = Lexer::tokenize(input);
+    
+    // 检查是否包含管道（引号内的|不算）
+    auto isPipe = [](const Token& token) { return token.kind == TokenKind::PIPE; };
+    if (std::any_of(tokens.begin(), tokens.end(), isPipe)) {
+        auto pipeline = parsePipeline(input, tokens);
         if (pipeline && !pipeline->commands.empty()) {
             return pipeline->commands[0]; // 暂时只返回第一个命令，后续完善管道处理
         }
         return nullptr;
     }
     
-    // 词法分析
-    auto tokens = tokenize(input);
-    if (tokens.empty()) {
-        return nullptr;
-    }
-    
     // 解析单个命令
-    return parseCommand(tokens);
+    bool error = false;
+    return parseCommand(input, tokens, 0, tokens.size(), error);
 }
 
 std::shared_ptr<PipelineCommand> Parser::parsePipeline(const std::string& input) {
-    auto pipeline = std::make_shared<PipelineCommand>();
-    
-    // 按管道符分割
-    std::istringstream iss(input);
-    std::string commandStr;
-    
-    while (std::getline(iss, commandStr, '|')) {
-        commandStr = trim(commandStr);
-        if (!commandStr.empty()) {
-            auto tokens = tokenize(commandStr);
-            if (!tokens.empty()) {
-                auto command = parseCommand(tokens);
-                if (command) {
-                    pipeline->commands.push_back(command);
-                }
-            }
-        }
-    }
-    
-    return pipeline;
+    return parsePipeline(input, Lexer::tokenize(input));
 }
 
-std::vector<std::string> Parser::tokenize(const std::string& input) {
-    std::vector<std::string> tokens;
-    std::string current;
-    bool inQuotes = false;
-    char quoteChar = '\0';
+std::shared_ptr<PipelineCommand> Parser::parsePipeline(const std::string& input, const std::vector<Token>& tokens) {
+    auto pipeline = std::make_shared<PipelineCommand>();
     
-    for (size_t i = 0; i < input.length(); ++i) {
-        char c = input[i];
-        
-        if (!inQuotes) {
-            if (c == '"' || c == '\'') {
-                inQuotes = true;
-                quoteChar = c;
-            } else if (std::isspace(c)) {
-                if (!current.empty()) {
-                    tokens.push_back(expandVariables(current));
-                    current.clear();
-                }
-            } else if (isSpecialChar(c)) {
-                // 处理特殊字符
-                if (!current.empty()) {
-                    tokens.push_back(expandVariables(current));
-                    current.clear();
-                }
-                
-                // 处理重定向符号
-                if (c == '>' && i + 1 < input.length() && input[i + 1] == '>') {
-                    tokens.push_back(">>");
-                    ++i; // 跳过下一个字符
-                } else {
-                    tokens.push_back(std::string(1, c));
-                }
-            } else {
-                current += c;
-            }
-        } else {
-            if (c == quoteChar) {
-                inQuotes = false;
-                quoteChar = '\0';
-            } else {
-                current += c;
-            }
+    // 按管道符分割，任何一段有语法错误时整个管道无效
+    size_t first = 0;
+    for (size_t i = 0; i <= tokens.size(); ++i) {
+        if (i < tokens.size() && tokens[i].kind != TokenKind::PIPE) {
+            continue;
         }
+        bool error = false;
+        auto command = parseCommand(input, tokens, first, i, error);
+        if (error) {
+            return nullptr;
+        }
+        if (command) {
+            pipeline->commands.push_back(command);
+        }
+        first = i + 1;
     }
     
-    if (!current.empty()) {
-        tokens.push_back(expandVariables(current));
-    }
-    
-    return tokens;
+    return pipeline;
 }
 
-std::shared_ptr<Command> Parser::parseCommand(const std::vector<std::string>& tokens) {
-    if (tokens.empty()) {
+std::shared_ptr<Command> Parser::parseCommand(const std::string& input, const std::vector<Token>& tokens,
+                                              size_t first, size_t last, bool& error) {
+    auto text = [&input](const Token& token) {
+        return std::string_view(input).substr(token.start, token.end - token.start);
+    };
+    auto syntaxError = [&error](std::string_view message) {
+        std::cerr << "mysh: syntax error: " << message << std::endl;
+        error = true;
         return nullptr;
-    }
+    };
     
     auto command = std::make_shared<Command>();
-    command->command = tokens[0];
-    
-    for (size_t i = 1; i < tokens.size(); ++i) {
-        const std::string& token = tokens[i];
+    bool hasCommand = false;
+    for (size_t i = first; i < last && tokens[i].kind != TokenKind::COMMENT; ++i) {
+        const Token& token = tokens[i];
+        std::string_view op = text(token);
         
-        if (token == "<") {
-            // 输入重定向
-            if (i + 1 < tokens.size()) {
-                command->inputRedirect = tokens[++i];
-            }
-        } else if (token == ">") {
-            // 输出重定向
-            if (i + 1 < tokens.size()) {
-                command->outputRedirect = tokens[++i];
-                command->appendOutput = false;
-            }
-        } else if (token == ">>") {
-            // 追加输出重定向
-            if (i + 1 < tokens.size()) {
-                command->outputRedirect = tokens[++i];
-                command->appendOutput = true;
+        if (token.kind == TokenKind::WORD) {
+            // 普通的词：第一个是命令，其余是参数
+            std::string word = Lexer::unquote(op, expandVariable);
+            if (!hasCommand) {
+                command->command = std::move(word);
+                hasCommand = true;
+            } else {
+                command->arguments.push_back(std::move(word));
             }
-        } else if (token == "&") {
+        } else if (token.kind == TokenKind::BACKGROUND) {
             // 后台运行
             command->runInBackground = true;
+        } else if (token.kind == TokenKind::REDIRECT && op != "<<") {
+            // 重定向：后面必须是文件名
+            if (i + 1 >= last || tokens[i + 1].kind != TokenKind::WORD) {
+                return syntaxError("missing file name after '" + std::string(op) + "'");
+            }
+            std::string file = Lexer::unquote(text(tokens[++i]), expandVariable);
+            if (op == "<") {
+                command->inputRedirect = std::move(file);
+            } else if (op == ">" || op == ">>") {
+                command->outputRedirect = std::move(file);
+                command->appendOutput = op == ">>";
+            } else if (op == "2>" || op == "2>>") {
+                command->errorRedirect = std::move(file);
+                command->appendError = op == "2>>";
+                command->errorToOutput = false;
+            } else {
+                // &>：标准输出和错误输出写到同一个文件
+                command->outputRedirect = std::move(file);
+                command->appendOutput = false;
+                command->errorRedirect.clear();
+                command->errorToOutput = true;
+            }
         } else {
-            // 普通参数
-            command->arguments.push_back(token);
+            // 分词器认识但还不支持的操作符：&& || ; <<
+            return syntaxError("'" + std::string(op) + "' is not supported");
         }
     }
     
-    return command;
-}
-
-std::string Parser::handleQuotes(const std::string& token) {
-    if (token.length() < 2) {
-        return token;
-    }
-    
-    char first = token[0];
-    char last = token[token.length() - 1];
-    
-    if ((first == '"' && last == '"') || (first == '\'' && last == '\'')) {
-        return token.substr(1, token.length() - 2);
-    }
-    
-    return token;
-}
-
-std::string Parser::expandVariables(const std::string& input) {
-    std::string result = input;
-    size_t pos = 0;
-    
-    while ((pos = result.find('$', pos)) != std::string::npos) {
-        if (pos + 1 >= result.length()) {
-            break;
-        }
-        
-        size_t start = pos + 1;
-        size_t end = start;
-        
-        // 找到变量名的结束位置
-        while (end < result.length() && 
-               (std::isalnum(result[end]) || result[end] == '_')) {
-            ++end;
-        }
-        
-        if (end > start) {
-            std::string varName = result.substr(start, end - start);
-            char* value = getenv(varName.c_str());
-            std::string replacement = value ? value : "";
-            
-            result.replace(pos, end - pos, replacement);
-            pos += replacement.length();
-        } else {
-            ++pos;
+    if (!hasCommand) {
+        if (command->runInBackground || !command->inputRedirect.empty() || !command->outputRedirect.empty() ||
+            !command->errorRedirect.empty()) {
+            return syntaxError("missing command");
         }
+        return nullptr;
     }
-    
-    return result;
+    return command;
 }
 
-bool Parser::isSpecialChar(char c) {
-    return c == '<' || c == '>' || c == '&' || c == '|';
+std::string Parser::expandVariable(const std::string& name) {
+    char* value = getenv(name.c_str());
+    return value ? value : "";
 }
-
-std::string Parser::trim(const std::string& str) {
-    size_t start = str.find_first_not_of(" \t\n\r");
-    if (start == std::string::npos) {
-        return "";
-    }
-    
-    size_t end = str.find_last_not_of(" \t\n\r");
-    return str.substr(start, end - start + 1);
-}
\ No newline at end of file
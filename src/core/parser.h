@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include "lexer.h"
 
 // 命令结构体
 struct Command {
@@ -12,9 +13,12 @@ struct Command {
     std::string inputRedirect;              // 输入重定向文件
     std::string outputRedirect;             // 输出重定向文件
     bool appendOutput;                      // 是否追加输出 (>>)
+    std::string errorRedirect;              // 错误输出重定向文件 (2> 2>>)
+    bool appendError;                       // 是否追加错误输出 (2>>)
+    bool errorToOutput;                     // 错误输出写到标准输出的位置 (&>)
     bool runInBackground;                   // 是否后台运行 (&)
     
-    Command() : appendOutput(false), runInBackground(false) {}
+    Command() : appendOutput(false), appendError(false), errorToOutput(false), runInBackground(false) {}
 };
 
 // 管道命令结构体
@@ -29,30 +33,22 @@ public:
     Parser();
     ~Parser();
     
-    // 解析命令行字符串
+    // 解析命令行字符串；语法错误（包括还不支持的 && || ; <<）时输出错误信息并返回nullptr
     std::shared_ptr<Command> parse(const std::string& input);
     
     // 解析管道命令
     std::shared_ptr<PipelineCommand> parsePipeline(const std::string& input);
     
 private:
-    // 词法分析 - 将输入分解为tokens
-    std::vector<std::string> tokenize(const std::string& input);
+    std::shared_ptr<PipelineCommand> parsePipeline(const std::string& input, const std::vector<Token>& tokens);
     
-    // 解析单个命令
-    std::shared_ptr<Command> parseCommand(const std::vector<std::string>& tokens);
+    // 解析单个命令：input的词法元素[first, last)，注释之后的忽略。按元素的种类识别操作符，
+    // 引号内的 > 等是普通参数。没有命令时返回nullptr，error为true表示语法错误（已输出错误信息）
+    std::shared_ptr<Command> parseCommand(const std::string& input, const std::vector<Token>& tokens,
+                                          size_t first, size_t last, bool& error);
     
-    // 处理引号
-    std::string handleQuotes(const std::string& token);
-    
-    // 处理环境变量替换
-    std::string expandVariables(const std::string& input);
-    
-    // 检查是否是特殊字符
-    bool isSpecialChar(char c);
-    
-    // 去除字符串两端空白
-    std::string trim(const std::string& str);
+    // 环境变量的值（未设置时为空）
+    static std::string expandVariable(const std::string& name);
 };
 
 #endif // PARSER_H
\ No newline at end of file
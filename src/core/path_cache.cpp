@@ -0,0 +1,120 @@
+#include "path_cache.h"
+#include "lexer.h"
+#include <cerrno>
+#include <cstdlib>
+#include <iterator>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+// 结果在这段时间内直接使用，之后查询时在后台重新检查
+constexpr auto kFresh = std::chrono::seconds(2);
+
+// 超过这么多条时丢掉所有已有的结果（正在检查的除外）
+constexpr size_t kMaxEntries = 4096;
+
+} // namespace
+
+PathCache::PathCache() : shared_(std::make_shared<Shared>()) {}
+
+void PathCache::setListener(Listener listener) {
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    shared_->listener = std::move(listener);
+}
+
+void PathCache::expire() {
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    for (auto& entry : shared_->entries) {
+        entry.second.checked = Clock::time_point();
+    }
+}
+
+PathCache::State PathCache::lookup(std::string_view word) {
+    std::string path = resolve(word);
+    if (path.empty()) {
+        return State::UNKNOWN;
+    }
+
+    Clock::time_point now = Clock::now();
+    State known;
+    {
+        std::lock_guard<std::mutex> lock(shared_->mutex);
+        auto& entries = shared_->entries;
+        auto it = entries.find(path);
+        if (it != entries.end() && (it->second.pending || now - it->second.checked < kFresh)) {
+            return it->second.state;
+        }
+        if (it == entries.end()) {
+            if (entries.size() >= kMaxEntries) {
+                for (auto entry = entries.begin(); entry != entries.end();) {
+                    entry = entry->second.pending ? std::next(entry) : entries.erase(entry);
+                }
+            }
+            it = entries.emplace(path, Entry()).first;
+        }
+        it->second.pending = true;
+        known = it->second.state;
+    }
+
+    std::shared_ptr<Shared> shared = shared_;
+    queue_.post([shared, path]() {
+        State state = probe(path);
+        Listener listener;
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            auto it = shared->entries.find(path);
+            if (it == shared->entries.end()) {
+                return;
+            }
+            if (it->second.state != state) {
+                listener = shared->listener;
+            }
+            it->second.state = state;
+            it->second.checked = Clock::now();
+            it->second.pending = false;
+        }
+        if (listener) {
+            listener();
+        }
+    });
+    return known;
+}
+
+std::string PathCache::resolve(std::string_view word) const {
+    // 变量和通配符要到执行时才知道指什么
+    if (word.find_first_of("$*?[`") != std::string_view::npos) {
+        return "";
+    }
+    std::string path = Lexer::unquote(word);
+    if (path.empty()) {
+        return "";
+    }
+
+    if (path[0] == '~') {
+        // 只展开自己的主目录（~user需要查询用户数据库）
+        const char* home = getenv("HOME");
+        if (!home || (path.size() > 1 && path[1] != '/')) {
+            return "";
+        }
+        return home + path.substr(1);
+    }
+    if (path[0] != '/') {
+        if (directory_.empty()) {
+            return "";
+        }
+        return directory_ + "/" + path;
+    }
+    return path;
+}
+
+PathCache::State PathCache::probe(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return errno == ENOENT || errno == ENOTDIR ? State::MISSING : State::UNKNOWN;
+    }
+    if (S_ISREG(st.st_mode) && access(path.c_str(), X_OK) == 0) {
+        return State::EXECUTABLE;
+    }
+    return State::EXISTS;
+}
@@ -0,0 +1,71 @@
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include "task_queue.h"
+
+// 路径是否存在的缓存（语法高亮用）
+//
+// 查询从不访问文件系统：没有结果或结果已经过期的路径交给后台线程stat，先返回已知的结果
+// （第一次查询时为UNKNOWN）。后台得到的结果和原来不同时在后台线程中调用listener，
+// 由输入处理器重新高亮。stat卡在无响应的文件系统上时只是结果迟迟不来，不影响输入。
+class PathCache {
+public:
+    enum class State {
+        UNKNOWN,        // 还没有结果，或无法判断（没有权限、含有变量和通配符的词）
+        MISSING,
+        EXISTS,
+        EXECUTABLE      // 有执行权限的普通文件
+    };
+    using Listener = std::function<void()>;
+
+    PathCache();
+
+    PathCache(const PathCache&) = delete;
+    PathCache& operator=(const PathCache&) = delete;
+
+    // 相对路径的基准目录（每次显示提示符前设置）
+    void setDirectory(const std::string& directory) { directory_ = directory; }
+
+    // 结果变化时的通知（在后台线程中调用）
+    void setListener(Listener listener);
+
+    // 让所有结果过期：之后查询时仍返回原来的结果，同时在后台重新检查（执行命令后文件可能变化）
+    void expire();
+
+    // 命令行中的一个词（可以带引号、反斜杠和开头的~）所指的路径的状态
+    State lookup(std::string_view word);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        State state = State::UNKNOWN;
+        Clock::time_point checked;      // 得到结果的时间
+        bool pending = false;           // 已经交给后台线程，还没有结果
+    };
+
+    // 与后台任务共享，PathCache析构后还没结束的任务仍可安全地访问
+    struct Shared {
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;    // 按绝对路径
+        Listener listener;
+    };
+
+    std::shared_ptr<Shared> shared_;
+    std::string directory_;
+    TaskQueue queue_;                   // 最后声明，最先析构
+
+    // 词展开成绝对路径，无法判断时返回空串
+    std::string resolve(std::string_view word) const;
+
+    static State probe(const std::string& path);
+};
+
+#endif // PATH_CACHE_H
@@ -0,0 +1,198 @@
+#include "plugin_loader.h"
+#include "shell.h"
+#include <iostream>
+#include <cstdio>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+PluginLoader::PluginLoader(Shell* shell) : shell_(shell) {
+    host_.abi_version = MYSH_PLUGIN_ABI_VERSION;
+    host_.context = this;
+    host_.get_env = hostGetEnv;
+    host_.set_env = hostSetEnv;
+    host_.unset_env = hostUnsetEnv;
+    host_.get_cwd = hostGetCwd;
+}
+
+PluginLoader::~PluginLoader() {
+    while (!builtins_.empty()) {
+        unload(builtins_.begin()->first);
+    }
+}
+
+bool PluginLoader::load(const std::string& path, const std::string& name, std::string& error) {
+    if (isLoaded(name)) {
+        error = name + ": already loaded";
+        return false;
+    }
+
+    // 不含'/'时dlopen会搜索系统库路径，这里与bash一致按相对路径处理
+    std::string file = path.find('/') == std::string::npos ? "./" + path : path;
+    void* handle = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        error = dlerror();
+        return false;
+    }
+
+    std::string symbol = name + "_builtin";
+    auto info = static_cast<const mysh_builtin*>(dlsym(handle, symbol.c_str()));
+    if (!info || !info->run) {
+        error = path + ": cannot find " + symbol;
+        dlclose(handle);
+        return false;
+    }
+
+    if ((info->abi_version >> 16) != MYSH_PLUGIN_ABI_MAJOR) {
+        error = path + ": incompatible plugin ABI version " + std::to_string(info->abi_version >> 16);
+        dlclose(handle);
+        return false;
+    }
+
+    if (info->load && info->load(&host_) != 0) {
+        error = name + ": plugin initialization failed";
+        dlclose(handle);
+        return false;
+    }
+
+    builtins_[name] = {path, handle, info};
+    return true;
+}
+
+bool PluginLoader::unload(const std::string& name) {
+    auto it = builtins_.find(name);
+    if (it == builtins_.end()) {
+        return false;
+    }
+
+    if (it->second.info->unload) {
+        it->second.info->unload(&host_);
+    }
+    dlclose(it->second.handle);
+    builtins_.erase(it);
+    return true;
+}
+
+bool PluginLoader::isLoaded(const std::string& name) const {
+    return builtins_.find(name) != builtins_.end();
+}
+
+int PluginLoader::run(std::shared_ptr<Command> command) {
+    auto it = builtins_.find(command->command);
+    if (it == builtins_.end()) {
+        return 1;
+    }
+
+    // 按重定向打开输入输出，插件直接写fd
+    int inFd = STDIN_FILENO;
+    int outFd = STDOUT_FILENO;
+    int errFd = STDERR_FILENO;
+    auto closeFds = [&]() {
+        if (inFd != STDIN_FILENO) {
+            close(inFd);
+        }
+        if (outFd != STDOUT_FILENO) {
+            close(outFd);
+        }
+        if (errFd != STDERR_FILENO && errFd != outFd) {
+            close(errFd);
+        }
+    };
+    if (!command->inputRedirect.empty()) {
+        inFd = open(command->inputRedirect.c_str(), O_RDONLY | O_CLOEXEC);
+        if (inFd == -1) {
+            perror("open input file");
+            return 1;
+        }
+    }
+    if (!command->outputRedirect.empty()) {
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (command->appendOutput ? O_APPEND : O_TRUNC);
+        outFd = open(command->outputRedirect.c_str(), flags, 0644);
+        if (outFd == -1) {
+            perror("open output file");
+            outFd = STDOUT_FILENO;
+            closeFds();
+            return 1;
+        }
+    }
+    if (!command->errorRedirect.empty()) {
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (command->appendError ? O_APPEND : O_TRUNC);
+        errFd = open(command->errorRedirect.c_str(), flags, 0644);
+        if (errFd == -1) {
+            perror("open error file");
+            errFd = STDERR_FILENO;
+            closeFds();
+            return 1;
+        }
+    } else if (command->errorToOutput) {
+        errFd = outFd;
+    }
+
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(command->command.c_str()));
+    for (auto& arg : command->arguments) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    mysh_call call;
+    call.argc = static_cast<int>(argv.size() - 1);
+    call.argv = argv.data();
+    call.in_fd = inFd;
+    call.out_fd = outFd;
+    call.err_fd = errFd;
+
+    // 插件绕过iostream直接写fd，先刷新缓冲保证输出顺序
+    std::cout.flush();
+    std::cerr.flush();
+    int status = it->second.info->run(&host_, &call);
+
+    closeFds();
+    return status;
+}
+
+std::vector<std::pair<std::string, std::string>> PluginLoader::list() const {
+    std::vector<std::pair<std::string, std::string>> result;
+    for (const auto& item : builtins_) {
+        result.emplace_back(item.first, item.second.path);
+    }
+    return result;
+}
+
+const char* PluginLoader::hostGetEnv(void* context, const char* name) {
+    auto loader = static_cast<PluginLoader*>(context);
+    if (!name) {
+        return nullptr;
+    }
+    // 未设置返回NULL，设置为空值返回""
+    if (!loader->shell_->hasEnvironmentVariable(name)) {
+        return nullptr;
+    }
+    loader->envBuffer_ = loader->shell_->getEnvironmentVariable(name);
+    return loader->envBuffer_.c_str();
+}
+
+int PluginLoader::hostSetEnv(void* context, const char* name, const char* value) {
+    auto loader = static_cast<PluginLoader*>(context);
+    if (!name || !*name) {
+        return -1;
+    }
+    loader->shell_->setEnvironmentVariable(name, value ? value : "");
+    return 0;
+}
+
+int PluginLoader::hostUnsetEnv(void* context, const char* name) {
+    auto loader = static_cast<PluginLoader*>(context);
+    if (!name || !*name) {
+        return -1;
+    }
+    loader->shell_->unsetEnvironmentVariable(name);
+    return 0;
+}
+
+const char* PluginLoader::hostGetCwd(void* context) {
+    auto loader = static_cast<PluginLoader*>(context);
+    loader->cwdBuffer_ = loader->shell_->getCurrentDirectory();
+    return loader->cwdBuffer_.c_str();
+}
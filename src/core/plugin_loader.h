@@ -0,0 +1,53 @@
+#ifndef PLUGIN_LOADER_H
+#define PLUGIN_LOADER_H
+
+#include "parser.h"
+#include "mysh_plugin.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+class Shell;
+
+// 通过dlopen加载的内置命令插件
+class PluginLoader {
+public:
+    explicit PluginLoader(Shell* shell);
+    ~PluginLoader();
+
+    // 从共享库加载名为name的命令，失败时error说明原因
+    bool load(const std::string& path, const std::string& name, std::string& error);
+
+    // 卸载命令
+    bool unload(const std::string& name);
+
+    bool isLoaded(const std::string& name) const;
+
+    // 在shell进程内执行插件命令
+    int run(std::shared_ptr<Command> command);
+
+    // 已加载的命令：名称 -> 共享库路径
+    std::vector<std::pair<std::string, std::string>> list() const;
+
+private:
+    struct LoadedBuiltin {
+        std::string path;
+        void* handle;
+        const mysh_builtin* info;
+    };
+
+    Shell* shell_;
+    mysh_host host_;
+    std::map<std::string, LoadedBuiltin> builtins_;
+    std::string envBuffer_;     // get_env/get_cwd返回值的存储
+    std::string cwdBuffer_;
+
+    // mysh_host回调
+    static const char* hostGetEnv(void* context, const char* name);
+    static int hostSetEnv(void* context, const char* name, const char* value);
+    static int hostUnsetEnv(void* context, const char* name);
+    static const char* hostGetCwd(void* context);
+};
+
+#endif // PLUGIN_LOADER_H
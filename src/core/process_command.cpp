@@ -0,0 +1,506 @@
+#include "builtin.h"
+#include "shell.h"
+#include "executor.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <cmath>
+#include <cerrno>
+#include <memory>
+
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+
+#ifdef PLATFORM_LINUX
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#endif
+
+namespace {
+
+// 解析时长：10、1.5s、500ms、2m、1h、1d
+bool parseDuration(const std::string& text, double& seconds) {
+    size_t end = 0;
+    double value;
+    try {
+        value = std::stod(text, &end);
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    std::string unit = text.substr(end);
+    if (unit.empty() || unit == "s") {
+        seconds = value;
+    } else if (unit == "ms") {
+        seconds = value / 1000.0;
+    } else if (unit == "m") {
+        seconds = value * 60.0;
+    } else if (unit == "h") {
+        seconds = value * 3600.0;
+    } else if (unit == "d") {
+        seconds = value * 86400.0;
+    } else {
+        return false;
+    }
+    return seconds >= 0 && std::isfinite(seconds);
+}
+
+int parseSignal(const std::string& text) {
+    static const std::pair<const char*, int> signals[] = {
+        {"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"KILL", SIGKILL},
+        {"USR1", SIGUSR1}, {"USR2", SIGUSR2}, {"ALRM", SIGALRM}, {"TERM", SIGTERM},
+    };
+
+    std::string name = text.compare(0, 3, "SIG") == 0 ? text.substr(3) : text;
+    for (const auto& sig : signals) {
+        if (name == sig.first) {
+            return sig.second;
+        }
+    }
+    try {
+        int number = std::stoi(name);
+        return number > 0 && number < NSIG ? number : -1;
+    } catch (const std::exception&) {
+        return -1;
+    }
+}
+
+// 剩余参数组成要执行的命令；单个带空格或'|'的参数按命令行解析，可用于管道：
+//   timeout 5 'curl -s host | grep ok'
+std::shared_ptr<PipelineCommand> buildPipeline(const std::vector<std::string>& args, size_t start) {
+    if (start + 1 == args.size() && args[start].find_first_of(" \t|") != std::string::npos) {
+        Parser parser;
+        return parser.parsePipeline(args[start]);
+    }
+
+    auto command = std::make_shared<Command>();
+    command->command = args[start];
+    command->arguments.assign(args.begin() + start + 1, args.end());
+
+    auto pipeline = std::make_shared<PipelineCommand>();
+    pipeline->commands.push_back(command);
+    return pipeline;
+}
+
+// 向被监控的进程发送信号：新进程组时发给整个组（包括孙进程）
+void signalTargets(const std::vector<pid_t>& pids, const std::vector<bool>& done, bool group, int sig) {
+    if (group) {
+        kill(-pids[0], sig);
+        if (sig != SIGKILL && sig != SIGCONT) {
+            kill(-pids[0], SIGCONT); // 唤醒被暂停的进程，使信号生效
+        }
+        return;
+    }
+    for (size_t i = 0; i < pids.size(); ++i) {
+        if (!done[i]) {
+            kill(pids[i], sig);
+        }
+    }
+}
+
+// 新进程组在终端的后台：收不到Ctrl-C，读终端时被SIGTTIN暂停。
+// shell拥有终端时把它交给子进程组（唤醒抢先读终端而被暂停的进程），结束后收回
+class TerminalHandoff {
+public:
+    explicit TerminalHandoff(pid_t pgid) {
+        if (isatty(STDIN_FILENO) && tcgetpgrp(STDIN_FILENO) == getpgrp() && tcsetpgrp(STDIN_FILENO, pgid) == 0) {
+            handedOver_ = true;
+            kill(-pgid, SIGCONT);
+        }
+    }
+
+    ~TerminalHandoff() {
+        if (!handedOver_) {
+            return;
+        }
+        // 此时shell自己在后台，调用tcsetpgrp会收到SIGTTOU
+        struct sigaction ignore = {};
+        struct sigaction old;
+        ignore.sa_handler = SIG_IGN;
+        sigemptyset(&ignore.sa_mask);
+        sigaction(SIGTTOU, &ignore, &old);
+        tcsetpgrp(STDIN_FILENO, getpgrp());
+        sigaction(SIGTTOU, &old, nullptr);
+    }
+
+    TerminalHandoff(const TerminalHandoff&) = delete;
+    TerminalHandoff& operator=(const TerminalHandoff&) = delete;
+
+private:
+    bool handedOver_ = false;
+};
+
+volatile sig_atomic_t interrupted = 0;
+
+void onInterrupt(int) {
+    interrupted = 1;
+}
+
+// 等待seconds秒；shell平时忽略SIGINT，等待期间临时捕获它，按Ctrl-C立即返回false
+bool interruptibleSleep(double seconds) {
+    using Clock = std::chrono::steady_clock;
+    auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+
+    // 检查标志和开始等待之间到达的信号由pselect原子地解除阻塞后处理
+    sigset_t block;
+    sigset_t original;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigprocmask(SIG_BLOCK, &block, &original);
+    struct sigaction action = {};
+    struct sigaction old;
+    action.sa_handler = onInterrupt;
+    sigemptyset(&action.sa_mask);
+    interrupted = 0;
+    sigaction(SIGINT, &action, &old);
+
+    sigset_t waitMask = original;
+    sigdelset(&waitMask, SIGINT);
+    while (!interrupted) {
+        auto left = deadline - Clock::now();
+        if (left <= Clock::duration::zero()) {
+            break;
+        }
+        auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+        struct timespec timeout = {static_cast<time_t>(nanoseconds / 1000000000),
+                                   static_cast<long>(nanoseconds % 1000000000)};
+        pselect(0, nullptr, nullptr, nullptr, &timeout, &waitMask);
+    }
+
+    sigaction(SIGINT, &old, nullptr);
+    sigprocmask(SIG_SETMASK, &original, nullptr);
+    return !interrupted;
+}
+
+struct TimeoutResult {
+    int status = 0;         // 最后一个命令的waitpid状态
+    bool timedOut = false;
+    bool killed = false;
+};
+
+#ifdef PLATFORM_LINUX
+// 用pidfd等待进程退出、用timerfd计时，一次poll同时等待两者，不需要信号处理或轮询
+bool waitWithPidfd(const std::vector<pid_t>& pids, bool group, double duration,
+                   int sig, double killAfter, TimeoutResult& result) {
+#ifdef SYS_pidfd_open
+    std::vector<int> pidfds;
+    for (pid_t pid : pids) {
+        int fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+        if (fd == -1) {
+            for (int opened : pidfds) {
+                close(opened);
+            }
+            return false; // 内核不支持pidfd，退回轮询实现
+        }
+        pidfds.push_back(fd);
+    }
+
+    int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timerFd == -1) {
+        for (int fd : pidfds) {
+            close(fd);
+        }
+        return false;
+    }
+
+    auto arm = [timerFd](double seconds) {
+        struct itimerspec spec = {};
+        spec.it_value.tv_sec = static_cast<time_t>(seconds);
+        spec.it_value.tv_nsec = static_cast<long>((seconds - spec.it_value.tv_sec) * 1e9);
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+            spec.it_value.tv_nsec = 1; // 0表示解除定时器
+        }
+        timerfd_settime(timerFd, 0, &spec, nullptr);
+    };
+
+    bool timerArmed = duration > 0;
+    if (timerArmed) {
+        arm(duration);
+    }
+
+    std::vector<bool> done(pids.size(), false);
+    size_t remaining = pids.size();
+
+    while (remaining > 0) {
+        std::vector<struct pollfd> fds;
+        std::vector<size_t> owners;
+        for (size_t i = 0; i < pids.size(); ++i) {
+            if (!done[i]) {
+                fds.push_back({pidfds[i], POLLIN, 0});
+                owners.push_back(i);
+            }
+        }
+        if (timerArmed) {
+            fds.push_back({timerFd, POLLIN, 0});
+        }
+
+        if (poll(fds.data(), fds.size(), -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for (size_t j = 0; j < owners.size(); ++j) {
+            if (fds[j].revents & (POLLIN | POLLHUP)) {
+                size_t i = owners[j];
+                int status = 0;
+                waitpid(pids[i], &status, 0);
+                if (i + 1 == pids.size()) {
+                    result.status = status;
+                }
+                done[i] = true;
+                --remaining;
+            }
+        }
+
+        if (timerArmed && (fds.back().revents & POLLIN)) {
+            uint64_t expirations;
+            if (read(timerFd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+                continue;
+            }
+
+            if (!result.timedOut) {
+                // 第一次超时：发送指定信号，如果设置了-k则稍后升级为KILL
+                result.timedOut = true;
+                signalTargets(pids, done, group, sig);
+                timerArmed = killAfter > 0 && sig != SIGKILL;
+                if (timerArmed) {
+                    arm(killAfter);
+                }
+            } else {
+                result.killed = true;
+                signalTargets(pids, done, group, SIGKILL);
+                timerArmed = false;
+            }
+        }
+    }
+
+    close(timerFd);
+    for (int fd : pidfds) {
+        close(fd);
+    }
+    return true;
+#else
+    (void)pids; (void)group; (void)duration; (void)sig; (void)killAfter; (void)result;
+    return false;
+#endif
+}
+#endif
+
+// 通用实现：WNOHANG轮询
+void waitWithPolling(const std::vector<pid_t>& pids, bool group, double duration,
+                     int sig, double killAfter, TimeoutResult& result) {
+    using Clock = std::chrono::steady_clock;
+    auto toDuration = [](double seconds) {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    };
+
+    Clock::time_point deadline = Clock::now() + toDuration(duration);
+    bool deadlineArmed = duration > 0;
+    std::vector<bool> done(pids.size(), false);
+    size_t remaining = pids.size();
+
+    while (remaining > 0) {
+        for (size_t i = 0; i < pids.size(); ++i) {
+            int status = 0;
+            if (!done[i] && waitpid(pids[i], &status, WNOHANG) == pids[i]) {
+                if (i + 1 == pids.size()) {
+                    result.status = status;
+                }
+                done[i] = true;
+                --remaining;
+            }
+        }
+
+        if (remaining > 0 && deadlineArmed && Clock::now() >= deadline) {
+            if (!result.timedOut) {
+                result.timedOut = true;
+                signalTargets(pids, done, group, sig);
+                deadlineArmed = killAfter > 0 && sig != SIGKILL;
+                deadline = Clock::now() + toDuration(killAfter);
+            } else {
+                result.killed = true;
+                signalTargets(pids, done, group, SIGKILL);
+                deadlineArmed = false;
+            }
+        }
+
+        if (remaining > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+}
+
+} // namespace
+
+int BuiltinCommands::cmdTimeout(std::shared_ptr<Command> command) {
+    const auto& args = command->arguments;
+    int sig = SIGTERM;
+    double killAfter = 0;
+    bool foreground = false;
+    size_t i = 0;
+
+    for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; ++i) {
+        if (args[i] == "-s" && i + 1 < args.size()) {
+            sig = parseSignal(args[++i]);
+            if (sig == -1) {
+                std::cerr << "timeout: invalid signal '" << args[i] << "'" << std::endl;
+                return 125;
+            }
+        } else if (args[i] == "-k" && i + 1 < args.size()) {
+            if (!parseDuration(args[++i], killAfter)) {
+                std::cerr << "timeout: invalid duration '" << args[i] << "'" << std::endl;
+                return 125;
+            }
+        } else if (args[i] == "--foreground") {
+            foreground = true;
+        } else {
+            break;
+        }
+    }
+
+    double duration;
+    if (i + 1 >= args.size() || !parseDuration(args[i], duration)) {
+        std::cerr << "timeout: usage: timeout [-s SIGNAL] [-k DURATION] [--foreground] DURATION command [args...]" << std::endl;
+        return 125;
+    }
+
+    auto pipeline = buildPipeline(args, i + 1);
+    if (!pipeline || pipeline->commands.empty()) {
+        return 125;
+    }
+    if (pipeline->commands.size() == 1 && isBuiltinCommand(pipeline->commands[0]->command)) {
+        std::cerr << "timeout: " << pipeline->commands[0]->command << ": cannot time out a shell builtin" << std::endl;
+        return 126;
+    }
+
+    // 默认放入新进程组，超时时整个管道连同孙进程一起终止；
+    // --foreground时留在shell的进程组，可以读取终端，但只向直接子进程发信号
+    bool group = !foreground;
+    std::cout.flush();
+    auto pids = shell->getExecutor()->spawn(pipeline, group);
+    if (pids.empty()) {
+        return 127;
+    }
+
+    TimeoutResult result;
+    {
+        std::unique_ptr<TerminalHandoff> terminal;
+        if (group) {
+            terminal = std::make_unique<TerminalHandoff>(pids[0]);
+        }
+#ifdef PLATFORM_LINUX
+        if (!waitWithPidfd(pids, group, duration, sig, killAfter, result))
+#endif
+        {
+            waitWithPolling(pids, group, duration, sig, killAfter, result);
+        }
+    }
+
+    // 与coreutils相同：超时返回124，但命令被KILL终止（-s KILL或-k升级）时返回137
+    if (result.killed || (result.timedOut && sig == SIGKILL)) {
+        return 128 + SIGKILL;
+    }
+    if (result.timedOut) {
+        return 124;
+    }
+    return Executor::exitCode(result.status);
+}
+
+int BuiltinCommands::cmdRetry(std::shared_ptr<Command> command) {
+    const auto& args = command->arguments;
+    int attempts = 3;
+    std::string backoff = "exp";
+    double delay = 1.0;
+    double maxDelay = 60.0;
+    size_t i = 0;
+
+    for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; ++i) {
+        const std::string& option = args[i];
+        bool hasValue = i + 1 < args.size();
+        if (option == "-n" && hasValue) {
+            try {
+                attempts = std::stoi(args[++i]);
+            } catch (const std::exception&) {
+                attempts = 0;
+            }
+            if (attempts < 1) {
+                std::cerr << "retry: invalid attempt count '" << args[i] << "'" << std::endl;
+                return 2;
+            }
+        } else if (option == "--backoff" && hasValue) {
+            backoff = args[++i];
+            if (backoff != "exp" && backoff != "linear" && backoff != "none") {
+                std::cerr << "retry: unknown backoff '" << backoff << "' (exp, linear, none)" << std::endl;
+                return 2;
+            }
+        } else if ((option == "--delay" || option == "--max-delay") && hasValue) {
+            double& target = option == "--delay" ? delay : maxDelay;
+            if (!parseDuration(args[++i], target)) {
+                std::cerr << "retry: invalid duration '" << args[i] << "'" << std::endl;
+                return 2;
+            }
+        } else {
+            break;
+        }
+    }
+
+    if (i >= args.size()) {
+        std::cerr << "retry: usage: retry [-n N] [--backoff exp|linear|none] [--delay D] [--max-delay D] command [args...]" << std::endl;
+        return 2;
+    }
+
+    auto pipeline = buildPipeline(args, i);
+    if (!pipeline || pipeline->commands.empty()) {
+        return 2;
+    }
+
+    static std::mt19937 rng(std::random_device{}());
+    int status = 0;
+
+    for (int attempt = 1; attempt <= attempts; ++attempt) {
+        // 内置命令（如timeout）在shell内执行，其他命令交给执行器
+        if (pipeline->commands.size() == 1 && isBuiltinCommand(pipeline->commands[0]->command)) {
+            status = execute(pipeline->commands[0]);
+        } else {
+            std::cout.flush();
+            status = shell->getExecutor()->executePipeline(pipeline);
+        }
+
+        // 命令被Ctrl-C中断时不再重试
+        if (status == 0 || attempt == attempts || status == 128 + SIGINT) {
+            break;
+        }
+
+        // 退避时间按策略增长并封顶，再加随机抖动（一半固定、一半随机），
+        // 避免多个脚本同时重试时同步冲击同一服务
+        double wait = delay;
+        if (backoff == "exp") {
+            wait = delay * std::pow(2.0, attempt - 1);
+        } else if (backoff == "linear") {
+            wait = delay * attempt;
+        }
+        wait = std::min(wait, maxDelay);
+        wait = wait / 2 + std::uniform_real_distribution<double>(0, wait / 2)(rng);
+
+        std::ostringstream message;
+        message << "retry: attempt " << attempt << "/" << attempts << " failed (exit " << status
+                << "), retrying in " << std::fixed << std::setprecision(2) << wait << "s";
+        std::cerr << message.str() << std::endl;
+        if (!interruptibleSleep(wait)) {
+            std::cerr << std::endl;
+            return 128 + SIGINT;
+        }
+    }
+
+    return status;
+}
@@ -8,6 +8,9 @@
 #include "completion.h"
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
 
 #ifdef PLATFORM_WINDOWS
 #include "posix_compat.h"
@@ -17,6 +20,12 @@
 #include <sys/types.h>
 #endif
 
+#ifdef PLATFORM_WINDOWS
+#define environ _environ
+#else
+extern char** environ;
+#endif
+
 Shell::Shell() : shouldExit(false) {
     initialize();
 }
@@ -30,6 +39,19 @@ void Shell::initialize() {
     builtinCommands = std::make_unique<BuiltinCommands>(this);
     history = std::make_unique<History>();
     
+    // 与bash一样，HISTSIZE为负数表示不限制
+    size_t historySize;
+    const char* histSize = getenv("HISTSIZE");
+    if (histSize && History::parseSize(histSize, historySize)) {
+        history->setMaxSize(historySize);
+    }
+    
+    // HISTCONTROL的写法与bash相同（ignorespace:erasedups等）
+    const char* histControl = getenv("HISTCONTROL");
+    if (histControl) {
+        history->setControl(histControl);
+    }
+    
     // 重新启用InputHandler
     inputHandler = std::make_unique<InputHandler>(this);
     inputHandler->initialize();
@@ -62,6 +84,21 @@ void Shell::initialize() {
             environmentVariables["USER"] = std::string(pw->pw_name);
         }
     }
+    
+    // 变量名索引：继承的环境变量加上shell自己的变量
+    auto names = std::make_shared<std::vector<std::string>>();
+    for (char** entry = environ; entry && *entry; ++entry) {
+        const char* equals = strchr(*entry, '=');
+        if (equals && equals != *entry) {
+            names->emplace_back(*entry, equals - *entry);
+        }
+    }
+    for (const auto& variable : environmentVariables) {
+        names->push_back(variable.first);
+    }
+    std::sort(names->begin(), names->end());
+    names->erase(std::unique(names->begin(), names->end()), names->end());
+    std::atomic_store(&variableNames, VariableNames(std::move(names)));
 }
 
 int Shell::run() {
@@ -69,6 +106,9 @@ int Shell::run() {
     
     while (!shouldExit) {
         try {
+            // 合并其他会话追加的历史记录
+            history->sync();
+            
             // 显示提示符并读取输入
             std::string input = readInput();
             
@@ -82,12 +122,10 @@ int Shell::run() {
             
             // 添加到历史记录
             history->addCommand(input);
-            if (inputHandler) {
-                inputHandler->addHistory(input);
-            }
             
-            // 执行命令
-            executeCommand(input);
+            // 执行命令，记录退出码和耗时
+            int status = executeCommand(input);
+            history->finishCommand(status);
             
         } catch (const std::exception& e) {
             std::cerr << "Error: " << e.what() << std::endl;
@@ -128,9 +166,46 @@ std::string Shell::getEnvironmentVariable(const std::string& name) {
     return "";
 }
 
+bool Shell::hasEnvironmentVariable(const std::string& name) {
+    return environmentVariables.count(name) > 0 || getenv(name.c_str()) != nullptr;
+}
+
 void Shell::setEnvironmentVariable(const std::string& name, const std::string& value) {
     environmentVariables[name] = value;
     setenv(name.c_str(), value.c_str(), 1);
+    updateVariableNames(name, true);
+}
+
+void Shell::unsetEnvironmentVariable(const std::string& name) {
+    environmentVariables.erase(name);
+    unsetenv(name.c_str());
+    updateVariableNames(name, false);
+}
+
+Shell::VariableNames Shell::getVariableNames() const {
+    return std::atomic_load(&variableNames);
+}
+
+void Shell::updateVariableNames(const std::string& name, bool present) {
+    VariableNames current = std::atomic_load(&variableNames);
+    if (!current) {
+        return;     // 初始化时还没有建立索引
+    }
+    auto it = std::lower_bound(current->begin(), current->end(), name);
+    bool found = it != current->end() && *it == name;
+    if (found == present) {
+        return;
+    }
+    
+    // 复制后插入或删除一个名字再整体替换（变量通常只有几十到几百个）
+    auto names = std::make_shared<std::vector<std::string>>(*current);
+    auto position = names->begin() + (it - current->begin());
+    if (present) {
+        names->insert(position, name);
+    } else {
+        names->erase(position);
+    }
+    std::atomic_store(&variableNames, VariableNames(std::move(names)));
 }
 
 std::string Shell::getCurrentDirectory() {
@@ -189,8 +264,9 @@ void Shell::showWelcome() {
 }
 
 void Shell::showInputPrompt(const std::string& command) {
-    // 如果启用了语法高亮，显示高亮版本
-    if (inputHandler && inputHandler->isSyntaxHighlightEnabled() && !command.empty()) {
+    // 如果启用了语法高亮、输入时又没有实时高亮，显示高亮版本
+    if (inputHandler && inputHandler->isSyntaxHighlightEnabled() && !inputHandler->highlightsWhileTyping() &&
+        !command.empty()) {
         // 获取高亮版本的命令
         auto highlighter = inputHandler->getSyntaxHighlighter();
         if (highlighter) {
@@ -202,6 +278,18 @@ void Shell::showInputPrompt(const std::string& command) {
     }
 }
 
+bool Shell::isBuiltinCommand(const std::string& name) const {
+    return builtinCommands && builtinCommands->isBuiltinCommand(name);
+}
+
+std::vector<std::string> Shell::getBuiltinCommandNames() const {
+    return builtinCommands ? builtinCommands->getCommandNames() : std::vector<std::string>();
+}
+
+CompletionEngine* Shell::getCompletionEngine() {
+    return inputHandler ? inputHandler->getCompletionEngine() : nullptr;
+}
+
 void Shell::setCompletionEnabled(bool enabled) {
     if (inputHandler) {
         inputHandler->setCompletionEnabled(enabled);
@@ -214,10 +302,32 @@ void Shell::setSyntaxHighlightEnabled(bool enabled) {
     }
 }
 
+void Shell::setAutosuggestEnabled(bool enabled) {
+    if (inputHandler) {
+        inputHandler->setAutosuggestEnabled(enabled);
+    }
+}
+
 bool Shell::isCompletionEnabled() const {
     return inputHandler ? inputHandler->isCompletionEnabled() : false;
 }
 
 bool Shell::isSyntaxHighlightEnabled() const {
     return inputHandler ? inputHandler->isSyntaxHighlightEnabled() : false;
+}
+
+bool Shell::isAutosuggestEnabled() const {
+    return inputHandler ? inputHandler->isAutosuggestEnabled() : false;
+}
+
+bool Shell::loadTheme(const std::string& path, std::string& error) {
+    if (!inputHandler) {
+        error = "input handler not available";
+        return false;
+    }
+    return inputHandler->loadTheme(path, error);
+}
+
+std::string Shell::getThemePath() const {
+    return inputHandler ? inputHandler->getThemePath() : "";
 }
\ No newline at end of file
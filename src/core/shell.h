@@ -11,6 +11,7 @@ class Executor;
 class BuiltinCommands;
 class History;
 class InputHandler;
+class CompletionEngine;
 
 class Shell {
 public:
@@ -25,25 +26,51 @@ public:
     
     // 获取和设置环境变量
     std::string getEnvironmentVariable(const std::string& name);
+    // 变量是否已设置（值可以为空）
+    bool hasEnvironmentVariable(const std::string& name);
     void setEnvironmentVariable(const std::string& name, const std::string& value);
+    void unsetEnvironmentVariable(const std::string& name);
+    
+    // 所有变量名（shell变量和继承的环境变量），有序；设置和删除变量时整体替换，
+    // 补全线程拿到的快照不会再变化
+    using VariableNames = std::shared_ptr<const std::vector<std::string>>;
+    VariableNames getVariableNames() const;
     
     // 获取当前工作目录
     std::string getCurrentDirectory();
     
+    // 是否是内置命令（包括enable -f加载的）
+    bool isBuiltinCommand(const std::string& name) const;
+    
+    // 启动时注册的所有内置命令（有序；语法高亮和补全用）
+    std::vector<std::string> getBuiltinCommandNames() const;
+    
     // 获取历史记录对象
     History* getHistory() { return history.get(); }
     
+    // 获取执行器对象（供timeout/retry等内置命令启动外部进程）
+    Executor* getExecutor() { return executor.get(); }
+    
+    // 获取补全引擎（complete内置命令使用）
+    CompletionEngine* getCompletionEngine();
+    
     // 设置退出标志
     void setExitFlag(bool flag) { shouldExit = flag; }
     
     // 获取shell提示符
     std::string getPrompt();
     
-    // 启用/禁用自动补全和语法高亮
+    // 启用/禁用自动补全、语法高亮和自动建议
     void setCompletionEnabled(bool enabled);
     void setSyntaxHighlightEnabled(bool enabled);
+    void setAutosuggestEnabled(bool enabled);
     bool isCompletionEnabled() const;
     bool isSyntaxHighlightEnabled() const;
+    bool isAutosuggestEnabled() const;
+    
+    // 语法高亮的主题文件（空为默认配色）
+    bool loadTheme(const std::string& path, std::string& error);
+    std::string getThemePath() const;
 
 private:
     std::unique_ptr<Parser> parser;
@@ -53,12 +80,16 @@ private:
     std::unique_ptr<InputHandler> inputHandler;
     
     std::map<std::string, std::string> environmentVariables;
+    VariableNames variableNames;    // 用std::atomic_load/atomic_store读写
     std::string currentDirectory;
     bool shouldExit;
     
     // 初始化shell
     void initialize();
     
+    // 变量被设置或删除后更新有序的变量名列表
+    void updateVariableNames(const std::string& name, bool present);
+    
     // 读取用户输入
     std::string readInput();
     
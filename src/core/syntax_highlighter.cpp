@@ -1,9 +1,39 @@
 #include "syntax_highlighter.h"
+#include "lexer.h"
 #include <algorithm>
-#include <sstream>
-#include <filesystem>
+#include <iterator>
+#include <cstring>
+#include <cctype>
 
-namespace fs = std::filesystem;
+namespace {
+
+// highlight()的缓冲区超过这个大小时用完就释放（很长的粘贴内容）
+constexpr size_t kKeptBuffer = 1 << 20;
+
+// 短的文本按整块复制：目标缓冲区末尾留有一块的余量，多写的部分会被后面的输出覆盖
+constexpr size_t kChunk = 16;
+
+// 复制[from, to)：不超过一块、且源在end之前还有一整块可读时整块复制，不调用memcpy。
+// 读：整块复制只在[from, end)至少有kChunk字节时进行，不读end之后的内存。
+// 写：最多写到out + kChunk，超出out + size的部分要求目标缓冲区在输出之后还有kChunk字节的余量
+// （highlight()按worst分配），这些字节随后被覆盖或不计入结果
+inline char* copyText(char* out, const char* from, const char* to, const char* end) {
+    size_t size = to - from;
+    if (size <= kChunk && static_cast<size_t>(end - from) >= kChunk) {
+        std::memcpy(out, from, kChunk);
+    } else {
+        std::memcpy(out, from, size);
+    }
+    return out + size;
+}
+
+// 内置命令表的散列：长度和首尾字符，足以区分几十个内置命令
+inline size_t builtinHash(std::string_view word) {
+    return word.size() * 31 + static_cast<unsigned char>(word.front()) * 7 +
+           static_cast<unsigned char>(word.back());
+}
+
+} // namespace
 
 SyntaxHighlighter::SyntaxHighlighter() : enabled_(true) {
     initializeDefaultStyles();
@@ -14,144 +44,252 @@ std::string SyntaxHighlighter::highlight(const std::string& line) {
         return line;
     }
     
-    auto tokens = analyze(line);
-    std::string result;
+    // 每个元素最多增加一个控制序列和RESET，按最坏情况一次准备好缓冲区（在调用之间复用），
+    // 写入时不再检查容量；元素之间的空白和普通文本原样复制。末尾多留kChunk字节给整块复制多写的部分
+    constexpr size_t reset = std::char_traits<char>::length(Colors::RESET);
+    size_t worst = line.size() * (1 + longest_ + reset) + kChunk;
+    if (buffer_.size() < worst) {
+        buffer_.resize(worst);
+    }
+    char* out = &buffer_[0];
+    const char* text = line.data();
+    const char* end = text + line.size();
     
-    for (const auto& token : tokens) {
-        auto style = getStyle(token.first);
-        result += style.apply(token.second);
+    bool command = true;
+    const char* copied = text;
+    Token token;
+    for (size_t pos = 0; Lexer::next(line, pos, token); pos = token.end) {
+        size_t type = static_cast<size_t>(classify(line, token, command));
+        size_t length = sequences_[type].size();
+        if (length == 0) {
+            continue;
+        }
+        out = copyText(out, copied, text + token.start, end);
+        // 控制序列按整块复制，最多多读多写kChunk - 1字节：padded_中每个序列后面跟着kChunk个'\0'
+        // （setStyle()），多写的部分落在缓冲区的余量内，随后被元素的文本和RESET覆盖
+        const char* prefix = padded_.data() + paddedOffsets_[type];
+        for (size_t i = 0; i < length; i += kChunk) {
+            std::memcpy(out + i, prefix + i, kChunk);
+        }
+        out += length;
+        out = copyText(out, text + token.start, text + token.end, end);
+        std::memcpy(out, Colors::RESET, reset);
+        out += reset;
+        copied = text + token.end;
     }
+    std::memcpy(out, copied, end - copied);
+    out += end - copied;
     
+    std::string result(buffer_.data(), out - buffer_.data());
+    if (buffer_.size() > kKeptBuffer) {
+        std::string().swap(buffer_);
+    }
     return result;
 }
 
-void SyntaxHighlighter::setStyle(SyntaxType type, const HighlightStyle& style) {
-    styles_[type] = style;
+std::vector<HighlightSpan> SyntaxHighlighter::analyzeSpans(const std::string& line) {
+    std::vector<Token> tokens = Lexer::tokenize(line);
+    std::vector<HighlightSpan> spans;
+    update(line, tokens, {0, tokens.size(), 0}, spans);
+    return spans;
 }
 
-HighlightStyle SyntaxHighlighter::getStyle(SyntaxType type) const {
-    auto it = styles_.find(type);
-    if (it != styles_.end()) {
-        return it->second;
+size_t SyntaxHighlighter::update(const std::string& line, const std::vector<Token>& tokens, const LexChange& change,
+                                 std::vector<HighlightSpan>& spans) {
+    // spans和上次的元素一一对应：[0, first)不变，平移过来的元素在原来的位置是oldResume之后
+    size_t oldResume = spans.size() - (tokens.size() - change.resume);
+    std::vector<HighlightSpan> tail(spans.begin() + oldResume, spans.end());
+    spans.resize(change.first);
+    bool command = spans.empty() || nextCommand(spans.back().type, spans.back().command);
+    
+    // 重新分类，直到平移过来的元素处于和原来相同的命令位置，之后的结果不变
+    for (size_t i = change.first; i < tokens.size(); ++i) {
+        if (i >= change.resume && tail[i - change.resume].command == command) {
+            for (; i < tokens.size(); ++i) {
+                const HighlightSpan& old = tail[i - change.resume];
+                spans.push_back({tokens[i].start, tokens[i].end, old.type, old.command});
+            }
+            break;
+        }
+        HighlightSpan span{tokens[i].start, tokens[i].end, SyntaxType::NORMAL, command};
+        span.type = classify(line, tokens[i], command);
+        spans.push_back(span);
+    }
+    
+    return change.offset;
+}
+
+void SyntaxHighlighter::setStyle(SyntaxType type, const HighlightStyle& style) {
+    size_t index = static_cast<size_t>(type);
+    styles_[index] = style;
+    
+    // 颜色为RESET且没有其他属性就是普通文本，输出时不需要控制序列
+    std::string& sequence = sequences_[index];
+    sequence.clear();
+    if (style.color != Colors::RESET) {
+        sequence = style.color;
+    }
+    if (style.bold) sequence += Colors::BOLD;
+    if (style.dim) sequence += Colors::DIM;
+    if (style.underline) sequence += Colors::UNDERLINE;
+    
+    // highlight()按整块复制控制序列，每个序列后面留出一块的空余（按块读取不会越过padded_的末尾）
+    longest_ = 0;
+    padded_.clear();
+    for (size_t i = 0; i < kSyntaxTypeCount; ++i) {
+        longest_ = std::max(longest_, sequences_[i].size());
+        paddedOffsets_[i] = padded_.size();
+        padded_ += sequences_[i];
+        padded_.append(kChunk, '\0');
     }
-    return HighlightStyle(Colors::RESET);
 }
 
 void SyntaxHighlighter::setBuiltinCommands(const std::set<std::string>& commands) {
-    builtin_commands_ = commands;
+    builtin_names_.assign(commands.begin(), commands.end());
+    // 表的大小是2的幂（用&代替取模），并且至少是命令数的4倍，总有空位，查找的探测一定会结束
+    size_t capacity = 16;
+    while (capacity < builtin_names_.size() * 4) {
+        capacity *= 2;
+    }
+    builtin_table_.assign(capacity, kNoBuiltin);
+    for (uint32_t i = 0; i < builtin_names_.size(); ++i) {
+        if (builtin_names_[i].empty()) {
+            continue;
+        }
+        size_t slot = builtinHash(builtin_names_[i]) & (capacity - 1);
+        while (builtin_table_[slot] != kNoBuiltin) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        builtin_table_[slot] = i;
+    }
+}
+
+bool SyntaxHighlighter::isBuiltin(std::string_view word) const {
+    // builtinHash读取首尾字符，空词不能进入散列
+    if (builtin_table_.empty() || word.empty()) {
+        return false;
+    }
+    size_t mask = builtin_table_.size() - 1;
+    for (size_t slot = builtinHash(word) & mask; builtin_table_[slot] != kNoBuiltin; slot = (slot + 1) & mask) {
+        if (builtin_names_[builtin_table_[slot]] == word) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void SyntaxHighlighter::initializeDefaultStyles() {
     // 设置默认颜色方案
-    styles_[SyntaxType::COMMAND] = HighlightStyle(Colors::BRIGHT_GREEN, true);
-    styles_[SyntaxType::BUILTIN_COMMAND] = HighlightStyle(Colors::BRIGHT_BLUE, true);
-    styles_[SyntaxType::OPTION] = HighlightStyle(Colors::YELLOW);
-    styles_[SyntaxType::STRING] = HighlightStyle(Colors::GREEN);
-    styles_[SyntaxType::VARIABLE] = HighlightStyle(Colors::CYAN);
-    styles_[SyntaxType::PIPE] = HighlightStyle(Colors::BRIGHT_MAGENTA, true);
-    styles_[SyntaxType::REDIRECT] = HighlightStyle(Colors::BRIGHT_RED, true);
-    styles_[SyntaxType::BACKGROUND] = HighlightStyle(Colors::BRIGHT_YELLOW, true);
-    styles_[SyntaxType::COMMENT] = HighlightStyle(Colors::BRIGHT_BLACK);
-    styles_[SyntaxType::NUMBER] = HighlightStyle(Colors::BRIGHT_CYAN);
-    styles_[SyntaxType::PATH] = HighlightStyle(Colors::BLUE);
-    styles_[SyntaxType::OPERATOR] = HighlightStyle(Colors::MAGENTA);
-    styles_[SyntaxType::NORMAL] = HighlightStyle(Colors::RESET);
+    setStyle(SyntaxType::COMMAND, HighlightStyle(Colors::BRIGHT_GREEN, true));
+    setStyle(SyntaxType::BUILTIN_COMMAND, HighlightStyle(Colors::BRIGHT_BLUE, true));
+    setStyle(SyntaxType::UNKNOWN_COMMAND, HighlightStyle(Colors::RED, true));
+    setStyle(SyntaxType::OPTION, HighlightStyle(Colors::YELLOW));
+    setStyle(SyntaxType::STRING, HighlightStyle(Colors::GREEN));
+    setStyle(SyntaxType::VARIABLE, HighlightStyle(Colors::CYAN));
+    setStyle(SyntaxType::PIPE, HighlightStyle(Colors::BRIGHT_MAGENTA, true));
+    setStyle(SyntaxType::REDIRECT, HighlightStyle(Colors::BRIGHT_RED, true));
+    setStyle(SyntaxType::BACKGROUND, HighlightStyle(Colors::BRIGHT_YELLOW, true));
+    setStyle(SyntaxType::COMMENT, HighlightStyle(Colors::BRIGHT_BLACK));
+    setStyle(SyntaxType::NUMBER, HighlightStyle(Colors::BRIGHT_CYAN));
+    setStyle(SyntaxType::PATH, HighlightStyle(Colors::BLUE));
+    setStyle(SyntaxType::MISSING_PATH, HighlightStyle(Colors::BLUE, false, false, true));
+    setStyle(SyntaxType::OPERATOR, HighlightStyle(Colors::MAGENTA));
+    setStyle(SyntaxType::SUGGESTION, HighlightStyle(Colors::BRIGHT_BLACK));
+    setStyle(SyntaxType::NORMAL, HighlightStyle(Colors::RESET));
 }
 
-std::vector<std::pair<SyntaxType, std::string>> SyntaxHighlighter::analyze(const std::string& line) {
-    std::vector<std::pair<SyntaxType, std::string>> result;
-    
-    // 检查注释
-    size_t comment_pos = line.find('#');
-    std::string main_part = (comment_pos != std::string::npos) ? line.substr(0, comment_pos) : line;
-    std::string comment_part = (comment_pos != std::string::npos) ? line.substr(comment_pos) : "";
-    
-    // 分析主要部分
-    auto tokens = tokenize(main_part);
-    bool is_first_word = true;
-    
-    for (const auto& token : tokens) {
-        SyntaxType type = detectType(token, is_first_word);
-        result.emplace_back(type, token);
-        
-        if (is_first_word && type != SyntaxType::NORMAL) {
-            is_first_word = false;
-        }
+SyntaxType SyntaxHighlighter::classify(const std::string& line, const Token& token, bool& command) const {
+    SyntaxType type = SyntaxType::NORMAL;
+    switch (token.kind) {
+        case TokenKind::WORD:
+            type = detectType(std::string_view(line).substr(token.start, token.end - token.start), command);
+            break;
+        case TokenKind::PIPE: type = SyntaxType::PIPE; break;
+        case TokenKind::BACKGROUND: type = SyntaxType::BACKGROUND; break;
+        case TokenKind::REDIRECT: type = SyntaxType::REDIRECT; break;
+        case TokenKind::OR:
+        case TokenKind::AND:
+        case TokenKind::SEMICOLON: type = SyntaxType::OPERATOR; break;
+        case TokenKind::COMMENT: return SyntaxType::COMMENT;
     }
-    
-    // 添加注释部分
-    if (!comment_part.empty()) {
-        result.emplace_back(SyntaxType::COMMENT, comment_part);
+    command = nextCommand(type, command);
+    return type;
+}
+
+bool SyntaxHighlighter::nextCommand(SyntaxType type, bool command) {
+    // 管道、后台和;、&&之后是新的命令；重定向不改变
+    if (type == SyntaxType::PIPE || type == SyntaxType::BACKGROUND || type == SyntaxType::OPERATOR) {
+        return true;
     }
-    
-    return result;
+    return type == SyntaxType::REDIRECT ? command : false;
 }
 
-SyntaxType SyntaxHighlighter::detectType(const std::string& token, bool is_first_word) {
+SyntaxType SyntaxHighlighter::detectType(std::string_view token, bool is_first_word) const {
     if (token.empty()) {
         return SyntaxType::NORMAL;
     }
     
-    // 特殊字符
-    if (token == "|") return SyntaxType::PIPE;
-    if (token == "&") return SyntaxType::BACKGROUND;
-    if (isRedirection(token)) return SyntaxType::REDIRECT;
-    
-    // 选项
-    if (isOption(token)) return SyntaxType::OPTION;
-    
-    // 字符串
-    if (isString(token)) return SyntaxType::STRING;
-    
-    // 变量
-    if (isVariable(token)) return SyntaxType::VARIABLE;
+    // 按第一个字符分派，每个词只做可能成立的检查（操作符由词法分析区分）
+    switch (token[0]) {
+        case '-':
+            // 选项
+            if (isOption(token)) return SyntaxType::OPTION;
+            break;
+        case '"':
+        case '\'':
+            // 字符串（正在输入、还没有闭合的引号也算）
+            return SyntaxType::STRING;
+        case '$':
+            // 变量
+            return SyntaxType::VARIABLE;
+        default:
+            break;
+    }
     
     // 数字
     if (isNumber(token)) return SyntaxType::NUMBER;
     
     // 第一个词：命令
     if (is_first_word) {
-        if (builtin_commands_.find(token) != builtin_commands_.end()) {
+        if (isBuiltin(token)) {
             return SyntaxType::BUILTIN_COMMAND;
         }
+        if (command_lookup_ && command_lookup_(token) == Existence::MISSING) {
+            return SyntaxType::UNKNOWN_COMMAND;
+        }
         return SyntaxType::COMMAND;
     }
     
     // 路径
-    if (isPath(token)) return SyntaxType::PATH;
+    if (isPath(token)) {
+        if (path_lookup_ && path_lookup_(token) == Existence::MISSING) {
+            return SyntaxType::MISSING_PATH;
+        }
+        return SyntaxType::PATH;
+    }
     
     return SyntaxType::NORMAL;
 }
 
-bool SyntaxHighlighter::isOption(const std::string& token) {
+bool SyntaxHighlighter::isOption(std::string_view token) {
     return token.length() >= 2 && token[0] == '-' && 
-           (std::isalpha(token[1]) || token[1] == '-');
-}
-
-bool SyntaxHighlighter::isString(const std::string& token) {
-    return (token.length() >= 2) && 
-           ((token.front() == '"' && token.back() == '"') ||
-            (token.front() == '\'' && token.back() == '\''));
-}
-
-bool SyntaxHighlighter::isVariable(const std::string& token) {
-    return !token.empty() && token[0] == '$';
+           (std::isalpha(static_cast<unsigned char>(token[1])) || token[1] == '-');
 }
 
-bool SyntaxHighlighter::isPath(const std::string& token) {
-    return token.find('/') != std::string::npos || 
+bool SyntaxHighlighter::isPath(std::string_view token) {
+    return token.find('/') != std::string_view::npos || 
            token == "." || token == ".." ||
            (token.length() > 0 && token[0] == '~');
 }
 
-bool SyntaxHighlighter::isNumber(const std::string& token) {
+bool SyntaxHighlighter::isNumber(std::string_view token) {
     if (token.empty()) return false;
     
     size_t start = 0;
     if (token[0] == '-' || token[0] == '+') start = 1;
     
     for (size_t i = start; i < token.length(); ++i) {
-        if (!std::isdigit(token[i]) && token[i] != '.') {
+        if ((token[i] < '0' || token[i] > '9') && token[i] != '.') {
             return false;
         }
     }
@@ -159,101 +297,10 @@ bool SyntaxHighlighter::isNumber(const std::string& token) {
     return start < token.length();
 }
 
-bool SyntaxHighlighter::isRedirection(const std::string& token) {
-    return token == ">" || token == ">>" || token == "<" || 
-           token == "2>" || token == "2>>" || token == "&>";
-}
-
 std::vector<std::string> SyntaxHighlighter::tokenize(const std::string& line) {
     std::vector<std::string> tokens;
-    std::string current_token;
-    
-    for (size_t i = 0; i < line.length(); ++i) {
-        char c = line[i];
-        
-        // 处理引号
-        if (c == '"' || c == '\'') {
-            if (!current_token.empty() && current_token[0] != '"' && current_token[0] != '\'') {
-                // 当前token不是字符串，需要先保存
-                tokens.push_back(current_token);
-                current_token.clear();
-            }
-            
-            if (current_token.empty()) {
-                // 开始新的字符串token
-                current_token += c;
-                // 找到匹配的结束引号
-                size_t end = i + 1;
-                while (end < line.length() && line[end] != c) {
-                    current_token += line[end];
-                    end++;
-                }
-                if (end < line.length()) {
-                    current_token += line[end]; // 添加结束引号
-                    tokens.push_back(current_token);
-                    current_token.clear();
-                    i = end; // 跳过已处理的部分
-                }
-            } else if (current_token[0] == c) {
-                // 结束当前字符串token
-                current_token += c;
-                tokens.push_back(current_token);
-                current_token.clear();
-            }
-        }
-        // 处理操作符
-        else if (c == '|' || c == '&' || c == '>' || c == '<') {
-            // 保存之前的token
-            if (!current_token.empty()) {
-                tokens.push_back(current_token);
-                current_token.clear();
-            }
-            
-            // 处理多字符操作符
-            std::string op(1, c);
-            if (c == '>' && i + 1 < line.length() && line[i + 1] == '>') {
-                op = ">>";
-                i++; // 跳过下一个字符
-            } else if (c == '<' && i + 1 < line.length() && line[i + 1] == '<') {
-                op = "<<";
-                i++; // 跳过下一个字符
-            } else if (c == '&' && i + 1 < line.length() && line[i + 1] == '>') {
-                op = "&>";
-                i++; // 跳过下一个字符
-            } else if (c == '2') {
-                // 检查是否是2>或2>>
-                if (i + 1 < line.length() && line[i + 1] == '>') {
-                    op = "2>";
-                    i++; // 跳过下一个字符
-                    if (i + 1 < line.length() && line[i + 1] == '>') {
-                        op = "2>>";
-                        i++; // 跳过下一个字符
-                    }
-                } else {
-                    current_token += c;
-                    continue;
-                }
-            }
-            
-            tokens.push_back(op);
-        }
-        // 处理空格
-        else if (std::isspace(c)) {
-            if (!current_token.empty()) {
-                tokens.push_back(current_token);
-                current_token.clear();
-            }
-        }
-        // 其他字符
-        else {
-            current_token += c;
-        }
+    for (const Token& token : Lexer::tokenize(line)) {
+        tokens.push_back(line.substr(token.start, token.end - token.start));
     }
-    
-    // 保存最后一个token
-    if (!current_token.empty()) {
-        tokens.push_back(current_token);
-    }
-    
     return tokens;
-}
\ No newline at end of file
+}
@@ -2,16 +2,21 @@
 #define SYNTAX_HIGHLIGHTER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
+#include <array>
 #include <set>
-#include <regex>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include "lexer.h"
 
 // ANSI颜色代码
 namespace Colors {
     constexpr const char* RESET = "\033[0m";
     constexpr const char* BOLD = "\033[1m";
     constexpr const char* DIM = "\033[2m";
+    constexpr const char* UNDERLINE = "\033[4m";
     
     // 前景色
     constexpr const char* BLACK = "\033[30m";
@@ -38,6 +43,7 @@ namespace Colors {
 enum class SyntaxType {
     COMMAND,            // 命令
     BUILTIN_COMMAND,    // 内置命令
+    UNKNOWN_COMMAND,    // 找不到的命令
     OPTION,             // 选项 (-l, --help)
     STRING,             // 字符串 ("text", 'text')
     VARIABLE,           // 变量 ($VAR, ${VAR})
@@ -47,28 +53,49 @@ enum class SyntaxType {
     COMMENT,            // 注释 (#)
     NUMBER,             // 数字
     PATH,               // 文件路径
+    MISSING_PATH,       // 不存在的文件路径
     OPERATOR,           // 操作符
-    NORMAL              // 普通文本
+    SUGGESTION,         // 自动建议（光标后历史命令的剩余部分）
+    NORMAL              // 普通文本（最后一个）
 };
 
+constexpr size_t kSyntaxTypeCount = static_cast<size_t>(SyntaxType::NORMAL) + 1;
+
 // 高亮样式配置
 struct HighlightStyle {
     std::string color;
     bool bold = false;
     bool dim = false;
+    bool underline = false;
     
     HighlightStyle() = default;
-    HighlightStyle(const std::string& c, bool b = false, bool d = false) 
-        : color(c), bold(b), dim(d) {}
+    HighlightStyle(const std::string& c, bool b = false, bool d = false, bool u = false) 
+        : color(c), bold(b), dim(d), underline(u) {}
     
     std::string apply(const std::string& text) const {
         std::string style = color;
         if (bold) style += Colors::BOLD;
         if (dim) style += Colors::DIM;
+        if (underline) style += Colors::UNDERLINE;
         return style + text + Colors::RESET;
     }
 };
 
+// 命令或路径是否存在（由外部的缓存回答）
+enum class Existence {
+    UNKNOWN,            // 还不知道（按存在显示）
+    EXISTS,
+    MISSING
+};
+
+// 语法元素在行中的字节区间[start, end)
+struct HighlightSpan {
+    size_t start;
+    size_t end;
+    SyntaxType type;
+    bool command;       // 是否位于命令位置（行首或管道、;、&&之后）
+};
+
 // 语法高亮器
 class SyntaxHighlighter {
 public:
@@ -78,11 +105,26 @@ public:
     // 高亮整行命令
     std::string highlight(const std::string& line);
     
+    // 分析整行，返回各语法元素的区间（按位置排列，不含空白）
+    std::vector<HighlightSpan> analyzeSpans(const std::string& line);
+    
+    // 增量分析：tokens和change是Lexer::update的结果，spans和更新前的元素一一对应，更新为line的结果。
+    // 只重新分类重新分词的元素，平移过来的元素处于相同的命令位置时直接使用原来的结果。
+    // 返回第一个类型可能改变的字节位置
+    size_t update(const std::string& line, const std::vector<Token>& tokens, const LexChange& change,
+                  std::vector<HighlightSpan>& spans);
+    
+    // 类型对应的终端控制序列（颜色、粗体等），普通文本为空。设置样式时预先生成
+    const std::string& sequence(SyntaxType type) const { return sequences_[static_cast<size_t>(type)]; }
+    
     // 设置高亮样式
     void setStyle(SyntaxType type, const HighlightStyle& style);
     
+    // 恢复默认样式（16色）
+    void resetStyles() { initializeDefaultStyles(); }
+    
     // 获取高亮样式
-    HighlightStyle getStyle(SyntaxType type) const;
+    const HighlightStyle& getStyle(SyntaxType type) const { return styles_[static_cast<size_t>(type)]; }
     
     // 启用/禁用高亮
     void setEnabled(bool enabled) { enabled_ = enabled; }
@@ -91,28 +133,46 @@ public:
     // 注册内置命令列表
     void setBuiltinCommands(const std::set<std::string>& commands);
     
+    // 查询命令和路径是否存在。查询在每次按键的路径上，不能访问文件系统，只能查缓存；
+    // 没有设置时不区分。缓存的结果变化后，之前分析的结果需要重新分析
+    using ExistenceLookup = std::function<Existence(std::string_view)>;
+    void setCommandLookup(ExistenceLookup lookup) { command_lookup_ = std::move(lookup); }
+    void setPathLookup(ExistenceLookup lookup) { path_lookup_ = std::move(lookup); }
+    
     // 分词器（用于测试）
     std::vector<std::string> tokenize(const std::string& line);
 
 private:
     bool enabled_;
-    std::map<SyntaxType, HighlightStyle> styles_;
-    std::set<std::string> builtin_commands_;
+    std::array<HighlightStyle, kSyntaxTypeCount> styles_;
+    std::array<std::string, kSyntaxTypeCount> sequences_;
+    size_t longest_ = 0;                // 最长的控制序列
+    std::string padded_;                // 所有控制序列，每个后面留有空余（highlight()整块复制）
+    std::array<size_t, kSyntaxTypeCount> paddedOffsets_{};
+    
+    // 内置命令：开放寻址表（大小为2的幂）中存放builtin_names_的下标，命令位置的每个词都要查找
+    static constexpr uint32_t kNoBuiltin = UINT32_MAX;
+    std::vector<std::string> builtin_names_;
+    std::vector<uint32_t> builtin_table_;
+    ExistenceLookup command_lookup_;
+    ExistenceLookup path_lookup_;
+    
+    // highlight()的输出缓冲区，在调用之间复用
+    std::string buffer_;
     
     // 初始化默认样式
     void initializeDefaultStyles();
     
-    // 分析命令行语法
-    std::vector<std::pair<SyntaxType, std::string>> analyze(const std::string& line);
+    // 元素的类型；command为元素之前是否处于命令位置，返回后更新为下一个元素的
+    SyntaxType classify(const std::string& line, const Token& token, bool& command) const;
+    static bool nextCommand(SyntaxType type, bool command);
     
     // 检测各种语法元素
-    SyntaxType detectType(const std::string& token, bool is_first_word = false);
-    bool isOption(const std::string& token);
-    bool isString(const std::string& token);
-    bool isVariable(const std::string& token);
-    bool isPath(const std::string& token);
-    bool isNumber(const std::string& token);
-    bool isRedirection(const std::string& token);
+    SyntaxType detectType(std::string_view token, bool is_first_word = false) const;
+    static bool isOption(std::string_view token);
+    static bool isPath(std::string_view token);
+    static bool isNumber(std::string_view token);
+    bool isBuiltin(std::string_view word) const;
 };
 
 #endif // SYNTAX_HIGHLIGHTER_H
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "task_queue.h"
+#include <chrono>
+
+namespace {
+
+// 析构时等待正在执行的任务结束的最长时间
+constexpr int kShutdownWaitMs = 100;
+
+} // namespace
+
+TaskQueue::TaskQueue(size_t workers)
+    : state_(std::make_shared<State>()), workers_(workers > 0 ? workers : 1) {}
+
+TaskQueue::~TaskQueue() {
+    bool busy;
+    {
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        state_->stop = true;
+        state_->tasks.clear();
+        busy = !state_->idle.wait_for(lock, std::chrono::milliseconds(kShutdownWaitMs),
+                                      [this] { return state_->running == 0; });
+    }
+    state_->ready.notify_all();
+
+    for (std::thread& thread : threads_) {
+        if (busy) {
+            thread.detach();
+        } else {
+            thread.join();
+        }
+    }
+}
+
+void TaskQueue::post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->tasks.push_back(std::move(task));
+    }
+    if (threads_.empty()) {
+        for (size_t i = 0; i < workers_; ++i) {
+            threads_.emplace_back(&TaskQueue::run, state_);
+        }
+    }
+    state_->ready.notify_one();
+}
+
+void TaskQueue::run(std::shared_ptr<State> state) {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (true) {
+        state->ready.wait(lock, [&state] { return state->stop || !state->tasks.empty(); });
+        if (state->stop) {
+            break;
+        }
+        Task task = std::move(state->tasks.front());
+        state->tasks.pop_front();
+        ++state->running;
+
+        lock.unlock();
+        task();
+        task = nullptr;     // 在加锁前释放任务捕获的对象
+        lock.lock();
+
+        --state->running;
+        state->idle.notify_all();
+    }
+}
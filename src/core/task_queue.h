@@ -0,0 +1,48 @@
+#ifndef TASK_QUEUE_H
+#define TASK_QUEUE_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+// 后台任务队列：固定数量的工作线程按提交顺序执行任务
+//
+// 线程在第一次提交任务时才启动。只有一个工作线程时任务依次执行，互不并发。
+// 析构时丢弃还没开始的任务；正在执行的任务（例如卡在无响应的网络文件系统上）
+// 最多等待一小段时间，之后线程被分离，不会让shell退不出去。
+class TaskQueue {
+public:
+    using Task = std::function<void()>;
+
+    explicit TaskQueue(size_t workers = 1);
+    ~TaskQueue();
+
+    TaskQueue(const TaskQueue&) = delete;
+    TaskQueue& operator=(const TaskQueue&) = delete;
+
+    // 提交任务
+    void post(Task task);
+
+private:
+    // 与工作线程共享，线程被分离后仍然有效
+    struct State {
+        std::mutex mutex;
+        std::condition_variable ready;  // 有新任务或要求退出
+        std::condition_variable idle;   // 有任务执行完
+        std::deque<Task> tasks;
+        size_t running = 0;
+        bool stop = false;
+    };
+
+    std::shared_ptr<State> state_;
+    std::vector<std::thread> threads_;
+    size_t workers_;
+
+    static void run(std::shared_ptr<State> state);
+};
+
+#endif // TASK_QUEUE_H
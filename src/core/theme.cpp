@@ -0,0 +1,353 @@
+#include "theme.h"
+#include <algorithm>
+#include <iterator>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+namespace {
+
+// 基本16色在常见终端（xterm）中的默认值，用于换算最接近的颜色
+constexpr uint8_t kBasicColors[16][3] = {
+    {0, 0, 0}, {205, 0, 0}, {0, 205, 0}, {205, 205, 0},
+    {0, 0, 238}, {205, 0, 205}, {0, 205, 205}, {229, 229, 229},
+    {127, 127, 127}, {255, 0, 0}, {0, 255, 0}, {255, 255, 0},
+    {92, 92, 255}, {255, 0, 255}, {0, 255, 255}, {255, 255, 255},
+};
+
+// 256色中16-231是6x6x6的颜色立方体，每个分量取这6个值之一；232-255是灰度
+constexpr uint8_t kCubeLevels[6] = {0, 95, 135, 175, 215, 255};
+
+const char* const kColorNames[8] = {"black", "red", "green", "yellow", "blue", "magenta", "cyan", "white"};
+
+const std::pair<const char*, SyntaxType> kTypeNames[] = {
+    {"command", SyntaxType::COMMAND},
+    {"builtin", SyntaxType::BUILTIN_COMMAND},
+    {"unknown-command", SyntaxType::UNKNOWN_COMMAND},
+    {"option", SyntaxType::OPTION},
+    {"string", SyntaxType::STRING},
+    {"variable", SyntaxType::VARIABLE},
+    {"pipe", SyntaxType::PIPE},
+    {"redirect", SyntaxType::REDIRECT},
+    {"background", SyntaxType::BACKGROUND},
+    {"comment", SyntaxType::COMMENT},
+    {"number", SyntaxType::NUMBER},
+    {"path", SyntaxType::PATH},
+    {"missing-path", SyntaxType::MISSING_PATH},
+    {"operator", SyntaxType::OPERATOR},
+    {"suggestion", SyntaxType::SUGGESTION},
+    {"normal", SyntaxType::NORMAL},
+};
+
+int distance(const uint8_t* a, int red, int green, int blue) {
+    int dr = a[0] - red, dg = a[1] - green, db = a[2] - blue;
+    return dr * dr + dg * dg + db * db;
+}
+
+void indexedToRgb(int index, uint8_t rgb[3]) {
+    if (index < 16) {
+        std::memcpy(rgb, kBasicColors[index], 3);
+    } else if (index < 232) {
+        index -= 16;
+        rgb[0] = kCubeLevels[index / 36];
+        rgb[1] = kCubeLevels[index / 6 % 6];
+        rgb[2] = kCubeLevels[index % 6];
+    } else {
+        rgb[0] = rgb[1] = rgb[2] = static_cast<uint8_t>(8 + 10 * (index - 232));
+    }
+}
+
+// 按色相换算成基本16色：只按RGB距离的话，大多数柔和的颜色都会变成灰色
+int nearestBasic(int red, int green, int blue) {
+    int max = std::max({red, green, blue});
+    int min = std::min({red, green, blue});
+    if (max - min < max / 4 + 16) {
+        // 接近灰色：黑、暗灰、白、亮白
+        int gray = (red + green + blue) / 3;
+        return gray < 48 ? 0 : gray < 160 ? 8 : gray < 224 ? 7 : 15;
+    }
+
+    // 色相每60度一个扇区：红、黄、绿、青、蓝、品红
+    constexpr int kSectors[6] = {1, 3, 2, 6, 4, 5};
+    int chroma = max - min;
+    int hue;
+    if (max == red) {
+        hue = 60 * (green - blue) / chroma;
+    } else if (max == green) {
+        hue = 120 + 60 * (blue - red) / chroma;
+    } else {
+        hue = 240 + 60 * (red - green) / chroma;
+    }
+    int sector = ((hue + 30 + 360) % 360) / 60;
+    return kSectors[sector] + (max > 220 ? 8 : 0);
+}
+
+int nearestIndexed(int red, int green, int blue) {
+    auto level = [](int value) {
+        int best = 0;
+        for (int i = 1; i < 6; ++i) {
+            if (std::abs(kCubeLevels[i] - value) < std::abs(kCubeLevels[best] - value)) {
+                best = i;
+            }
+        }
+        return best;
+    };
+    int cube = 16 + 36 * level(red) + 6 * level(green) + level(blue);
+    int gray = 232 + std::min(23, std::max(0, ((red + green + blue) / 3 - 3) / 10));
+    uint8_t cubeRgb[3], grayRgb[3];
+    indexedToRgb(cube, cubeRgb);
+    indexedToRgb(gray, grayRgb);
+    return distance(grayRgb, red, green, blue) < distance(cubeRgb, red, green, blue) ? gray : cube;
+}
+
+std::string_view trim(std::string_view text) {
+    size_t start = text.find_first_not_of(" \t\r");
+    if (start == std::string_view::npos) {
+        return {};
+    }
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(start, end - start + 1);
+}
+
+// terminfo中的颜色数（max_colors）；找不到这个终端时返回-2，没有这一项时返回-1
+long terminfoColors(const std::string& term) {
+    std::vector<std::string> dirs;
+    if (const char* terminfo = getenv("TERMINFO")) {
+        dirs.emplace_back(terminfo);
+    }
+    if (const char* home = getenv("HOME")) {
+        dirs.push_back(std::string(home) + "/.terminfo");
+    }
+    if (const char* list = getenv("TERMINFO_DIRS")) {
+        std::istringstream iss(list);
+        std::string dir;
+        while (std::getline(iss, dir, ':')) {
+            if (!dir.empty()) {
+                dirs.push_back(dir);
+            }
+        }
+    }
+    for (const char* dir : {"/etc/terminfo", "/lib/terminfo", "/usr/share/terminfo", "/usr/lib/terminfo"}) {
+        dirs.emplace_back(dir);
+    }
+
+    // 按首字母分子目录，macOS上子目录名是首字母的十六进制
+    char hex[3];
+    snprintf(hex, sizeof(hex), "%02x", static_cast<unsigned char>(term[0]));
+    std::string data;
+    for (const std::string& dir : dirs) {
+        for (const std::string& sub : {std::string(1, term[0]), std::string(hex)}) {
+            std::ifstream file(dir + "/" + sub + "/" + term, std::ios::binary);
+            if (file) {
+                data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                break;
+            }
+        }
+        if (!data.empty()) {
+            break;
+        }
+    }
+
+    // 编译后的格式：6个16位小端整数的文件头（魔数、名字长度、布尔项数、数值项数、字符串项数、
+    // 字符串表长度），然后是名字、布尔项、（对齐到偶数）数值项；max_colors是第13个数值项。
+    // 魔数0432的数值项是16位，01036的是32位
+    auto word = [&data](size_t offset) {
+        return static_cast<unsigned>(static_cast<unsigned char>(data[offset])) |
+               static_cast<unsigned>(static_cast<unsigned char>(data[offset + 1])) << 8;
+    };
+    if (data.size() < 12) {
+        return -2;
+    }
+    unsigned magic = word(0);
+    size_t width = magic == 0432 ? 2 : magic == 01036 ? 4 : 0;
+    if (width == 0) {
+        return -2;
+    }
+    constexpr size_t kMaxColors = 13;
+    size_t numbers = 12 + word(2) + word(4);
+    numbers += numbers % 2;
+    if (word(6) <= kMaxColors || numbers + (kMaxColors + 1) * width > data.size()) {
+        return -1;
+    }
+    size_t offset = numbers + kMaxColors * width;
+    long value = 0;
+    for (size_t i = 0; i < width; ++i) {
+        value |= static_cast<long>(static_cast<unsigned char>(data[offset + i])) << (8 * i);
+    }
+    // 负数（-1没有、-2取消）按补码存储
+    if (value >= 1L << (8 * width - 1)) {
+        return -1;
+    }
+    return value;
+}
+
+} // namespace
+
+ColorDepth detectColorDepth() {
+    // https://no-color.org：设置了非空的NO_COLOR就不输出颜色
+    const char* noColor = getenv("NO_COLOR");
+    if (noColor && *noColor) {
+        return ColorDepth::NONE;
+    }
+    const char* colorTerm = getenv("COLORTERM");
+    if (colorTerm && (strcmp(colorTerm, "truecolor") == 0 || strcmp(colorTerm, "24bit") == 0)) {
+        return ColorDepth::TRUECOLOR;
+    }
+    const char* termName = getenv("TERM");
+    std::string term = termName ? termName : "";
+    if (term.empty() || term == "dumb") {
+        return ColorDepth::NONE;
+    }
+
+    long colors = terminfoColors(term);
+    if (colors == -2) {
+        // 没有terminfo数据库时按名字猜测
+        if (term.find("direct") != std::string::npos) {
+            return ColorDepth::TRUECOLOR;
+        }
+        return term.find("256color") != std::string::npos ? ColorDepth::INDEXED : ColorDepth::BASIC;
+    }
+    if (colors >= 1L << 24) {
+        return ColorDepth::TRUECOLOR;
+    }
+    if (colors >= 256) {
+        return ColorDepth::INDEXED;
+    }
+    return colors >= 8 ? ColorDepth::BASIC : ColorDepth::NONE;
+}
+
+bool Theme::load(const std::string& path, std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = path + ": " + strerror(errno);
+        return false;
+    }
+
+    std::array<Style, kSyntaxTypeCount> styles;
+    std::string line;
+    for (size_t number = 1; std::getline(file, line); ++number) {
+        // 只有整行注释（#rrggbb也以#开头）
+        std::string_view text = trim(line);
+        if (text.empty() || text[0] == '#') {
+            continue;
+        }
+        size_t equals = text.find('=');
+        std::string_view name = trim(text.substr(0, equals));
+        auto type = std::find_if(std::begin(kTypeNames), std::end(kTypeNames),
+                                 [name](const auto& entry) { return name == entry.first; });
+        std::string reason;
+        if (equals == std::string_view::npos) {
+            reason = "expected 'type = style'";
+        } else if (type == std::end(kTypeNames)) {
+            reason = "unknown type '" + std::string(name) + "'";
+        } else {
+            Style& style = styles[static_cast<size_t>(type->second)];
+            if (parseStyle(text.substr(equals + 1), style, reason)) {
+                style.set = true;
+                continue;
+            }
+        }
+        error = path + ":" + std::to_string(number) + ": " + reason;
+        return false;
+    }
+
+    styles_ = styles;
+    return true;
+}
+
+void Theme::apply(SyntaxHighlighter& highlighter, ColorDepth depth) const {
+    highlighter.resetStyles();
+    // 不用颜色时自动建议只用暗淡属性区分
+    if (depth == ColorDepth::NONE) {
+        highlighter.setStyle(SyntaxType::SUGGESTION, HighlightStyle(Colors::RESET, false, true));
+    }
+    for (size_t i = 0; i < kSyntaxTypeCount; ++i) {
+        const Style& style = styles_[i];
+        if (style.set) {
+            std::string color = sequence(style.color, depth);
+            highlighter.setStyle(static_cast<SyntaxType>(i),
+                                 HighlightStyle(color.empty() ? Colors::RESET : color, style.bold, style.dim,
+                                                style.underline));
+        }
+    }
+}
+
+bool Theme::parseStyle(std::string_view spec, Style& style, std::string& error) {
+    style = Style();
+    std::istringstream iss{std::string(spec)};
+    std::string word;
+    while (iss >> word) {
+        if (word == "bold") {
+            style.bold = true;
+        } else if (word == "dim") {
+            style.dim = true;
+        } else if (word == "underline") {
+            style.underline = true;
+        } else if (word == "default") {
+            style.color = Color();
+        } else if (word[0] == '#') {
+            if (word.size() != 7 || word.find_first_not_of("0123456789abcdefABCDEF", 1) != std::string::npos) {
+                error = "invalid color '" + word + "' (expected #rrggbb)";
+                return false;
+            }
+            unsigned long rgb = std::stoul(word.substr(1), nullptr, 16);
+            style.color.kind = Color::Kind::RGB;
+            style.color.red = static_cast<uint8_t>(rgb >> 16);
+            style.color.green = static_cast<uint8_t>(rgb >> 8);
+            style.color.blue = static_cast<uint8_t>(rgb);
+        } else if (word.find_first_not_of("0123456789") == std::string::npos) {
+            if (word.size() > 3 || std::stoi(word) > 255) {
+                error = "invalid color '" + word + "' (expected 0-255)";
+                return false;
+            }
+            style.color.kind = Color::Kind::INDEXED;
+            style.color.index = static_cast<uint8_t>(std::stoi(word));
+        } else {
+            bool bright = word.compare(0, 7, "bright-") == 0;
+            std::string name = bright ? word.substr(7) : word;
+            auto color = std::find(std::begin(kColorNames), std::end(kColorNames), name);
+            if (color == std::end(kColorNames)) {
+                error = "unknown color or attribute '" + word + "'";
+                return false;
+            }
+            style.color.kind = Color::Kind::INDEXED;
+            style.color.index = static_cast<uint8_t>((color - std::begin(kColorNames)) + (bright ? 8 : 0));
+        }
+    }
+    return true;
+}
+
+std::string Theme::sequence(const Color& color, ColorDepth depth) {
+    int index = color.index;
+    switch (color.kind) {
+        case Color::Kind::DEFAULT:
+            return "";
+        case Color::Kind::RGB:
+            if (depth == ColorDepth::TRUECOLOR) {
+                return "\033[38;2;" + std::to_string(color.red) + ";" + std::to_string(color.green) + ";" +
+                       std::to_string(color.blue) + "m";
+            }
+            index = depth == ColorDepth::INDEXED ? nearestIndexed(color.red, color.green, color.blue)
+                                                 : nearestBasic(color.red, color.green, color.blue);
+            break;
+        case Color::Kind::INDEXED:
+            if (index >= 16 && depth != ColorDepth::INDEXED && depth != ColorDepth::TRUECOLOR) {
+                uint8_t rgb[3];
+                indexedToRgb(index, rgb);
+                index = nearestBasic(rgb[0], rgb[1], rgb[2]);
+            }
+            break;
+    }
+    // 基本16色用30-37、90-97，所有终端都支持
+    if (index < 8) {
+        return "\033[" + std::to_string(30 + index) + "m";
+    }
+    if (index < 16) {
+        return "\033[" + std::to_string(90 + index - 8) + "m";
+    }
+    return "\033[38;5;" + std::to_string(index) + "m";
+}
@@ -0,0 +1,59 @@
+#ifndef THEME_H
+#define THEME_H
+
+#include <string>
+#include <string_view>
+#include <array>
+#include <cstdint>
+#include "syntax_highlighter.h"
+
+// 终端能显示的颜色
+enum class ColorDepth {
+    NONE,           // 不使用颜色（NO_COLOR、dumb终端、terminfo中没有颜色）
+    BASIC,          // 16色
+    INDEXED,        // 256色
+    TRUECOLOR       // 24位真彩色
+};
+
+// 启动时检测一次：NO_COLOR、COLORTERM，然后按TERM读取terminfo中的颜色数
+ColorDepth detectColorDepth();
+
+// 语法高亮的配色主题
+//
+// 主题文件每行为"类型 = 样式"，#开头的行是注释。样式由颜色和属性组成，以空格分隔：
+//   颜色：default、black、red……white、bright-black……bright-white，0-255（256色），#rrggbb（真彩色）
+//   属性：bold、dim、underline
+// 类型为command、builtin、unknown-command、option、string、variable、pipe、redirect、background、
+// comment、number、path、missing-path、operator、suggestion、normal；文件中没有的类型使用默认样式。
+// 应用到高亮器时按终端的颜色数换算成最接近的颜色，生成好控制序列，高亮时没有额外开销。
+class Theme {
+public:
+    // 读入主题文件；出错时返回false，error说明原因（带行号）
+    bool load(const std::string& path, std::string& error);
+
+    // 恢复高亮器的默认样式，再设置主题中的样式
+    void apply(SyntaxHighlighter& highlighter, ColorDepth depth) const;
+
+private:
+    struct Color {
+        enum class Kind : uint8_t { DEFAULT, INDEXED, RGB };
+        Kind kind = Kind::DEFAULT;
+        uint8_t index = 0;              // INDEXED：0-15为基本的16色
+        uint8_t red = 0, green = 0, blue = 0;
+    };
+
+    struct Style {
+        bool set = false;               // 主题文件中有这个类型
+        Color color;
+        bool bold = false;
+        bool dim = false;
+        bool underline = false;
+    };
+
+    std::array<Style, kSyntaxTypeCount> styles_;
+
+    static bool parseStyle(std::string_view spec, Style& style, std::string& error);
+    static std::string sequence(const Color& color, ColorDepth depth);
+};
+
+#endif // THEME_H
@@ -1,5 +1,10 @@
 #include "core/syntax_highlighter.h"
+#include "core/lexer.h"
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
 // 函数用于转义字符串中的特殊字符，以便在终端中可见
 std::string escape_string(const std::string& str) {
@@ -25,7 +30,136 @@ std::string escape_string(const std::string& str) {
     return result;
 }
 
-int main() {
+// 基准测试：反复高亮约4KB的命令行，输出每次的平均耗时
+void benchmark(SyntaxHighlighter& highlighter, const char* name, const std::string& head,
+               const std::string& segment, int iterations) {
+    std::string line = head;
+    while (line.size() < 4096) {
+        line += segment;
+    }
+    
+    // 分成10轮，取最快的一轮：其他进程的干扰只会让某几轮变慢
+    constexpr int rounds = 10;
+    int perRound = std::max(iterations / rounds, 1);
+    size_t bytes = 0;
+    double best = 0;
+    for (int round = 0; round < rounds; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < perRound; ++i) {
+            bytes = highlighter.highlight(line).size();
+        }
+        auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        if (round == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    
+    std::cout << name << ": " << line.size() << " bytes -> " << bytes << " bytes, "
+              << best / perRound << " us per highlight() (best of " << rounds << " rounds of " << perRound
+              << " calls)" << std::endl;
+}
+
+int benchmark(int iterations) {
+    SyntaxHighlighter highlighter;
+    highlighter.setBuiltinCommands({"cd", "echo", "export", "history"});
+    
+    // 短元素为主的管道命令，以及一长串文件路径参数
+    benchmark(highlighter, "pipeline", "cd /tmp && ",
+              "grep -rn --color=auto \"TODO: fix\" $HOME/src ./build 2> /dev/null | sort -k2 > out.log && ",
+              iterations);
+    benchmark(highlighter, "file list", "tar -czf backup.tar.gz",
+              " src/core/syntax_highlighter.cpp include/mysh/line_renderer.h", iterations);
+    return 0;
+}
+
+// 按analyzeSpans的结果逐个拼接，作为highlight()的参照
+std::string reference(SyntaxHighlighter& highlighter, const std::string& line) {
+    std::string result;
+    size_t copied = 0;
+    for (const auto& span : highlighter.analyzeSpans(line)) {
+        const std::string& sequence = highlighter.sequence(span.type);
+        if (sequence.empty()) {
+            continue;
+        }
+        result += line.substr(copied, span.start - copied) + sequence + line.substr(span.start, span.end - span.start) +
+                  Colors::RESET;
+        copied = span.end;
+    }
+    return result + line.substr(copied);
+}
+
+// 边界测试：词和控制序列的长度落在16字节整块复制的边界附近（15、16、17……），
+// 以及词正好结束在行尾的情况，词法分析和highlight()的结果都要和逐字节的参照一致
+int check() {
+    int failures = 0;
+    auto expect = [&failures](bool ok, const std::string& what, const std::string& line) {
+        if (!ok) {
+            std::cerr << "FAIL: " << what << ": \"" << escape_string(line) << "\"" << std::endl;
+            ++failures;
+        }
+    };
+    
+    // 词结束在行尾，或结束在第n个字节的操作符、空白、引号前
+    for (size_t n = 1; n <= 48; ++n) {
+        for (size_t lead = 0; lead <= 2; ++lead) {
+            std::string line = std::string(lead, ' ') + std::string(n, 'a');
+            std::vector<Token> tokens = Lexer::tokenize(line);
+            expect(tokens.size() == 1 && tokens[0].start == lead && tokens[0].end == line.size(), "word at end", line);
+            for (char stop : {'|', ';', '>', ' ', '\t', '<', '&'}) {
+                std::string stopped = line + stop + "b";
+                tokens = Lexer::tokenize(stopped);
+                expect(!tokens.empty() && tokens[0].end == line.size(), "word before operator", stopped);
+            }
+            std::string quoted = line + "'x y'";
+            tokens = Lexer::tokenize(quoted);
+            expect(tokens.size() == 1 && tokens[0].end == quoted.size(), "quote inside word", quoted);
+        }
+    }
+    
+    // 长度为15、16、17以及超过两块的控制序列，与各种长度的行组合
+    SyntaxHighlighter highlighter;
+    highlighter.setBuiltinCommands({"cd", "echo"});
+    const std::vector<std::string> sequences = {
+        std::string(Colors::RED) + "\033[1;4m" + Colors::DIM,  // 15字节
+        "\033[38;5;208m\033[01m",                                // 16字节
+        "\033[38;5;208m\033[1;4m",                               // 17字节
+        "\033[38;2;255;128;0m\033[48;2;0;0;0m" + std::string(Colors::BOLD)};
+    const char* pieces[] = {"echo", "cd", "ls", " ", "  ", "-l", "--color=auto", "'quoted text'", "\"$HOME/x\"",
+                            "$PATH", "|", "||", "&&", ";", ">", "2>", "/tmp/file", "123", "#c", "a", "\\ "};
+    unsigned seed = 12345;
+    for (const std::string& sequence : sequences) {
+        for (SyntaxType type : {SyntaxType::COMMAND, SyntaxType::BUILTIN_COMMAND, SyntaxType::OPTION,
+                                SyntaxType::STRING, SyntaxType::PATH, SyntaxType::NORMAL}) {
+            highlighter.setStyle(type, HighlightStyle(sequence));
+        }
+        for (size_t n = 1; n <= 40; ++n) {
+            std::string line = "echo " + std::string(n, 'x');
+            expect(highlighter.highlight(line) == reference(highlighter, line), "highlight", line);
+        }
+        for (int i = 0; i < 2000; ++i) {
+            std::string line;
+            size_t count = 1 + i % 12;
+            for (size_t j = 0; j < count; ++j) {
+                seed = seed * 1103515245 + 12345;
+                line += pieces[(seed >> 16) % (sizeof(pieces) / sizeof(pieces[0]))];
+            }
+            expect(highlighter.highlight(line) == reference(highlighter, line), "highlight", line);
+        }
+        highlighter.resetStyles();
+    }
+    
+    std::cout << (failures == 0 ? "All highlight checks passed" : "Highlight checks failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::strcmp(argv[1], "--bench") == 0) {
+        return benchmark(argc > 2 ? std::atoi(argv[2]) : 10000);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--check") == 0) {
+        return check();
+    }
+    
     SyntaxHighlighter highlighter;
     
     // 测试一些命令
@@ -0,0 +1,113 @@
+#include "core/parser.h"
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool ok, const std::string& what, const std::string& line) {
+    if (!ok) {
+        std::cerr << "FAIL: " << what << ": " << line << std::endl;
+        ++failures;
+    }
+}
+
+// 解析一行，错误信息写到error
+std::shared_ptr<Command> parse(const std::string& line, std::string& error) {
+    std::ostringstream captured;
+    auto old = std::cerr.rdbuf(captured.rdbuf());
+    Parser parser;
+    auto command = parser.parse(line);
+    std::cerr.rdbuf(old);
+    error = captured.str();
+    return command;
+}
+
+std::shared_ptr<Command> parse(const std::string& line) {
+    std::string error;
+    auto command = parse(line, error);
+    expect(command && error.empty(), "parse", line);
+    return command ? command : std::make_shared<Command>();
+}
+
+void checkRedirects() {
+    std::string line = "ls x 2>/dev/null";
+    auto command = parse(line);
+    expect(command->command == "ls" && command->arguments == std::vector<std::string>{"x"}, "arguments", line);
+    expect(command->errorRedirect == "/dev/null" && !command->appendError, "2>", line);
+    expect(command->outputRedirect.empty() && !command->errorToOutput, "stdout untouched", line);
+
+    line = "make 2>> 'build err.log'";
+    command = parse(line);
+    expect(command->arguments.empty() && command->errorRedirect == "build err.log" && command->appendError,
+           "2>>", line);
+
+    line = "make all &> build.log";
+    command = parse(line);
+    expect(command->arguments == std::vector<std::string>{"all"}, "arguments", line);
+    expect(command->outputRedirect == "build.log" && !command->appendOutput && command->errorToOutput &&
+           command->errorRedirect.empty(), "&>", line);
+
+    line = "sort < in.txt >> out.txt";
+    command = parse(line);
+    expect(command->inputRedirect == "in.txt" && command->outputRedirect == "out.txt" && command->appendOutput,
+           "< >>", line);
+
+    line = "sleep 10 &";
+    command = parse(line);
+    expect(command->arguments == std::vector<std::string>{"10"} && command->runInBackground, "&", line);
+}
+
+void checkQuotedOperators() {
+    // 引号内和转义的操作符是普通参数
+    std::string line = "echo '>' \">>\" a\\>b '2>' \"&&\" # > ignored";
+    auto command = parse(line);
+    expect(command->arguments == std::vector<std::string>{">", ">>", "a>b", "2>", "&&"}, "quoted operators", line);
+    expect(command->outputRedirect.empty() && command->errorRedirect.empty(), "no redirects", line);
+
+    line = "echo x2>y";
+    command = parse(line);
+    expect(command->arguments == std::vector<std::string>{"x2"} && command->outputRedirect == "y",
+           "2> only at word start", line);
+}
+
+void checkErrors() {
+    // 还不支持的操作符和缺少文件名的重定向不能作为参数传给命令
+    for (const std::string line : {"true && echo yes", "false || echo no", "cd /tmp; ls", "cat << EOF", "ls >",
+                                   "ls 2>", "ls &> | wc", "> out", "ls | grep x && echo found"}) {
+        std::string error;
+        auto command = parse(line, error);
+        expect(!command, "rejected", line);
+        expect(error.find("syntax error") != std::string::npos, "error message", line);
+    }
+
+    std::string error;
+    expect(!parse("   ", error) && error.empty(), "empty line", "   ");
+    expect(!parse("# comment only", error) && error.empty(), "comment", "# comment only");
+}
+
+void checkPipeline() {
+    std::string line = "ls missing 2>/dev/null | wc -l > count";
+    Parser parser;
+    auto pipeline = parser.parsePipeline(line);
+    expect(pipeline && pipeline->commands.size() == 2, "pipeline", line);
+    if (pipeline && pipeline->commands.size() == 2) {
+        expect(pipeline->commands[0]->errorRedirect == "/dev/null", "first command 2>", line);
+        expect(pipeline->commands[1]->arguments == std::vector<std::string>{"-l"} &&
+               pipeline->commands[1]->outputRedirect == "count", "second command >", line);
+    }
+}
+
+} // namespace
+
+int main() {
+    checkRedirects();
+    checkQuotedOperators();
+    checkErrors();
+    checkPipeline();
+
+    std::cout << (failures == 0 ? "All parser checks passed" : "Parser checks failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
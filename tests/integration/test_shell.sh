@@ -23,6 +23,14 @@ pwd
 cd -
 pwd
 
+# 测试目录栈和目录跳转
+pushd /tmp
+dirs
+popd
+z tmp
+pwd
+cd -
+
 # 测试echo命令
 echo "Hello from MyShell"
 echo -n "No newline"
@@ -57,6 +65,18 @@ help
 exit 0
 EOF
 
+# 测试readline的历史命令（M-.插入上一条命令的最后一个参数，Ctrl-O执行后显示下一条）
+yanked=$(printf 'echo yank-last-arg-test\necho \033.\nexit\n' | ./build/linux/x86_64/release/mysh 2>&1 | grep -cx yank-last-arg-test)
+if [ "$yanked" != 2 ]; then
+    echo "FAIL: yank-last-arg"
+    exit 1
+fi
+operated=$(printf 'echo one\necho two\n\033[A\033[A\017\nexit\n' | ./build/linux/x86_64/release/mysh 2>&1 | grep -cx 'one\|two' )
+if [ "$operated" != 4 ]; then
+    echo "FAIL: operate-and-get-next"
+    exit 1
+fi
+
 echo "================================"
 echo "测试完成！"
 
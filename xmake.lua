@@ -39,7 +39,7 @@ target("mysh")
     if is_plat("windows") then
         add_syslinks("shlwapi")
     elseif is_plat("linux", "macosx") then
-        add_syslinks("pthread")
+        add_syslinks("pthread", "dl")
     end
 
 --